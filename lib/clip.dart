@@ -0,0 +1,51 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+import 'dart:ffi';
+import 'dart:isolate';
+import 'dart:core';
+import 'package:ffi/ffi.dart';
+import 'ffi.dart';
+import 'exceptions.dart';
+
+/// Copies the part of [path] between [start] and [end] into a new file at [outputPath]
+/// without decoding it, so it costs about as much as copying the bytes.
+///
+/// Every stream is kept. The container of the new file is guessed from [outputPath].
+/// Since nothing is decoded the clip can only start at a keyframe, so [start] is moved back
+/// to the keyframe before it and the clip ends at the first keyframe at or after [end].
+///
+/// Returns the position of the source where the clip actually starts.
+Future<Duration> exportVideoClip(
+    String path, Duration start, Duration end, String outputPath) {
+  if (end <= start) {
+    throw ArgumentError("The clip has to end after it starts");
+  }
+  return Isolate.run(() {
+    initializeAPI();
+    Pointer<Utf8> nativePath = path.toNativeUtf8();
+    Pointer<Utf8> nativeOutputPath = outputPath.toNativeUtf8();
+    int ret = exportClip(nativePath, nativeOutputPath, start.inMilliseconds,
+        end.inMilliseconds);
+    malloc.free(nativePath);
+    malloc.free(nativeOutputPath);
+    if (ret < 0) {
+      throw VideoFormatException();
+    }
+    return Duration(milliseconds: ret);
+  });
+}
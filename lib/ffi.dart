@@ -31,8 +31,8 @@ typedef RegisterSendPort = int Function(int, PostCObject);
 
 typedef GetMetadata = Metadata Function(Pointer<Utf8>);
 
-typedef RetrieveFrameNative = FrameNative Function(Pointer<Void>);
-typedef RetrieveFrame = FrameNative Function(Pointer<Void>);
+typedef RetrieveFrameNative = Void Function(Pointer<Void>, Pointer<FrameNative>);
+typedef RetrieveFrame = void Function(Pointer<Void>, Pointer<FrameNative>);
 
 typedef MakeFrameNative = Int Function(Pointer<Void>);
 typedef MakeFrame = int Function(Pointer<Void>);
@@ -61,11 +61,161 @@ typedef TogglePause = void Function(Pointer<Void>);
 typedef ResizeNative = Void Function(Pointer<Void>, Int, Int);
 typedef Resize = void Function(Pointer<Void>, int, int);
 
+typedef AddRenditionNative = Int Function(Pointer<Void>, Int, Int, Int);
+typedef AddRendition = int Function(Pointer<Void>, int, int, int);
+
+typedef ResizeRenditionNative = Void Function(Pointer<Void>, Int, Int, Int);
+typedef ResizeRendition = void Function(Pointer<Void>, int, int, int);
+
+typedef RetrieveRenditionNative = Void Function(
+    Pointer<Void>, Int, Pointer<FrameNative>);
+typedef RetrieveRendition = void Function(
+    Pointer<Void>, int, Pointer<FrameNative>);
+
+typedef FreeRenditionNative = Void Function(Pointer<Void>, Int);
+typedef FreeRendition = void Function(Pointer<Void>, int);
+
+typedef AddTrackNative = Int Function(Pointer<Void>, Int, Int, Int, Int);
+typedef AddTrack = int Function(Pointer<Void>, int, int, int, int);
+
+typedef EnableAnalysisNative = Int Function(Pointer<Void>, Int, Double);
+typedef EnableAnalysis = int Function(Pointer<Void>, int, double);
+
+typedef ReadAnalysisEventsNative = Int Function(
+    Pointer<Void>, Pointer<AnalysisEventNative>, Int);
+typedef ReadAnalysisEvents = int Function(
+    Pointer<Void>, Pointer<AnalysisEventNative>, int);
+
+typedef EnableTensorNative = Int Function(Pointer<Void>, Int, Int, Int, Int,
+    Pointer<Float>, Pointer<Float>, Float, Int);
+typedef EnableTensor = int Function(Pointer<Void>, int, int, int, int,
+    Pointer<Float>, Pointer<Float>, double, int);
+
+typedef RetrieveTensor = FrameNative Function(Pointer<Void>);
+
+typedef EnableFrameServerNative = Int Function(
+    Pointer<Void>, Pointer<Utf8>, Int, Int);
+typedef EnableFrameServer = int Function(
+    Pointer<Void>, Pointer<Utf8>, int, int);
+
+typedef FreeTensorNative = Void Function(Pointer<Void>);
+typedef FreeTensor = void Function(Pointer<Void>);
+
+typedef AnalyzeFramesNative = Int Function(Pointer<Void>, Int);
+typedef AnalyzeFrames = int Function(Pointer<Void>, int);
+
+typedef FingerprintVideoNative = Int Function(
+    Pointer<Utf8>, Pointer<Utf8>, Int64, Int, Int);
+typedef FingerprintVideo = int Function(
+    Pointer<Utf8>, Pointer<Utf8>, int, int, int);
+
+typedef FingerprintBatchNative = Int Function(Pointer<Pointer<Utf8>>,
+    Pointer<Pointer<Utf8>>, Int, Int64, Int, Int, Int, Pointer<Int>);
+typedef FingerprintBatch = int Function(Pointer<Pointer<Utf8>>,
+    Pointer<Pointer<Utf8>>, int, int, int, int, int, Pointer<Int>);
+
+typedef ExportClipNative = Int64 Function(
+    Pointer<Utf8>, Pointer<Utf8>, Int64, Int64);
+typedef ExportClip = int Function(Pointer<Utf8>, Pointer<Utf8>, int, int);
+
+typedef ExportFramesNative = Int64 Function(
+    Pointer<Utf8>, Pointer<Utf8>, Int, Int, Int, Int, Int);
+typedef ExportFrames = int Function(
+    Pointer<Utf8>, Pointer<Utf8>, int, int, int, int, int);
+
+typedef EncodeSnapshotNative = Int Function(
+    Pointer<Void>, Int, Int, Pointer<Pointer<Uint8>>);
+typedef EncodeSnapshot = int Function(
+    Pointer<Void>, int, int, Pointer<Pointer<Uint8>>);
+
+typedef FreeSnapshotNative = Void Function(Pointer<Uint8>);
+typedef FreeSnapshot = void Function(Pointer<Uint8>);
+
+typedef SaveFrameAtNative = Int Function(
+    Pointer<Utf8>, Int64, Pointer<Utf8>, Int, Int);
+typedef SaveFrameAt = int Function(Pointer<Utf8>, int, Pointer<Utf8>, int, int);
+
+typedef SaveFramesAtNative = Int Function(Pointer<Utf8>, Pointer<Int64>,
+    Pointer<Pointer<Utf8>>, Int, Int, Int, Int, Pointer<Int>);
+typedef SaveFramesAt = int Function(Pointer<Utf8>, Pointer<Int64>,
+    Pointer<Pointer<Utf8>>, int, int, int, int, Pointer<Int>);
+
+typedef SetRegionNative = Void Function(
+    Pointer<Void>, Int, Int, Int, Int, Int, Int);
+typedef SetRegion = void Function(Pointer<Void>, int, int, int, int, int, int);
+
+typedef CreateProxyNative = Int Function(Pointer<Utf8>, Pointer<Utf8>, Int, Int);
+typedef CreateProxy = int Function(Pointer<Utf8>, Pointer<Utf8>, int, int);
+
+typedef AttachProxyNative = Int Function(Pointer<Void>, Pointer<Utf8>);
+typedef AttachProxy = int Function(Pointer<Void>, Pointer<Utf8>);
+
+typedef ProxyState = Pointer<Void> Function(Pointer<Void>);
+
+typedef SetMemoryBudgetNative = Void Function(Int64);
+typedef SetMemoryBudget = void Function(int);
+
+typedef TotalMemoryUsage = MemoryUsageNative Function();
+
+typedef StreamMemoryUsage = MemoryUsageNative Function(Pointer<Void>);
+
+typedef SetBackgroundNative = Void Function(Pointer<Void>, Int);
+
+typedef SetTracingNative = Void Function();
+typedef SetTracing = void Function();
+
+typedef DumpTraceNative = Int Function(Pointer<Utf8>);
+typedef DumpTrace = int Function(Pointer<Utf8>);
+
+typedef PresentTextureFrameNative = Void Function(Pointer<Void>, Int);
+typedef PresentTextureFrame = void Function(Pointer<Void>, int);
+
+typedef SetDefaultPlacementNative = Void Function(Uint64, Int, Int);
+typedef SetDefaultPlacement = void Function(int, int, int);
+
+typedef SetThreadPlacementNative = Void Function(Pointer<Void>, Uint64, Int, Int);
+typedef SetThreadPlacement = void Function(Pointer<Void>, int, int, int);
+typedef SetBackground = void Function(Pointer<Void>, int);
+
+typedef TimeToFirstFrameNative = Int64 Function(Pointer<Void>);
+typedef TimeToFirstFrame = int Function(Pointer<Void>);
+
+typedef VideoMetadata = Metadata Function(Pointer<Void>);
+
+typedef ReadStatusNative = Void Function(
+    Pointer<Void>, Pointer<PlayerStatusNative>);
+typedef ReadStatus = void Function(Pointer<Void>, Pointer<PlayerStatusNative>);
+
+typedef SetPlayerStateNative = Void Function(Pointer<Void>, Int);
+typedef SetPlayerState = void Function(Pointer<Void>, int);
+
+typedef SetOutputRateNative = Void Function(Pointer<Void>, Int, Int);
+typedef SetOutputRate = void Function(Pointer<Void>, int, int);
+
+typedef SetTrickSpeedNative = Void Function(Pointer<Void>, Double);
+typedef SetTrickSpeed = void Function(Pointer<Void>, double);
+
+typedef SetLoopNative = Int Function(Pointer<Void>, Int64, Int64, Int64);
+typedef SetLoop = int Function(Pointer<Void>, int, int, int);
+
+typedef ClearLoopNative = Int Function(Pointer<Void>);
+typedef ClearLoop = int Function(Pointer<Void>);
+
 typedef GetDefaultName = Pointer<Utf8> Function(Pointer<Void>);
 
 typedef OpenVideoNative = Pointer<Void> Function(Pointer<Utf8>, Int, Int, Int);
 typedef OpenVideo = Pointer<Void> Function(Pointer<Utf8>, int, int, int);
 
+typedef OpenVideoFilteredNative = Pointer<Void> Function(
+    Pointer<Utf8>, Int, Int, Int, Pointer<Utf8>, Int, Int, Int);
+typedef OpenVideoFiltered = Pointer<Void> Function(
+    Pointer<Utf8>, int, int, int, Pointer<Utf8>, int, int, int);
+
+typedef OpenSequenceNative = Pointer<Void> Function(
+    Pointer<Utf8>, Int, Int, Int, Int, Int, Int, Int);
+typedef OpenSequence = Pointer<Void> Function(
+    Pointer<Utf8>, int, int, int, int, int, int, int);
+
 typedef DisposeVideoNative = Void Function(Pointer<Void>);
 typedef DisposeVideo = void Function(Pointer<Void>);
 
@@ -124,6 +274,95 @@ class FrameNative extends Struct {
 
   @Int()
   external int exists;
+
+  @Int()
+  external int stride;
+
+  @Int()
+  external int chromaStride;
+}
+
+class AnalysisEventNative extends Struct {
+  @Int64()
+  external int pts;
+
+  @Int64()
+  external int progress;
+
+  @Double()
+  external double motion;
+
+  @Double()
+  external double histogramDifference;
+
+  @Int()
+  external int sceneCut;
+}
+
+/// Values of the state field of [PlayerStatusNative], see enum playerStates in navigator.h
+const int statePlaying = 0;
+const int statePaused = 1;
+const int stateEnded = 2;
+
+/// Returned by makeFrame when reverse trick-play has reached the first keyframe, see REACHED_START in navigator.h
+const int reachedStart = -3;
+
+class PlayerStatusNative extends Struct {
+  @Int64()
+  external int sequence;
+
+  @Int64()
+  external int pts;
+
+  @Int64()
+  external int dts;
+
+  @Int64()
+  external int progress;
+
+  @Int64()
+  external int dtsProgress;
+
+  @Int64()
+  external int delay;
+
+  @Int64()
+  external int frames;
+
+  @Int64()
+  external int dropped;
+
+  @Int64()
+  external int state;
+
+  @Int64()
+  external int allocations;
+}
+
+class MemoryUsageNative extends Struct {
+  @Int64()
+  external int decoder;
+
+  @Int64()
+  external int output;
+
+  @Int64()
+  external int queues;
+
+  @Int64()
+  external int caches;
+
+  @Int64()
+  external int total;
+
+  @Int64()
+  external int budget;
+
+  @Int()
+  external int pressure;
+
+  @Int()
+  external int streams;
 }
 
 class Metadata extends Struct {
@@ -150,6 +389,28 @@ late DynamicLibrary dynLib;
 
 late OpenVideo openVideo;
 
+late OpenVideo openVideoFast;
+
+late OpenVideoFiltered openVideoFiltered;
+
+late OpenSequence openSequence;
+
+late TimeToFirstFrame timeToFirstFrame;
+
+late VideoMetadata videoMetadata;
+
+late ReadStatus readStatus;
+
+late SetPlayerState setPlayerState;
+
+late SetOutputRate setOutputRate;
+
+late SetTrickSpeed setTrickSpeed;
+
+late SetLoop setLoop;
+
+late ClearLoop clearLoop;
+
 late SeekTime seekTime;
 
 late GetMetadata getMetadata;
@@ -172,6 +433,78 @@ late FindEOF findEOF;
 
 late Resize resize;
 
+late SetRegion setRegion;
+
+late AddRendition addRendition;
+
+late ResizeRendition resizeRendition;
+
+late RetrieveRendition retrieveRendition;
+
+late FreeRendition freeRendition;
+
+late AddTrack addTrack;
+
+late RetrieveRendition retrieveTrack;
+
+late FreeRendition freeTrack;
+
+late EnableAnalysis enableAnalysis;
+
+late ReadAnalysisEvents readAnalysisEvents;
+
+late EnableTensor enableTensor;
+
+late RetrieveTensor retrieveTensor;
+
+late EnableFrameServer enableFrameServer;
+
+late FreeTensor freeTensor;
+
+late AnalyzeFrames analyzeFrames;
+
+late FingerprintVideo fingerprintVideo;
+
+late FingerprintBatch fingerprintBatch;
+
+late ExportClip exportClip;
+
+late ExportFrames exportFrames;
+
+late EncodeSnapshot encodeSnapshot;
+
+late FreeSnapshot freeSnapshot;
+
+late SaveFrameAt saveFrameAt;
+
+late SaveFramesAt saveFramesAt;
+
+late CreateProxy createProxy;
+
+late AttachProxy attachProxy;
+
+late ProxyState proxyState;
+
+late SetMemoryBudget setMemoryBudget;
+
+late TotalMemoryUsage totalMemoryUsage;
+
+late StreamMemoryUsage memoryUsage;
+
+late SetBackground setBackground;
+
+late SetTracing startTracing;
+
+late SetTracing stopTracing;
+
+late DumpTrace dumpTrace;
+
+late PresentTextureFrame presentTextureFrame;
+
+late SetDefaultPlacement setDefaultPlacement;
+
+late SetThreadPlacement setThreadPlacement;
+
 /// Initializes the variables that hold the functions used by the decode isolate.
 void initializeDecoder() {
   if (Platform.isWindows) {
@@ -191,11 +524,54 @@ void initializeDecoder() {
   seekPrecise =
       dynLib.lookupFunction<SeekPreciseNative, SeekPrecise>('seek_precise');
   retrieveFrame = dynLib
-      .lookupFunction<RetrieveFrameNative, RetrieveFrame>('retrieveFrame');
+      .lookupFunction<RetrieveFrameNative, RetrieveFrame>('retrieveFrameInto');
   disposeVideo =
       dynLib.lookupFunction<DisposeVideoNative, DisposeVideo>('disposeVideo');
   findEOF = dynLib.lookupFunction<FindEOFNative, FindEOF>('findEOF');
   resize = dynLib.lookupFunction<ResizeNative, Resize>('resize');
+  setRegion =
+      dynLib.lookupFunction<SetRegionNative, SetRegion>('setRegion');
+  resizeRendition =
+      dynLib.lookupFunction<ResizeRenditionNative, ResizeRendition>(
+          'resizeRendition');
+  retrieveRendition =
+      dynLib.lookupFunction<RetrieveRenditionNative, RetrieveRendition>(
+          'retrieveRenditionInto');
+  freeRendition = dynLib
+      .lookupFunction<FreeRenditionNative, FreeRendition>('freeRendition');
+  retrieveTrack =
+      dynLib.lookupFunction<RetrieveRenditionNative, RetrieveRendition>(
+          'retrieveTrackInto');
+  freeTrack =
+      dynLib.lookupFunction<FreeRenditionNative, FreeRendition>('freeTrack');
+  readAnalysisEvents =
+      dynLib.lookupFunction<ReadAnalysisEventsNative, ReadAnalysisEvents>(
+          'readAnalysisEvents');
+  retrieveTensor = dynLib
+      .lookupFunction<RetrieveTensor, RetrieveTensor>('retrieveTensor');
+  freeTensor =
+      dynLib.lookupFunction<FreeTensorNative, FreeTensor>('freeTensor');
+  attachProxy =
+      dynLib.lookupFunction<AttachProxyNative, AttachProxy>('attachProxy');
+  proxyState = dynLib.lookupFunction<ProxyState, ProxyState>('proxyState');
+  freeFrame = dynLib.lookupFunction<FreeNativeFrameNative, FreeNativeFrame>(
+      'freeNativeFrame');
+  setBackground = dynLib
+      .lookupFunction<SetBackgroundNative, SetBackground>('setBackground');
+  setPlayerState = dynLib
+      .lookupFunction<SetPlayerStateNative, SetPlayerState>('setPlayerState');
+  setOutputRate = dynLib
+      .lookupFunction<SetOutputRateNative, SetOutputRate>('setOutputRate');
+  setTrickSpeed = dynLib
+      .lookupFunction<SetTrickSpeedNative, SetTrickSpeed>('setTrickSpeed');
+  setLoop = dynLib.lookupFunction<SetLoopNative, SetLoop>('setLoop');
+  clearLoop = dynLib.lookupFunction<ClearLoopNative, ClearLoop>('clearLoop');
+  setThreadPlacement =
+      dynLib.lookupFunction<SetThreadPlacementNative, SetThreadPlacement>(
+          'setThreadPlacement');
+  presentTextureFrame =
+      dynLib.lookupFunction<PresentTextureFrameNative, PresentTextureFrame>(
+          'presentTextureFrame');
 }
 
 /// Initializes the variables that hold the functions used by the main thread.
@@ -207,9 +583,73 @@ void initializeAPI() {
     dynLib = DynamicLibrary.open('libvidena.so');
   }
   openVideo = dynLib.lookupFunction<OpenVideoNative, OpenVideo>('openVideo');
+  openVideoFast =
+      dynLib.lookupFunction<OpenVideoNative, OpenVideo>('openVideoFast');
+  openVideoFiltered =
+      dynLib.lookupFunction<OpenVideoFilteredNative, OpenVideoFiltered>(
+          'openVideoFiltered');
+  openSequence = dynLib.lookupFunction<OpenSequenceNative, OpenSequence>(
+      'openSequence');
+  timeToFirstFrame =
+      dynLib.lookupFunction<TimeToFirstFrameNative, TimeToFirstFrame>(
+          'timeToFirstFrame');
+  videoMetadata =
+      dynLib.lookupFunction<VideoMetadata, VideoMetadata>('videoMetadata');
+  readStatus =
+      dynLib.lookupFunction<ReadStatusNative, ReadStatus>('readStatus');
   freeFrame = dynLib.lookupFunction<FreeNativeFrameNative, FreeNativeFrame>(
       'freeNativeFrame');
   disposeVideo =
       dynLib.lookupFunction<DisposeVideoNative, DisposeVideo>('disposeVideo');
   getMetadata = dynLib.lookupFunction<GetMetadata, GetMetadata>('getMetadata');
+  addRendition =
+      dynLib.lookupFunction<AddRenditionNative, AddRendition>('addRendition');
+  addTrack = dynLib.lookupFunction<AddTrackNative, AddTrack>('addTrack');
+  enableAnalysis = dynLib
+      .lookupFunction<EnableAnalysisNative, EnableAnalysis>('enableAnalysis');
+  readAnalysisEvents =
+      dynLib.lookupFunction<ReadAnalysisEventsNative, ReadAnalysisEvents>(
+          'readAnalysisEvents');
+  enableTensor = dynLib
+      .lookupFunction<EnableTensorNative, EnableTensor>('enableTensor');
+  enableFrameServer =
+      dynLib.lookupFunction<EnableFrameServerNative, EnableFrameServer>(
+          'enableFrameServer');
+  analyzeFrames =
+      dynLib.lookupFunction<AnalyzeFramesNative, AnalyzeFrames>(
+          'analyze_frames');
+  fingerprintVideo =
+      dynLib.lookupFunction<FingerprintVideoNative, FingerprintVideo>(
+          'fingerprintVideo');
+  fingerprintBatch =
+      dynLib.lookupFunction<FingerprintBatchNative, FingerprintBatch>(
+          'fingerprintBatch');
+  exportClip =
+      dynLib.lookupFunction<ExportClipNative, ExportClip>('exportClip');
+  exportFrames =
+      dynLib.lookupFunction<ExportFramesNative, ExportFrames>('exportFrames');
+  encodeSnapshot = dynLib
+      .lookupFunction<EncodeSnapshotNative, EncodeSnapshot>('encodeSnapshot');
+  freeSnapshot =
+      dynLib.lookupFunction<FreeSnapshotNative, FreeSnapshot>('freeSnapshot');
+  saveFrameAt =
+      dynLib.lookupFunction<SaveFrameAtNative, SaveFrameAt>('saveFrameAt');
+  saveFramesAt =
+      dynLib.lookupFunction<SaveFramesAtNative, SaveFramesAt>('saveFramesAt');
+  createProxy =
+      dynLib.lookupFunction<CreateProxyNative, CreateProxy>('createProxy');
+  setMemoryBudget = dynLib.lookupFunction<SetMemoryBudgetNative,
+      SetMemoryBudget>('setMemoryBudget');
+  totalMemoryUsage = dynLib
+      .lookupFunction<TotalMemoryUsage, TotalMemoryUsage>('totalMemoryUsage');
+  memoryUsage = dynLib
+      .lookupFunction<StreamMemoryUsage, StreamMemoryUsage>('memoryUsage');
+  startTracing =
+      dynLib.lookupFunction<SetTracingNative, SetTracing>('startTracing');
+  stopTracing =
+      dynLib.lookupFunction<SetTracingNative, SetTracing>('stopTracing');
+  dumpTrace = dynLib.lookupFunction<DumpTraceNative, DumpTrace>('dumpTrace');
+  setDefaultPlacement =
+      dynLib.lookupFunction<SetDefaultPlacementNative, SetDefaultPlacement>(
+          'setDefaultPlacement');
 }
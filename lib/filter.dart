@@ -0,0 +1,37 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// A filter graph run natively between the decoder and the outputs.
+///
+/// [filters] are in the syntax of ffmpeg -vf, for example `yadif` to deinterlace, `hqdn3d` to denoise
+/// or `fps=30` to change the frame rate. With [autoRotate] the picture is first turned upright
+/// by the display matrix of the stream, like phones record it.
+///
+/// The scale and conversion to the output run in the graph too, so the filtered frames aren't converted again.
+/// Unless the player is resized, the frames have the size the filters make of the picture.
+/// A `SceneAnalysis` and a `TensorOutput` read the filtered frames as they are before that conversion,
+/// taken from a second output of the graph, so they still get the luma plane of the stream.
+/// The graph splits every frame between [threads] threads, or one per core when [threads] is 0.
+class VideoFilter {
+  final String filters;
+  final bool autoRotate;
+  final int threads;
+
+  const VideoFilter(
+      {this.filters = '', this.autoRotate = false, this.threads = 0});
+}
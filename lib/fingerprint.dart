@@ -0,0 +1,165 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:isolate';
+import 'dart:core';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'package:fraction/fraction.dart';
+import 'ffi.dart';
+import 'exceptions.dart';
+
+/// {@template fingerprintOptions}
+/// Settings for the fingerprinting of a video.
+///
+/// At most one frame every [interval] is fingerprinted, or every frame with [Duration.zero].
+/// [keyframesOnly] makes the decoder skip everything but keyframes, which is much faster.
+/// When [minDistance] is above 0 a fingerprint is only stored if it differs from the last
+/// stored one in at least that many bits, which leaves roughly one fingerprint per shot.
+/// {@endtemplate}
+class FingerprintOptions {
+  Duration interval;
+  bool keyframesOnly;
+  int minDistance;
+
+  FingerprintOptions(
+      {this.interval = Duration.zero,
+      this.keyframesOnly = false,
+      this.minDistance = 0});
+}
+
+/// The fingerprint of a single frame.
+///
+/// [pts] is in stream timebase.
+/// [dctHash] and [averageHash] are 64 bit perceptual hashes of the luma,
+/// similar frames have hashes with a small [hammingDistance].
+class FrameFingerprint {
+  int pts;
+  int dctHash;
+  int averageHash;
+
+  FrameFingerprint(
+      {required this.pts, required this.dctHash, required this.averageHash});
+}
+
+/// The content of an index file written by [fingerprintFile] or [fingerprintFiles].
+class FingerprintIndex {
+  Fraction timebase;
+  List<FrameFingerprint> fingerprints;
+
+  FingerprintIndex({required this.timebase, required this.fingerprints});
+}
+
+const int _headerSize = 20;
+const int _recordSize = 24;
+
+int hammingDistance(int a, int b) {
+  int x = a ^ b;
+  int bits = 0;
+  while (x != 0) {
+    x &= x - 1;
+    bits++;
+  }
+  return bits;
+}
+
+/// Reads an index file written by [fingerprintFile] or [fingerprintFiles].
+FingerprintIndex readFingerprintIndex(String path) {
+  ByteData data = File(path).readAsBytesSync().buffer.asByteData();
+  if (data.lengthInBytes < _headerSize ||
+      String.fromCharCodes(data.buffer.asUint8List(0, 4)) != 'VFPI') {
+    throw const FormatException("Not a fingerprint index");
+  }
+  int count = data.getUint32(16, Endian.little);
+  if (data.lengthInBytes < _headerSize + count * _recordSize) {
+    throw const FormatException("Truncated fingerprint index");
+  }
+  List<FrameFingerprint> fingerprints = [];
+  for (int i = 0; i < count; i++) {
+    int offset = _headerSize + i * _recordSize;
+    fingerprints.add(FrameFingerprint(
+        pts: data.getInt64(offset, Endian.little),
+        dctHash: data.getUint64(offset + 8, Endian.little),
+        averageHash: data.getUint64(offset + 16, Endian.little)));
+  }
+  return FingerprintIndex(
+      timebase: Fraction(data.getInt32(8, Endian.little),
+          data.getInt32(12, Endian.little)),
+      fingerprints: fingerprints);
+}
+
+/// Fingerprints [path] into the index file at [indexPath] and returns the number of fingerprints.
+///
+/// {@macro fingerprintOptions}
+Future<int> fingerprintFile(String path, String indexPath,
+    {FingerprintOptions? options}) {
+  options ??= FingerprintOptions();
+  FingerprintOptions o = options;
+  return Isolate.run(() {
+    initializeAPI();
+    Pointer<Utf8> nativePath = path.toNativeUtf8();
+    Pointer<Utf8> nativeIndexPath = indexPath.toNativeUtf8();
+    int ret = fingerprintVideo(nativePath, nativeIndexPath,
+        o.interval.inMilliseconds, o.keyframesOnly ? 1 : 0, o.minDistance);
+    malloc.free(nativePath);
+    malloc.free(nativeIndexPath);
+    if (ret < 0) {
+      throw VideoFormatException();
+    }
+    return ret;
+  });
+}
+
+/// Fingerprints every file in [paths] into the index file at the same position in [indexPaths],
+/// decoding up to [threads] files at once, or one per core when [threads] is 0.
+///
+/// Returns the number of fingerprints of each file, or -1 for the files that failed.
+///
+/// {@macro fingerprintOptions}
+Future<List<int>> fingerprintFiles(List<String> paths, List<String> indexPaths,
+    {FingerprintOptions? options, int threads = 0}) {
+  if (paths.length != indexPaths.length) {
+    throw ArgumentError("Every file needs an index path");
+  }
+  options ??= FingerprintOptions();
+  FingerprintOptions o = options;
+  return Isolate.run(() {
+    initializeAPI();
+    int count = paths.length;
+    Pointer<Pointer<Utf8>> nativePaths = calloc<Pointer<Utf8>>(count);
+    Pointer<Pointer<Utf8>> nativeIndexPaths = calloc<Pointer<Utf8>>(count);
+    Pointer<Int> results = calloc<Int>(count);
+    for (int i = 0; i < count; i++) {
+      nativePaths[i] = paths[i].toNativeUtf8();
+      nativeIndexPaths[i] = indexPaths[i].toNativeUtf8();
+    }
+    fingerprintBatch(nativePaths, nativeIndexPaths, count,
+        o.interval.inMilliseconds, o.keyframesOnly ? 1 : 0, o.minDistance,
+        threads, results);
+    List<int> ret = [for (int i = 0; i < count; i++) results[i]];
+    for (int i = 0; i < count; i++) {
+      malloc.free(nativePaths[i]);
+      malloc.free(nativeIndexPaths[i]);
+    }
+    calloc.free(nativePaths);
+    calloc.free(nativeIndexPaths);
+    calloc.free(results);
+    return ret;
+  });
+}
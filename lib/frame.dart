@@ -26,8 +26,27 @@ import 'package:flutter/widgets.dart';
 /// The [none] option will return the frames in the format they came from the decoder
 /// and can be faster.
 /// After frames have been transformed in dart and are no longer in the initial format they also use [none].
+///
+/// [nv12], [rgb24], [rgb565] (little-endian) and [gray8] use less memory bandwidth than the 32 bit formats.
+/// [gray8] is the luma of the source, copied without conversion when the output isn't resized.
+/// [p010] keeps 10 bit sources at their depth, in the high bits of little-endian 16 bit samples.
+/// Rows can be padded, see [VideoFrame.stride].
 /// {@endtemplate}
-enum ImageFormat { rgba, bgra, arbg, abgr, yuv420P, gray8A, gray16LE, none }
+enum ImageFormat {
+  rgba,
+  bgra,
+  arbg,
+  abgr,
+  yuv420P,
+  gray8A,
+  gray16LE,
+  nv12,
+  rgb24,
+  rgb565,
+  gray8,
+  p010,
+  none
+}
 
 /// Object with the information that accompanied a [Frame].
 ///
@@ -56,6 +75,16 @@ class VideoFrameMetadata extends FrameMetadata {
       this.imageFormat,
       this.width,
       this.height});
+
+  VideoFrameMetadata.fromFrame(VideoFrame frame)
+      : imageFormat = frame.format,
+        width = frame.width,
+        height = frame.height,
+        super(
+            pts: frame.pts,
+            dts: frame.dts,
+            delay: Duration(microseconds: frame.delay),
+            size: frame.size);
 }
 
 abstract class Frame {
@@ -78,10 +107,19 @@ class VideoFrame extends Frame {
   int width;
   int height;
   ImageFormat format;
+
+  /// Bytes per row of the first plane.
+  int stride;
+
+  /// Bytes per row of the chroma planes, 0 for packed formats.
+  /// The planes follow each other in [Frame.content], each starting after the rows of the previous one.
+  int chromaStride;
   VideoFrame(
       {required this.width,
       required this.height,
       required this.format,
+      this.stride = 0,
+      this.chromaStride = 0,
       required super.delay,
       required super.pts,
       required super.dts,
@@ -102,7 +140,7 @@ Future<VideoFrame> processImageFromRgba(VideoFrame frame) async {
   ui.decodeImageFromPixels(
       frame.content, frame.width, frame.height, pixelFormat, (ui.Image im) {
     callback.complete(im);
-  });
+  }, rowBytes: frame.stride > 0 ? frame.stride : null);
   frame.content = RawImage(image: await callback.future);
   frame.format = ImageFormat.none;
   return frame;
@@ -0,0 +1,48 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// {@template frameServerPolicy}
+/// What the server does when a client is behind.
+/// With [dropOldest] the newest frame overwrites the oldest one and any number of clients can read.
+/// With [backpressure] the decoder waits for the one client to release a slot, unless the client
+/// hasn't released a frame for a second, then frames are dropped until it does again.
+/// {@endtemplate}
+enum FrameServerPolicy { dropOldest, backpressure }
+
+/// Publishes every converted frame into a POSIX shared memory ring, so a local process like an analytics
+/// service reads the frames the player shows without decoding the file again. Only Linux and macOS have it.
+///
+/// Clients map the ring named [name] with the C API of src/frameserver.h, frameClientOpen(), and read every frame
+/// in place between frameClientAcquire() and frameClientRelease(). Each slot has the pts, size, format
+/// and strides of its frame and a sequence counter that tells the client whether the frame was overwritten
+/// while it read it. The clients are woken by a futex in the ring.
+///
+/// The ring has [slots] frames of the output size at [VidenaPlayer.open], larger frames after a resize are dropped.
+/// A [name] still used by a running server fails the open, the ring of a server that crashed is replaced.
+///
+/// {@macro frameServerPolicy}
+class FrameServer {
+  final String name;
+  final int slots;
+  final FrameServerPolicy policy;
+
+  const FrameServer(
+      {required this.name,
+      this.slots = 4,
+      this.policy = FrameServerPolicy.dropOldest});
+}
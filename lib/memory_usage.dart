@@ -0,0 +1,63 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+import 'ffi.dart';
+
+/// Native memory held by one video or by every video of the process, in bytes.
+///
+/// When the process goes over its budget (see [Videna.setMemoryBudget]) the videos are put under [pressure].
+/// At 1 a video drops its caches, so snapshots are unavailable until the pressure is lifted.
+/// Every level above that halves the size of the frames of background videos once more.
+class MemoryUsage {
+  /// Estimate of the surfaces the decoder keeps for reference and reordering.
+  final int decoder;
+
+  /// Converted frames of the output and its renditions.
+  final int output;
+
+  /// Frames and packets waiting to be consumed.
+  final int queues;
+
+  /// Memory that can be dropped and rebuilt, like the frame kept for snapshots.
+  final int caches;
+  final int total;
+
+  /// 0 when there is no budget.
+  final int budget;
+  final int pressure;
+  final int streams;
+
+  const MemoryUsage(
+      {required this.decoder,
+      required this.output,
+      required this.queues,
+      required this.caches,
+      required this.total,
+      required this.budget,
+      required this.pressure,
+      required this.streams});
+
+  MemoryUsage.fromNative(MemoryUsageNative usage)
+      : decoder = usage.decoder,
+        output = usage.output,
+        queues = usage.queues,
+        caches = usage.caches,
+        total = usage.total,
+        budget = usage.budget,
+        pressure = usage.pressure,
+        streams = usage.streams;
+}
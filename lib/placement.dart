@@ -0,0 +1,46 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+/// Where the native threads working for a video run.
+///
+/// Pinning decoding to [cpus] keeps other cores, like the ones running the Flutter UI and raster threads,
+/// free for them. CPU numbers start at 0 and go up to 63, an empty list lets the threads run on any CPU.
+///
+/// [nice] goes from -20, the highest priority, to 19. With a [realtime] priority from 1 to 99
+/// the threads use the SCHED_FIFO scheduler on Linux and Android instead, and are time critical on Windows.
+/// Raising the priority usually needs privileges, when they are missing it is left as it was.
+class ThreadPlacement {
+  final List<int> cpus;
+  final int nice;
+  final int realtime;
+
+  const ThreadPlacement(
+      {this.cpus = const [], this.nice = 0, this.realtime = 0});
+
+  /// Bit i of the mask allows CPU i.
+  int get cpuMask {
+    int mask = 0;
+    for (int cpu in cpus) {
+      if (cpu < 0 || cpu > 63) {
+        throw ArgumentError("CPUs go from 0 to 63");
+      }
+      mask |= 1 << cpu;
+    }
+    return mask;
+  }
+}
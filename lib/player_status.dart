@@ -0,0 +1,64 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+import 'ffi.dart';
+
+enum PlayerState { playing, paused, ended }
+
+/// Status of a [VidenaPlayer] as last published by its decoder.
+///
+/// [pts] and [dts] are in stream timebase, [delay] is the time the frame stays on screen.
+class PlayerStatus {
+  final int pts;
+  final int dts;
+  final Duration progress;
+  final Duration dtsProgress;
+  final Duration delay;
+
+  /// Frames handed to the output since the video was opened.
+  final int frames;
+
+  /// Frames decoded but not delivered to every output.
+  final int dropped;
+
+  /// Heap allocations made natively by the outputs of the video, they stop growing once playback is warmed up.
+  /// Those of FFmpeg's demuxer and decoder aren't included.
+  final int allocations;
+  final PlayerState state;
+
+  const PlayerStatus(
+      {required this.pts,
+      required this.dts,
+      required this.progress,
+      required this.dtsProgress,
+      required this.delay,
+      required this.frames,
+      required this.dropped,
+      required this.allocations,
+      required this.state});
+
+  PlayerStatus.fromNative(PlayerStatusNative status)
+      : pts = status.pts,
+        dts = status.dts,
+        progress = Duration(milliseconds: status.progress),
+        dtsProgress = Duration(milliseconds: status.dtsProgress),
+        delay = Duration(microseconds: status.delay),
+        frames = status.frames,
+        dropped = status.dropped,
+        allocations = status.allocations,
+        state = PlayerState.values[status.state];
+}
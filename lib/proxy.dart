@@ -0,0 +1,71 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:isolate';
+import 'dart:core';
+import 'package:ffi/ffi.dart';
+import 'package:path/path.dart' as path;
+import 'ffi.dart';
+import 'exceptions.dart';
+
+/// Returns the path of an all-intra, low resolution copy of [source] for fast scrubbing,
+/// transcoding it on a background isolate the first time it is requested.
+///
+/// Every frame of the proxy is a keyframe and keeps the timestamp of its source frame,
+/// so seeking it costs a single decode however long the GOPs of [source] are.
+/// Proxies are cached in [cacheDirectory], or in a videna folder of the system temp directory,
+/// under a name derived from the path, size and modification time of [source].
+Future<String> createVideoProxy(String source,
+    {String? cacheDirectory, int height = 360, int quality = 60}) async {
+  File file = File(source);
+  FileStat stat = await file.stat();
+  Directory cache = Directory(cacheDirectory ??
+      path.join(Directory.systemTemp.path, 'videna_proxies'));
+  await cache.create(recursive: true);
+  String key = Object.hash(file.absolute.path, stat.size,
+          stat.modified.millisecondsSinceEpoch, height, quality)
+      .toUnsigned(32)
+      .toRadixString(16);
+  String proxyPath = path.join(
+      cache.path, '${path.basenameWithoutExtension(source)}-$key.mkv');
+  if (await File(proxyPath).exists()) {
+    return proxyPath;
+  }
+  // renamed once complete, so an interrupted run is never mistaken for a proxy
+  String partialPath = path.join(
+      cache.path, '${path.basenameWithoutExtension(source)}-$key.part.mkv');
+  int frames = await Isolate.run(() {
+    initializeAPI();
+    Pointer<Utf8> nativePath = source.toNativeUtf8();
+    Pointer<Utf8> nativeProxyPath = partialPath.toNativeUtf8();
+    int ret = createProxy(nativePath, nativeProxyPath, height, quality);
+    malloc.free(nativePath);
+    malloc.free(nativeProxyPath);
+    return ret;
+  });
+  if (frames <= 0) {
+    File partial = File(partialPath);
+    if (await partial.exists()) {
+      await partial.delete();
+    }
+    throw VideoFormatException();
+  }
+  await File(partialPath).rename(proxyPath);
+  return proxyPath;
+}
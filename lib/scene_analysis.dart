@@ -0,0 +1,123 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+import 'dart:ffi';
+import 'dart:isolate';
+import 'dart:core';
+import 'package:ffi/ffi.dart';
+import 'ffi.dart';
+import 'frame.dart';
+import 'exceptions.dart';
+
+/// {@template sceneAnalysis}
+/// Settings of the native scene analysis, which compares the luma of consecutive frames
+/// before they are converted.
+///
+/// Only every [gridStep]-th pixel of every [gridStep]-th row is compared.
+/// A frame is reported as a scene cut when the difference between its luma histogram
+/// and the one of the previous frame is at least [cutThreshold], from 0 to 1.
+/// {@endtemplate}
+class SceneAnalysis {
+  int gridStep;
+  double cutThreshold;
+
+  SceneAnalysis({this.gridStep = 4, this.cutThreshold = 0.4});
+}
+
+/// The result of comparing a frame with the one before it.
+///
+/// [pts] is in stream timebase.
+/// [motion] is the mean absolute luma difference, from 0 to 255.
+/// [histogramDifference] goes from 0 to 1.
+class SceneEvent {
+  int pts;
+  Duration progress;
+  double motion;
+  double histogramDifference;
+  bool sceneCut;
+
+  SceneEvent(
+      {required this.pts,
+      required this.progress,
+      required this.motion,
+      required this.histogramDifference,
+      required this.sceneCut});
+}
+
+const int _eventBatch = 64;
+
+/// Reads the events the native analysis has accumulated for [videoState].
+List<SceneEvent> readSceneEvents(
+    Pointer<Void> videoState, Pointer<AnalysisEventNative> buffer) {
+  List<SceneEvent> events = [];
+  int read;
+  do {
+    read = readAnalysisEvents(videoState, buffer, _eventBatch);
+    for (int i = 0; i < read; i++) {
+      AnalysisEventNative event = buffer[i];
+      events.add(SceneEvent(
+          pts: event.pts,
+          progress: Duration(milliseconds: event.progress),
+          motion: event.motion,
+          histogramDifference: event.histogramDifference,
+          sceneCut: event.sceneCut != 0));
+    }
+  } while (read == _eventBatch);
+  return events;
+}
+
+Pointer<AnalysisEventNative> allocateSceneEventBuffer() {
+  return calloc<AnalysisEventNative>(_eventBatch);
+}
+
+List<SceneEvent> analyzeScenesSync(String path,
+    {SceneAnalysis? sceneAnalysis}) {
+  sceneAnalysis ??= SceneAnalysis();
+  Pointer<Void> videoState =
+      openVideo(path.toNativeUtf8(), ImageFormat.none.index, 0, 0);
+  if (videoState == nullptr) {
+    throw VideoFormatException();
+  }
+  Pointer<AnalysisEventNative> buffer = allocateSceneEventBuffer();
+  List<SceneEvent> events = [];
+  try {
+    if (enableAnalysis(videoState, sceneAnalysis.gridStep,
+            sceneAnalysis.cutThreshold) <
+        0) {
+      throw Exception("Could not start the analysis");
+    }
+    while (analyzeFrames(videoState, _eventBatch) > 0) {
+      events.addAll(readSceneEvents(videoState, buffer));
+    }
+    events.addAll(readSceneEvents(videoState, buffer));
+  } finally {
+    calloc.free(buffer);
+    disposeVideo(videoState);
+  }
+  return events;
+}
+
+/// Decodes the whole file without converting any frame and returns the differences between consecutive frames.
+///
+/// {@macro sceneAnalysis}
+Future<List<SceneEvent>> analyzeScenes(String path,
+    {SceneAnalysis? sceneAnalysis}) {
+  return Isolate.run(() {
+    initializeAPI();
+    return analyzeScenesSync(path, sceneAnalysis: sceneAnalysis);
+  });
+}
@@ -0,0 +1,37 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+import 'package:fraction/fraction.dart';
+
+/// Opens the file given to [VidenaPlayer.open] as a sequence of numbered images, like the frames
+/// of a VFX shot or a timelapse, shown at [frameRate] frames per second.
+///
+/// The file is then a printf pattern with a single integer conversion, for example `shot/frame_%04d.png`.
+/// The first image is the one numbered 0 to 4 and the sequence ends before the first missing number.
+/// Any image is reached directly by its number, so seeking costs a single image.
+///
+/// Up to [readAhead] images after the one being shown are decoded in parallel on [threads] native workers.
+/// When they are 0, the player reads 8 images ahead on one worker per core.
+class ImageSequence {
+  final Fraction frameRate;
+  final int threads;
+  final int readAhead;
+
+  ImageSequence(
+      {required this.frameRate, this.threads = 0, this.readAhead = 0});
+}
@@ -0,0 +1,64 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+import 'dart:ffi';
+import 'dart:isolate';
+import 'dart:core';
+import 'package:ffi/ffi.dart';
+import 'ffi.dart';
+import 'frame.dart';
+import 'exceptions.dart';
+
+/// {@template frameContainer}
+/// How [exportVideoFrames] lays out the frames.
+/// [y4m] is a YUV4MPEG2 stream that most video tools read, it only holds [ImageFormat.yuv420P] and [ImageFormat.gray8].
+/// [raw] writes the planes of every frame back to back without padding or headers.
+/// {@endtemplate}
+enum FrameContainer { y4m, raw }
+
+/// Decodes every frame of [path] and writes it to [outputPath] as [format], scaled to [width] x [height]
+/// or left at the size of the video when either is 0.
+///
+/// Nothing passes through Dart: demuxing and decoding, conversion and writing run on three native threads,
+/// and small frames are gathered so that every write is a few megabytes. For pipes, the `videna_cli`
+/// executable writes the same streams to its standard output.
+///
+/// Returns the number of frames written.
+///
+/// {@macro frameContainer}
+Future<int> exportVideoFrames(String path, String outputPath,
+    {FrameContainer container = FrameContainer.y4m,
+    ImageFormat format = ImageFormat.yuv420P,
+    int width = 0,
+    int height = 0}) {
+  if (format == ImageFormat.none) {
+    throw ArgumentError("Frames need a format to be written in");
+  }
+  return Isolate.run(() {
+    initializeAPI();
+    Pointer<Utf8> nativePath = path.toNativeUtf8();
+    Pointer<Utf8> nativeOutputPath = outputPath.toNativeUtf8();
+    int ret = exportFrames(nativePath, nativeOutputPath, -1, container.index,
+        format.index, width, height);
+    malloc.free(nativePath);
+    malloc.free(nativeOutputPath);
+    if (ret < 0) {
+      throw VideoFormatException();
+    }
+    return ret;
+  });
+}
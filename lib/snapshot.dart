@@ -0,0 +1,107 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+import 'dart:ffi';
+import 'dart:isolate';
+import 'dart:core';
+import 'dart:typed_data';
+import 'package:ffi/ffi.dart';
+import 'ffi.dart';
+import 'exceptions.dart';
+
+/// {@template snapshotFormat}
+/// Image formats the native encoder can write.
+/// The quality of [jpeg] images goes from 1 to 100, [png] is lossless and ignores it.
+/// {@endtemplate}
+enum SnapshotFormat { png, jpeg }
+
+/// Encodes the last frame output by the native video state at [videoStateAddress].
+/// Returns null when no frame has been decoded yet.
+Future<Uint8List?> encodeNativeSnapshot(
+    int videoStateAddress, SnapshotFormat format, int quality) {
+  return Isolate.run(() {
+    initializeAPI();
+    Pointer<Pointer<Uint8>> data = calloc<Pointer<Uint8>>();
+    int size = encodeSnapshot(Pointer<Void>.fromAddress(videoStateAddress),
+        format.index, quality, data);
+    Uint8List? image;
+    if (size > 0) {
+      image = Uint8List.fromList(data.value.asTypedList(size));
+      freeSnapshot(data.value);
+    }
+    calloc.free(data);
+    return image;
+  });
+}
+
+/// Saves the frame of [path] at [position] to [outputPath].
+///
+/// {@macro snapshotFormat}
+Future<void> saveVideoFrame(String path, Duration position, String outputPath,
+    {SnapshotFormat format = SnapshotFormat.png, int quality = 90}) {
+  return Isolate.run(() {
+    initializeAPI();
+    Pointer<Utf8> nativePath = path.toNativeUtf8();
+    Pointer<Utf8> nativeOutputPath = outputPath.toNativeUtf8();
+    int ret = saveFrameAt(nativePath, position.inMilliseconds,
+        nativeOutputPath, format.index, quality);
+    malloc.free(nativePath);
+    malloc.free(nativeOutputPath);
+    if (ret < 0) {
+      throw VideoFormatException();
+    }
+  });
+}
+
+/// Saves the frame of [path] at every position in [positions] to the file at the same index of [outputPaths].
+/// The frames are decoded and encoded on up to [threads] threads, or one per core when [threads] is 0.
+///
+/// Returns whether each frame was saved.
+///
+/// {@macro snapshotFormat}
+Future<List<bool>> saveVideoFrames(
+    String path, List<Duration> positions, List<String> outputPaths,
+    {SnapshotFormat format = SnapshotFormat.png,
+    int quality = 90,
+    int threads = 0}) {
+  if (positions.length != outputPaths.length) {
+    throw ArgumentError("Every position needs an output path");
+  }
+  return Isolate.run(() {
+    initializeAPI();
+    int count = positions.length;
+    Pointer<Utf8> nativePath = path.toNativeUtf8();
+    Pointer<Int64> nativePositions = calloc<Int64>(count);
+    Pointer<Pointer<Utf8>> nativeOutputPaths = calloc<Pointer<Utf8>>(count);
+    Pointer<Int> results = calloc<Int>(count);
+    for (int i = 0; i < count; i++) {
+      nativePositions[i] = positions[i].inMilliseconds;
+      nativeOutputPaths[i] = outputPaths[i].toNativeUtf8();
+    }
+    saveFramesAt(nativePath, nativePositions, nativeOutputPaths, count,
+        format.index, quality, threads, results);
+    List<bool> ret = [for (int i = 0; i < count; i++) results[i] == 0];
+    for (int i = 0; i < count; i++) {
+      malloc.free(nativeOutputPaths[i]);
+    }
+    malloc.free(nativePath);
+    calloc.free(nativePositions);
+    calloc.free(nativeOutputPaths);
+    calloc.free(results);
+    return ret;
+  });
+}
@@ -0,0 +1,108 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+import 'dart:typed_data';
+import 'ffi.dart';
+
+/// Element type of a [Tensor].
+///
+/// Dart has no 16 bit float list, so [float16] tensors hold the IEEE 754 half precision bits in a [Uint16List].
+/// [uint8] tensors hold the RGB values in 0..255 and ignore the normalization of [TensorOutput].
+enum TensorType { float32, float16, uint8 }
+
+/// How the picture is fitted into the tensor.
+///
+/// [stretch] ignores the aspect ratio, [letterbox] fits the whole picture and pads the rest with [TensorOutput.pad],
+/// [crop] fills the tensor and cuts off the sides of the picture that don't fit.
+enum TensorResize { stretch, letterbox, crop }
+
+/// Asks a [VidenaPlayer] for a copy of every output frame laid out for inference,
+/// as planar RGB tensors of shape [batch, 3, height, width].
+///
+/// Every channel value is computed as (value / 255 - mean) / std, with one [mean] and [std] per channel.
+/// The resize, conversion and normalization are done natively in a single pass over the output.
+class TensorOutput {
+  final int width;
+  final int height;
+  final TensorType type;
+  final TensorResize resize;
+  final List<double> mean;
+  final List<double> std;
+
+  /// Value of the letterbox padding in pixel units, from 0 to 255.
+  final double pad;
+
+  /// Frames packed into one tensor.
+  final int batch;
+
+  const TensorOutput(
+      {required this.width,
+      required this.height,
+      this.type = TensorType.float32,
+      this.resize = TensorResize.letterbox,
+      this.mean = const [0, 0, 0],
+      this.std = const [1, 1, 1],
+      this.pad = 114,
+      this.batch = 1});
+}
+
+/// A batch of frames output by a [VidenaPlayer] opened with a [TensorOutput].
+class Tensor {
+  /// [Float32List], [Uint16List] or [Uint8List] according to [type], in [batch, 3, height, width] order.
+  final TypedData data;
+  final int batch;
+  final int width;
+  final int height;
+  final TensorType type;
+
+  /// Of the first frame in the batch, in stream timebase.
+  final int pts;
+  final Duration progress;
+
+  const Tensor(
+      {required this.data,
+      required this.batch,
+      required this.width,
+      required this.height,
+      required this.type,
+      required this.pts,
+      required this.progress});
+
+  /// Copies the batch held by [frame], which can be released right after.
+  factory Tensor.fromNative(FrameNative frame) {
+    TensorType type = TensorType.values[frame.format];
+    Uint8List bytes = Uint8List.fromList(frame.data.asTypedList(frame.size));
+    int elementSize = type == TensorType.float32
+        ? 4
+        : type == TensorType.float16
+            ? 2
+            : 1;
+    TypedData data = type == TensorType.float32
+        ? bytes.buffer.asFloat32List()
+        : type == TensorType.float16
+            ? bytes.buffer.asUint16List()
+            : bytes;
+    return Tensor(
+        data: data,
+        batch: frame.size ~/ (elementSize * 3 * frame.width * frame.height),
+        width: frame.width,
+        height: frame.height,
+        type: type,
+        pts: frame.pts,
+        progress: Duration(milliseconds: frame.progress));
+  }
+}
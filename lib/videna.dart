@@ -22,14 +22,40 @@ import 'dart:async';
 import 'package:async/async.dart';
 import 'dart:isolate';
 import 'dart:core';
+import 'dart:typed_data';
 import 'package:ffi/ffi.dart';
+import 'package:flutter/services.dart';
 import 'package:fraction/fraction.dart';
 import 'install.dart';
 import 'ffi.dart';
+import 'ffi.dart' as ffi;
 import 'frame.dart';
 export 'frame.dart';
 import 'media_metadata.dart';
 export 'media_metadata.dart';
+import 'scene_analysis.dart';
+export 'scene_analysis.dart' show SceneAnalysis, SceneEvent, analyzeScenes;
+export 'fingerprint.dart';
+export 'clip.dart';
+export 'sink.dart';
+import 'snapshot.dart';
+export 'snapshot.dart' show SnapshotFormat, saveVideoFrame, saveVideoFrames;
+import 'proxy.dart';
+export 'proxy.dart';
+import 'memory_usage.dart';
+export 'memory_usage.dart';
+import 'player_status.dart';
+export 'player_status.dart';
+import 'tensor.dart';
+export 'tensor.dart';
+import 'placement.dart';
+export 'placement.dart';
+import 'filter.dart';
+export 'filter.dart';
+import 'sequence.dart';
+export 'sequence.dart';
+import 'frame_server.dart';
+export 'frame_server.dart';
 import 'exceptions.dart';
 
 int isNavigatorInitialized = 0;
@@ -58,11 +84,88 @@ abstract class Videna {
     isNavigatorInitialized = 1;
     return;
   }
+
+  /// Sets the number of bytes the native memory of all the open videos should fit in.
+  /// Background videos give up memory first, see [VidenaPlayer.setBackground].
+  /// A budget of 0 removes the limit.
+  static void setMemoryBudget(int bytes) {
+    if (isNavigatorInitialized == 0) {
+      initialize();
+    }
+    ffi.setMemoryBudget(bytes);
+  }
+
+  /// Returns the native memory held by all the open videos.
+  static MemoryUsage memoryUsage() {
+    if (isNavigatorInitialized == 0) {
+      initialize();
+    }
+    return MemoryUsage.fromNative(totalMemoryUsage());
+  }
+
+  /// Sets where the native threads of the videos opened from now on run, along with the threads of
+  /// snapshots, fingerprints, proxies and frame exports. FFmpeg's codec threads inherit it.
+  /// Each [VidenaPlayer] can change its own with [VidenaPlayer.setThreadPlacement].
+  static void setDefaultThreadPlacement(ThreadPlacement placement) {
+    if (isNavigatorInitialized == 0) {
+      initialize();
+    }
+    ffi.setDefaultPlacement(
+        placement.cpuMask, placement.nice, placement.realtime);
+  }
+
+  /// Starts recording when every stage of the native pipeline (demuxing, decoding, conversion, seeks, http reads)
+  /// begins and ends, on every thread and for every open video. Events of an earlier recording are dropped.
+  /// While tracing is off the stages only check a flag.
+  static void startTracing() {
+    if (isNavigatorInitialized == 0) {
+      initialize();
+    }
+    ffi.startTracing();
+  }
+
+  /// Stops the recording started with [startTracing], keeping its events for [dumpTrace].
+  static void stopTracing() {
+    if (isNavigatorInitialized == 0) {
+      initialize();
+    }
+    ffi.stopTracing();
+  }
+
+  /// Writes the recorded events to [path] in the Chrome trace event format,
+  /// which ui.perfetto.dev and chrome://tracing open. Every video is shown as its own process.
+  /// Only the newest events of each thread are kept, so the oldest ones of a long recording are missing.
+  ///
+  /// Returns the number of events written.
+  static Future<int> dumpTrace(String path) {
+    if (isNavigatorInitialized == 0) {
+      initialize();
+    }
+    return Isolate.run(() {
+      initializeAPI();
+      Pointer<Utf8> nativePath = path.toNativeUtf8();
+      int ret = ffi.dumpTrace(nativePath);
+      malloc.free(nativePath);
+      if (ret < 0) {
+        throw FileSystemException("Could not write the trace", path);
+      }
+      return ret;
+    });
+  }
 }
 
+// Filled by the native side for every frame the decode isolate retrieves, instead of a struct returned by value.
+// The frame of the proxy has its own, the one of the source is still read after scrubbing.
+late Pointer<FrameNative> _frameBuffer;
+late Pointer<FrameNative> _proxyFrameBuffer;
+late Pointer<FrameNative> _outputBuffer;
+
 FrameNative? _sendFrame(Pointer<Void> videoState, MediaMetadata m,
-    SendPort playerPort, double speed) {
-  FrameNative nativeFrame = retrieveFrame(videoState);
+    SendPort playerPort, double speed,
+    {Pointer<FrameNative>? buffer}) {
+  buffer ??= _frameBuffer;
+  retrieveFrame(videoState, buffer);
+  FrameNative nativeFrame = buffer.ref;
   if (nativeFrame.exists == -1) {
     return null;
   }
@@ -71,39 +174,104 @@ FrameNative? _sendFrame(Pointer<Void> videoState, MediaMetadata m,
       width: nativeFrame.width,
       height: nativeFrame.height,
       format: ImageFormat.values[nativeFrame.format],
+      stride: nativeFrame.stride,
+      chromaStride: nativeFrame.chromaStride,
       size: nativeFrame.size,
       pts: nativeFrame.pts,
       dts: nativeFrame.dts,
-      delay: (nativeFrame.delay / speed).floor()));
+      delay: (nativeFrame.delay / speed.abs()).floor()));
 
   return nativeFrame;
 }
 
-void _sendImageMetadata(
-    FrameNative nativeFrame, SendPort metadataPort, double speed) {
-  metadataPort.send(VideoFrameMetadata(
-      pts: nativeFrame.pts,
-      dts: nativeFrame.dts,
-      delay: Duration(microseconds: (nativeFrame.delay / speed).floor()),
-      size: nativeFrame.size,
-      imageFormat: ImageFormat.values[nativeFrame.format],
-      width: nativeFrame.width,
-      height: nativeFrame.height));
+/// Shows the frame in the texture of [videoState] instead of sending it, when [paced]
+/// at its presentation time. Only its description reaches Dart, for the progress.
+FrameNative? _presentFrame(Pointer<Void> videoState, bool paced,
+    {Pointer<FrameNative>? buffer}) {
+  buffer ??= _frameBuffer;
+  retrieveFrame(videoState, buffer);
+  FrameNative nativeFrame = buffer.ref;
+  if (nativeFrame.exists == -1) {
+    return null;
+  }
+  // the pixels were staged in the texture by the decoder, the frame can be decoded over
+  freeFrame(videoState);
+  presentTextureFrame(videoState, paced ? 1 : 0);
+  return nativeFrame;
+}
+
+void _sendRenditions(
+    Pointer<Void> videoState, List<SendPort> renditionPorts, double speed) {
+  for (int i = 0; i < renditionPorts.length; i++) {
+    retrieveRendition(videoState, i + 1, _outputBuffer);
+    FrameNative nativeFrame = _outputBuffer.ref;
+    if (nativeFrame.exists == 1) {
+      renditionPorts[i].send(VideoFrame(
+          content: nativeFrame.data.asTypedList(nativeFrame.size),
+          width: nativeFrame.width,
+          height: nativeFrame.height,
+          format: ImageFormat.values[nativeFrame.format],
+          stride: nativeFrame.stride,
+          chromaStride: nativeFrame.chromaStride,
+          size: nativeFrame.size,
+          pts: nativeFrame.pts,
+          dts: nativeFrame.dts,
+          delay: (nativeFrame.delay / speed.abs()).floor()));
+    }
+    freeRendition(videoState, i + 1);
+  }
+}
+
+void _sendTracks(
+    Pointer<Void> videoState, List<SendPort> trackPorts, double speed) {
+  for (int i = 0; i < trackPorts.length; i++) {
+    retrieveTrack(videoState, i + 1, _outputBuffer);
+    FrameNative nativeFrame = _outputBuffer.ref;
+    if (nativeFrame.exists == 1) {
+      trackPorts[i].send(VideoFrame(
+          content: nativeFrame.data.asTypedList(nativeFrame.size),
+          width: nativeFrame.width,
+          height: nativeFrame.height,
+          format: ImageFormat.values[nativeFrame.format],
+          stride: nativeFrame.stride,
+          chromaStride: nativeFrame.chromaStride,
+          size: nativeFrame.size,
+          pts: nativeFrame.pts,
+          dts: nativeFrame.dts,
+          delay: (nativeFrame.delay / speed.abs()).floor()));
+    }
+    freeTrack(videoState, i + 1);
+  }
+}
+
+void _sendTensor(Pointer<Void> videoState, SendPort? tensorPort) {
+  if (tensorPort == null) {
+    return;
+  }
+  FrameNative nativeTensor = retrieveTensor(videoState);
+  if (nativeTensor.exists == 1) {
+    tensorPort.send(Tensor.fromNative(nativeTensor));
+    freeTensor(videoState);
+  }
 }
 
 FrameNative? _seekPrec(Pointer<Void> videoState, int newPts, int flag,
-    _Connections connections, MediaMetadata m) {
+    _Connections connections, MediaMetadata m,
+    [Pointer<FrameNative>? buffer]) {
   FrameNative? nativeFrame;
   if (newPts < 0) {
     return null;
   }
   int ret = seekPrecise(videoState, newPts, flag);
   if (ret >= 0) {
-    nativeFrame =
-        _sendFrame(videoState, m, connections.imagePort!, double.infinity);
+    nativeFrame = connections.texture
+        ? _presentFrame(videoState, false, buffer: buffer)
+        : _sendFrame(videoState, m, connections.imagePort!, double.infinity,
+            buffer: buffer);
+    _sendRenditions(videoState, connections.renditionPorts, double.infinity);
+    _sendTracks(videoState, connections.trackPorts, double.infinity);
+    _sendTensor(videoState, connections.tensorPort);
     if (nativeFrame != null) {
-      _sendImageMetadata(
-          nativeFrame, connections.imageMetadataPort!, double.infinity);
       connections.progressPort!.send(
           Progress(Duration(milliseconds: nativeFrame.progress), m.duration));
       return nativeFrame;
@@ -114,8 +282,17 @@ FrameNative? _seekPrec(Pointer<Void> videoState, int newPts, int flag,
   return null;
 }
 
+/// Milliseconds of playback between two [Progress] messages of the decode isolate.
+const int _progressInterval = 250;
+
+/// Fastest speed of [VidenaPlayer.setPlaybackSpeed], forward or backward.
+const double maxPlaybackSpeed = 64;
+
 void _decode(List survivalPack) async {
   initializeDecoder();
+  _frameBuffer = calloc<FrameNative>();
+  _proxyFrameBuffer = calloc<FrameNative>();
+  _outputBuffer = calloc<FrameNative>();
 
   bool quit = false;
   bool paused = false;
@@ -129,10 +306,37 @@ void _decode(List survivalPack) async {
   Pointer<Void> videoState = Pointer<Void>.fromAddress(survivalPack[0]);
   MediaMetadata m = survivalPack[1];
   int startOnPause = survivalPack[4] ? 1 : 0;
+  Pointer<AnalysisEventNative>? sceneBuffer;
+  if (connections.scenePort != null) {
+    sceneBuffer = allocateSceneEventBuffer();
+  }
+  int lastProgress = -_progressInterval;
+  // playback wraps at the end of the loop instead of stopping at the end of the file
+  bool looping = false;
+  // position of the last frame shown from the proxy, the source still has to catch up to it
+  int? scrubPosition;
+  void settleScrub() {
+    if (scrubPosition == null) {
+      return;
+    }
+    int position = scrubPosition!;
+    scrubPosition = null;
+    try {
+      nativeFrame = _seekPrec(videoState,
+          calculateTimeStamp(videoState, position), 1, connections, m);
+      if (nativeFrame != null) {
+        pts = nativeFrame!.pts;
+      }
+    } catch (e) {
+      // Everything is fine, but eof has been reached
+    }
+  }
+
   ReceivePort controlPort = ReceivePort()
     ..listen((message) {
       switch (message[0]) {
         case 'play':
+          settleScrub();
           paused = false;
           eventQ.clear();
           completer.complete();
@@ -145,6 +349,7 @@ void _decode(List survivalPack) async {
           paused = true;
           break;
         case 'toggle':
+          settleScrub();
           paused = !paused;
           eventQ.clear();
           if (!paused) {
@@ -152,11 +357,13 @@ void _decode(List survivalPack) async {
           }
           break;
         case 'pulse':
-          if (nativeFrame != null) {
+          // the texture keeps showing the last frame by itself
+          if (nativeFrame != null && !connections.texture) {
             _sendFrame(videoState, m, connections.imagePort!, double.infinity);
           }
           break;
         case 'seekTime':
+          scrubPosition = null;
           int backwards = 0;
           if (nativeFrame != null && nativeFrame!.progress > message[1]) {
             backwards = 1;
@@ -165,6 +372,7 @@ void _decode(List survivalPack) async {
           seekTime(videoState, message[1], backwards);
           break;
         case 'seekPrecise':
+          scrubPosition = null;
           if (message[1] < m.duration) {
             try {
               nativeFrame = _seekPrec(
@@ -183,6 +391,87 @@ void _decode(List survivalPack) async {
             }
           }
           break;
+        case 'proxy':
+          Pointer<Utf8> nativePath = message[1].toNativeUtf8();
+          attachProxy(videoState, nativePath);
+          malloc.free(nativePath);
+          break;
+        case 'scrub':
+          paused = true;
+          eventQ.clear();
+          Pointer<Void> proxy = proxyState(videoState);
+          if (proxy == nullptr || message[1] >= m.duration.inMilliseconds) {
+            scrubPosition = message[1];
+            settleScrub();
+            break;
+          }
+          try {
+            FrameNative? proxyFrame = _seekPrec(
+                proxy,
+                calculateTimeStamp(proxy, message[1]),
+                1,
+                connections,
+                m,
+                _proxyFrameBuffer);
+            // the frame was copied into the message, nothing else will release it
+            freeFrame(proxy);
+            if (proxyFrame != null) {
+              scrubPosition = message[1];
+            }
+          } catch (e) {
+            // Everything is fine, but eof has been reached
+          }
+          break;
+        case 'outputRate':
+          setOutputRate(videoState, message[1], message[2]);
+          break;
+        case 'loop':
+          scrubPosition = null;
+          if (setLoop(videoState, message[1], message[2], message[3]) < 0) {
+            break;
+          }
+          looping = true;
+          try {
+            nativeFrame = _seekPrec(videoState,
+                calculateTimeStamp(videoState, message[1]), 1, connections, m);
+            if (nativeFrame != null) {
+              pts = nativeFrame!.pts;
+            }
+          } catch (e) {
+            // Everything is fine, but eof has been reached
+          }
+          break;
+        case 'clearLoop':
+          looping = false;
+          // the frame on screen came from the cache, the decoder has to catch up to it
+          if (clearLoop(videoState) == 1 && nativeFrame != null) {
+            try {
+              nativeFrame = _seekPrec(
+                  videoState,
+                  calculateTimeStamp(videoState, nativeFrame!.progress),
+                  1,
+                  connections,
+                  m);
+              if (nativeFrame != null) {
+                pts = nativeFrame!.pts;
+              }
+            } catch (e) {
+              // Everything is fine, but eof has been reached
+            }
+          }
+          break;
+        case 'duration':
+          m.duration = Duration(milliseconds: message[1]);
+          break;
+        case 'background':
+          setBackground(videoState, message[1] ? 1 : 0);
+          break;
+        case 'placement':
+          setThreadPlacement(videoState, message[1], message[2], message[3]);
+          break;
+        case 'endScrub':
+          settleScrub();
+          break;
         case 'seekForward':
           if (pts < 0) {
             break;
@@ -203,10 +492,18 @@ void _decode(List survivalPack) async {
           break;
         case 'speed':
           speed = message[1];
+          setTrickSpeed(videoState, speed);
           break;
         case 'resize':
           resize(videoState, message[1].numerator, message[1].denominator);
           break;
+        case 'resizeRendition':
+          resizeRendition(videoState, message[1], message[2], message[3]);
+          break;
+        case 'region':
+          setRegion(videoState, message[1], message[2], message[3], message[4],
+              message[5], message[6]);
+          break;
         case 'quit':
           paused = true;
           quit = true;
@@ -216,7 +513,12 @@ void _decode(List survivalPack) async {
         default:
           break;
       }
+      if (!quit) {
+        setPlayerState(videoState, paused ? statePaused : statePlaying);
+      }
     });
+  setTrickSpeed(videoState, speed);
+  setPlayerState(videoState, statePlaying);
   connections.setupPort.send([controlPort.sendPort]);
   while (!quit) {
     if (!paused) {
@@ -229,19 +531,42 @@ void _decode(List survivalPack) async {
           startOnPause--;
           paused = true;
         }
-        nativeFrame = _sendFrame(videoState, m, connections.imagePort!, speed);
+        nativeFrame = connections.texture
+            ? _presentFrame(videoState, true)
+            : _sendFrame(videoState, m, connections.imagePort!, speed);
         if (nativeFrame == null) {
           quit = true;
           paused = true;
           break;
         }
-        connections.progressPort!.send(Progress(
-            Duration(milliseconds: nativeFrame!.progress), m.duration));
-        if ((nativeFrame!.dtsProgress + nativeFrame!.delay / 1000) >=
-            m.duration.inMilliseconds) {
+        _sendRenditions(videoState, connections.renditionPorts, speed);
+        _sendTracks(videoState, connections.trackPorts, speed);
+        _sendTensor(videoState, connections.tensorPort);
+        if (sceneBuffer != null) {
+          List<SceneEvent> events = readSceneEvents(videoState, sceneBuffer);
+          if (events.isNotEmpty) {
+            connections.scenePort!.send(events);
+          }
+        }
+        bool ended = (nativeFrame!.dtsProgress + nativeFrame!.delay / 1000) >=
+            m.duration.inMilliseconds;
+        // the exact position is in the status block, the port only carries enough for a progress bar
+        if (ended ||
+            (nativeFrame!.progress - lastProgress).abs() >= _progressInterval) {
+          lastProgress = nativeFrame!.progress;
+          connections.progressPort!.send(Progress(
+              Duration(milliseconds: nativeFrame!.progress), m.duration));
+        }
+        if (ended && !looping) {
           paused = true; // EOF
+          setPlayerState(videoState, stateEnded);
         }
         await Future.delayed(const Duration(microseconds: 1));
+      } else if (pts == reachedStart) {
+        // rewinding stops at the start like playing stops at the end
+        pts = nativeFrame?.pts ?? -1;
+        paused = true;
+        setPlayerState(videoState, stateEnded);
       } else {
         quit = true;
         paused = true;
@@ -276,7 +601,13 @@ void _decode(List survivalPack) async {
       completer = Completer();
     }
   }
+  if (sceneBuffer != null) {
+    calloc.free(sceneBuffer);
+  }
   disposeVideo(videoState);
+  calloc.free(_frameBuffer);
+  calloc.free(_proxyFrameBuffer);
+  calloc.free(_outputBuffer);
   controlPort.close();
   Isolate.exit();
 }
@@ -320,6 +651,9 @@ Function _getFormatStrategy(ProcessStrategy imgFormat) {
       return processImageFromRgba;
     case ProcessStrategy.custom:
       return () {};
+    case ProcessStrategy.texture:
+      // the decode isolate shows the frames itself, none are sent here
+      return () {};
   }
 }
 
@@ -335,8 +669,47 @@ Function _getFormatStrategy(ProcessStrategy imgFormat) {
 ///
 /// [ProcessStrategy.custom] allows specifying a custom function to
 /// execute on each frame.
+///
+/// [ProcessStrategy.texture] draws the frames into the texture [VidenaPlayer.textureId]
+/// without copying them through Dart, show it with a [Texture] widget.
+/// The frames are shown natively at their presentation time, so the image streams
+/// stay empty and only the progress is reported.
+/// It's only available on Linux and needs [ImageFormat.rgba].
 /// {@endtemplate}
-enum ProcessStrategy { raw, image, custom }
+enum ProcessStrategy { raw, image, custom, texture }
+
+/// An additional output of a [VidenaPlayer].
+///
+/// Every rendition is converted from the same decoded frame as the main output,
+/// so the video is only decoded once no matter how many renditions are requested.
+/// A [width] or [height] of 0 keeps the size of the source.
+class Rendition {
+  ImageFormat imageFormat;
+  int width;
+  int height;
+
+  Rendition(
+      {this.imageFormat = ImageFormat.rgba, this.width = 0, this.height = 0});
+}
+
+/// Another video stream of the file opened by a [VidenaPlayer], such as a second camera angle.
+///
+/// Tracks are decoded from the packets read for the main stream, so the file is only demuxed once.
+/// Each frame of a track is delivered when the main stream reaches its pts.
+/// A null [streamIndex] picks the best video stream that isn't decoded yet.
+/// A [width] or [height] of 0 keeps the size of the stream.
+class VideoTrack {
+  int? streamIndex;
+  ImageFormat imageFormat;
+  int width;
+  int height;
+
+  VideoTrack(
+      {this.streamIndex,
+      this.imageFormat = ImageFormat.rgba,
+      this.width = 0,
+      this.height = 0});
+}
 
 class Progress {
   Duration progress;
@@ -350,32 +723,37 @@ void _process(
     Stream stream,
     Pointer<Void> nativeVideoState,
     Completer termination,
-    StreamController syncController) async {
+    StreamController syncController,
+    StreamController<VideoFrameMetadata> metadataController) async {
   StreamQueue frameEvents = StreamQueue(stream);
-  Duration clockAsOfNextFrame = Duration.zero;
-  Duration clockAsOfLastFrame = Duration.zero;
+  // in microseconds, so pacing a frame doesn't create Durations
+  int clockAsOfNextFrame = 0;
+  int clockAsOfLastFrame = 0;
   dynamic frame;
   dynamic ret;
 
   Stopwatch stopwatch = Stopwatch()..start();
   while (await frameEvents.hasNext && !termination.isCompleted) {
     frame = await frameEvents.next;
-    clockAsOfNextFrame =
-        clockAsOfLastFrame + Duration(microseconds: frame.delay);
+    clockAsOfNextFrame = clockAsOfLastFrame + (frame.delay as int);
     if (!termination.isCompleted) {
+      // built here from the frame rather than sent by the decode isolate alongside it,
+      // and only once something listens to it
+      if (metadataController.hasListener) {
+        metadataController.add(VideoFrameMetadata.fromFrame(frame));
+      }
       ret = await formatProcess(frame);
       freeFrame(nativeVideoState);
     }
-    if (clockAsOfNextFrame < stopwatch.elapsed) {
-      clockAsOfNextFrame = stopwatch.elapsed;
+    if (clockAsOfNextFrame < stopwatch.elapsedMicroseconds) {
+      clockAsOfNextFrame = stopwatch.elapsedMicroseconds;
     }
-    if ((clockAsOfNextFrame.inMicroseconds - stopwatch.elapsedMicroseconds) >
-        0) {
+    if ((clockAsOfNextFrame - stopwatch.elapsedMicroseconds) > 0) {
       await Future.delayed(
           Duration(
-              milliseconds: (clockAsOfNextFrame.inMicroseconds -
-                      stopwatch.elapsedMicroseconds) ~/
-                  1000), () {
+              milliseconds:
+                  (clockAsOfNextFrame - stopwatch.elapsedMicroseconds) ~/
+                      1000), () {
         clockAsOfLastFrame = clockAsOfNextFrame;
         syncController.add(ret);
       });
@@ -389,13 +767,18 @@ void _process(
 class _Connections {
   SendPort setupPort;
   SendPort? imagePort;
-  SendPort? imageMetadataPort;
   SendPort? progressPort;
+  List<SendPort> renditionPorts = [];
+  List<SendPort> trackPorts = [];
+  SendPort? scenePort;
+  SendPort? tensorPort;
+  // true when the frames are drawn into a native texture, only the progress is sent then
+  bool texture = false;
 
   _Connections(this.setupPort);
 
-  _Connections.fromAll(this.setupPort, this.imagePort, this.imageMetadataPort,
-      this.progressPort);
+  _Connections.fromAll(this.setupPort, this.imagePort, this.progressPort,
+      [this.renditionPorts = const []]);
 }
 
 /// An object used for decoding video.
@@ -405,21 +788,45 @@ class _Connections {
 ///
 /// When a video is closed, so are all the streams made available by this object.
 class VidenaPlayer {
+  static const MethodChannel _channel = MethodChannel('videna');
   ReceivePort? _setupPort;
   Stream? _setupStream;
   ReceivePort? _imageStream;
-  ReceivePort? _imageMetadataStream;
   StreamController<VideoFrame>? _imageStreamController;
+  StreamController<VideoFrameMetadata>? _imageMetadataController;
+  Pointer<PlayerStatusNative>? _status;
   ReceivePort? _progressStream;
+  ReceivePort? _sceneStream;
+  ReceivePort? _tensorStream;
+  List<ReceivePort> _renditionStreams = [];
+  List<ReceivePort> _trackStreams = [];
   SendPort? _controllerPort;
   Pointer<Void>? _videoState;
+
+  /// The texture the frames are drawn into with [ProcessStrategy.texture].
+  int? textureId;
   Function(Frame)? imageCallback;
   Function(Progress)? progressCallback;
   Function(VideoFrameMetadata)? imageMetadataCallback;
   MediaMetadata? metadata;
+
+  /// Every frame arrives as a new [VideoFrame] with a copy of its pixels, as a port message can't fill an existing one.
+  /// [ProcessStrategy.texture] sends none.
   Stream<VideoFrame>? imageStream;
   Stream<VideoFrameMetadata>? imageMetadataStream;
   Stream<Progress>? progressStream;
+
+  /// One stream per [Rendition] passed to [open], in the same order.
+  List<Stream<VideoFrame>> renditionStreams = [];
+
+  /// One stream per [VideoTrack] passed to [open], in the same order.
+  List<Stream<VideoFrame>> trackStreams = [];
+
+  /// Events of the scene analysis, only available when [open] was given a [SceneAnalysis].
+  Stream<List<SceneEvent>>? sceneStream;
+
+  /// Batches of frames laid out for inference, only available when [open] was given a [TensorOutput].
+  Stream<Tensor>? tensorStream;
   StreamSubscription? imageSub;
   StreamSubscription? imageMetaSub;
   StreamSubscription? progressSub;
@@ -429,27 +836,129 @@ class VidenaPlayer {
       {this.imageCallback, this.progressCallback, this.imageMetadataCallback});
 
   /// {@macro processStrategy}
+  ///
+  /// With [fastStart] the file is opened on a background isolate with bounded probing,
+  /// and the first frame is converted before the decode loop starts.
+  /// The duration in [metadata] is the one declared by the container until the exact one is found.
+  ///
+  /// With [tensorOutput] every output frame is also copied into [tensorStream], starting with the one after
+  /// the first frame when [fastStart] or [filter] is used.
+  ///
+  /// With [filter] the frames go through a native filter graph before they are output.
+  /// The graph is built while opening, filters it can't be built with throw a [VideoFormatException].
+  ///
+  /// With [sequence], [file] is the pattern of a numbered image sequence, see [ImageSequence].
+  ///
+  /// With [frameServer] the converted frames are also published for other processes, see [FrameServer].
   Future<void> open(
       {required String file,
       ImageFormat imageFormat = ImageFormat.rgba,
       ProcessStrategy processStrategy = ProcessStrategy.image,
       Future<Frame> Function(Frame)? postProcess,
       double speed = 1,
-      bool startOnPause = false}) async {
+      bool startOnPause = false,
+      List<Rendition> renditions = const [],
+      List<VideoTrack> tracks = const [],
+      SceneAnalysis? sceneAnalysis,
+      TensorOutput? tensorOutput,
+      VideoFilter? filter,
+      ImageSequence? sequence,
+      FrameServer? frameServer,
+      bool fastStart = false}) async {
     if (speed <= 0) {
       throw Exception("Illegal speed value");
     }
+    if (sequence != null && filter != null) {
+      throw ArgumentError("Image sequences can't be filtered");
+    }
+    if (processStrategy == ProcessStrategy.texture &&
+        (!Platform.isLinux || imageFormat != ImageFormat.rgba)) {
+      throw ArgumentError("Textures are only available on Linux with rgba");
+    }
     await close();
     if (disposal != null) {
       await disposal!.future;
       disposal = null;
     }
     _initializeStreams();
-    metadata = await getMediaMetadata(file);
-    _videoState = openVideo(file.toNativeUtf8(), imageFormat.index, 0, 0);
+    Future<MediaMetadata>? exactMetadata;
+    if (sequence != null) {
+      List? opened = await _openSequence(file, imageFormat, sequence);
+      if (opened == null) {
+        throw VideoFormatException();
+      }
+      _videoState = Pointer<Void>.fromAddress(opened[0]);
+      metadata = opened[1];
+    } else if (fastStart || filter != null) {
+      List? opened = await _openFast(file, imageFormat, filter, fastStart);
+      if (opened == null) {
+        throw VideoFormatException();
+      }
+      _videoState = Pointer<Void>.fromAddress(opened[0]);
+      if (fastStart) {
+        metadata = opened[1];
+        // the duration declared by the container is replaced by the exact one once it is known
+        exactMetadata = getMediaMetadata(file);
+      } else {
+        metadata = await getMediaMetadata(file);
+      }
+    } else {
+      metadata = await getMediaMetadata(file);
+      _videoState = openVideo(file.toNativeUtf8(), imageFormat.index, 0, 0);
+    }
     if (_videoState == nullptr) {
       throw VideoFormatException();
     }
+    for (Rendition rendition in renditions) {
+      if (addRendition(_videoState!, rendition.imageFormat.index,
+              rendition.width, rendition.height) <
+          0) {
+        throw Exception("Could not create rendition");
+      }
+      ReceivePort port = ReceivePort();
+      _renditionStreams.add(port);
+      renditionStreams.add(port.asBroadcastStream().cast());
+    }
+    for (VideoTrack track in tracks) {
+      if (addTrack(_videoState!, track.streamIndex ?? -1,
+              track.imageFormat.index, track.width, track.height) <
+          0) {
+        throw Exception("Could not decode track");
+      }
+      ReceivePort port = ReceivePort();
+      _trackStreams.add(port);
+      trackStreams.add(port.asBroadcastStream().cast());
+    }
+    if (sceneAnalysis != null) {
+      if (enableAnalysis(_videoState!, sceneAnalysis.gridStep,
+              sceneAnalysis.cutThreshold) <
+          0) {
+        throw Exception("Could not start the analysis");
+      }
+      _sceneStream = ReceivePort();
+      sceneStream = _sceneStream!.asBroadcastStream().cast();
+    }
+    if (tensorOutput != null) {
+      _enableTensor(tensorOutput);
+      _tensorStream = ReceivePort();
+      tensorStream = _tensorStream!.asBroadcastStream().cast();
+    }
+    if (frameServer != null) {
+      Pointer<Utf8> nativeName = frameServer.name.toNativeUtf8();
+      int ret = enableFrameServer(_videoState!, nativeName, frameServer.slots,
+          frameServer.policy.index);
+      malloc.free(nativeName);
+      if (ret < 0) {
+        throw Exception("Could not start the frame server");
+      }
+    }
+    if (processStrategy == ProcessStrategy.texture) {
+      textureId = await _channel.invokeMethod<int>(
+          'createTexture', {'videoState': _videoState!.address});
+      if (textureId == null) {
+        throw Exception("Could not create the texture");
+      }
+    }
     if (imageCallback != null) {
       imageStream!.listen(imageCallback);
     }
@@ -459,21 +968,158 @@ class VidenaPlayer {
     if (progressCallback != null) {
       progressStream!.listen(progressCallback);
     }
+    _Connections connections = _Connections.fromAll(
+        _setupPort!.sendPort,
+        _imageStream!.sendPort,
+        _progressStream!.sendPort,
+        [for (ReceivePort port in _renditionStreams) port.sendPort])
+      ..trackPorts = [for (ReceivePort port in _trackStreams) port.sendPort]
+      ..scenePort = _sceneStream?.sendPort
+      ..tensorPort = _tensorStream?.sendPort
+      ..texture = processStrategy == ProcessStrategy.texture;
     Isolate.spawn(
         _decode,
         [
           _videoState!.address,
           metadata,
-          _Connections.fromAll(_setupPort!.sendPort, _imageStream!.sendPort,
-              _imageMetadataStream!.sendPort, _progressStream!.sendPort),
+          connections,
           speed,
           startOnPause
         ],
         errorsAreFatal: false);
     Completer terminator = Completer();
     await _register(terminator);
+    SendPort? controllerPort = _controllerPort;
+    exactMetadata?.then((exact) {
+      if (_controllerPort == controllerPort && controllerPort != null) {
+        metadata?.duration = exact.duration;
+        controllerPort.send(['duration', exact.duration.inMilliseconds]);
+      }
+    }, onError: (e) {});
     _process(_getFormatStrategy(processStrategy), _imageStream!, _videoState!,
-        terminator, _imageStreamController!);
+        terminator, _imageStreamController!, _imageMetadataController!);
+  }
+
+  void _enableTensor(TensorOutput options) {
+    if (options.mean.length != 3 || options.std.length != 3) {
+      throw ArgumentError("The tensor needs a mean and std per channel");
+    }
+    Pointer<Float> mean = calloc<Float>(3);
+    Pointer<Float> std = calloc<Float>(3);
+    for (int c = 0; c < 3; c++) {
+      mean[c] = options.mean[c];
+      std[c] = options.std[c];
+    }
+    int ret = enableTensor(
+        _videoState!,
+        options.width,
+        options.height,
+        options.type.index,
+        options.resize.index,
+        mean,
+        std,
+        options.pad,
+        options.batch);
+    calloc.free(mean);
+    calloc.free(std);
+    if (ret < 0) {
+      throw Exception("Could not create the tensor output");
+    }
+  }
+
+  /// Opens [file] on a background isolate and converts its first frame, so the UI doesn't wait on the demuxer
+  /// or on building the [filter] graph. With [fastStart] the probing is bounded.
+  static Future<List?> _openFast(String file, ImageFormat imageFormat,
+      VideoFilter? filter, bool fastStart) {
+    return Isolate.run(() {
+      initializeAPI();
+      Pointer<Utf8> nativePath = file.toNativeUtf8();
+      Pointer<Void> videoState;
+      if (filter != null) {
+        Pointer<Utf8> nativeFilters = filter.filters.toNativeUtf8();
+        videoState = openVideoFiltered(
+            nativePath,
+            imageFormat.index,
+            0,
+            0,
+            nativeFilters,
+            filter.autoRotate ? 1 : 0,
+            filter.threads,
+            fastStart ? 1 : 0);
+        malloc.free(nativeFilters);
+      } else {
+        videoState = openVideoFast(nativePath, imageFormat.index, 0, 0);
+      }
+      malloc.free(nativePath);
+      if (videoState == nullptr) {
+        return null;
+      }
+      Metadata m = videoMetadata(videoState);
+      return [
+        videoState.address,
+        MediaMetadata(
+            path: file,
+            duration: Duration(milliseconds: m.duration),
+            dimensions: Fraction(m.width, m.height),
+            numberOfStreams: m.numStreams)
+      ];
+    });
+  }
+
+  /// Counts the images matching [pattern] on a background isolate and opens the first one.
+  static Future<List?> _openSequence(
+      String pattern, ImageFormat imageFormat, ImageSequence sequence) {
+    return Isolate.run(() {
+      initializeAPI();
+      Pointer<Utf8> nativePattern = pattern.toNativeUtf8();
+      Pointer<Void> videoState = openSequence(
+          nativePattern,
+          sequence.frameRate.numerator,
+          sequence.frameRate.denominator,
+          imageFormat.index,
+          0,
+          0,
+          sequence.threads,
+          sequence.readAhead);
+      malloc.free(nativePattern);
+      if (videoState == nullptr) {
+        return null;
+      }
+      Metadata m = videoMetadata(videoState);
+      return [
+        videoState.address,
+        MediaMetadata(
+            path: pattern,
+            duration: Duration(milliseconds: m.duration),
+            dimensions: Fraction(m.width, m.height),
+            numberOfStreams: m.numStreams)
+      ];
+    });
+  }
+
+  /// Reads the status of the decoder, updated natively for every frame.
+  /// Reading it costs no messages between isolates, so it can be polled every frame.
+  /// Returns null when no video is open.
+  PlayerStatus? status() {
+    if (_videoState == null || _videoState == nullptr) {
+      return null;
+    }
+    _status ??= calloc<PlayerStatusNative>();
+    readStatus(_videoState!, _status!);
+    return PlayerStatus.fromNative(_status!.ref);
+  }
+
+  /// Time from the start of [open] in native code to the first converted frame,
+  /// or null if no frame has been converted yet.
+  Duration? timeToFirstFrame() {
+    if (_videoState == null || _videoState == nullptr) {
+      return null;
+    }
+    int time = ffi.timeToFirstFrame(_videoState!);
+    if (time < 0) {
+      return null;
+    }
+    return Duration(microseconds: time);
   }
 
   void _initializeStreams() {
@@ -481,10 +1127,11 @@ class VidenaPlayer {
     _setupStream = _setupPort!.asBroadcastStream();
     _imageStream = ReceivePort();
     _imageStreamController = StreamController();
-    _imageMetadataStream = ReceivePort();
+    _imageMetadataController = StreamController();
     _progressStream = ReceivePort();
     imageStream = _imageStreamController!.stream.asBroadcastStream();
-    imageMetadataStream = _imageMetadataStream!.asBroadcastStream().cast();
+    imageMetadataStream =
+        _imageMetadataController!.stream.asBroadcastStream();
     progressStream = _progressStream!.asBroadcastStream().cast();
   }
 
@@ -497,22 +1144,41 @@ class VidenaPlayer {
         await _setupStream?.drain();
         _setupStream = null;
         _imageStream?.close();
-        _imageMetadataStream?.close();
         _imageStreamController?.close();
         await imageStream?.drain();
-        _imageMetadataStream?.close();
+        _imageMetadataController?.close();
         imageStream = null;
         await imageMetadataStream?.drain();
         imageMetadataStream = null;
         _progressStream?.close();
         await progressStream?.drain();
         progressStream = null;
+        for (ReceivePort port in _renditionStreams) {
+          port.close();
+        }
+        _renditionStreams = [];
+        renditionStreams = [];
+        for (ReceivePort port in _trackStreams) {
+          port.close();
+        }
+        _trackStreams = [];
+        trackStreams = [];
+        _sceneStream?.close();
+        _sceneStream = null;
+        sceneStream = null;
+        _tensorStream?.close();
+        _tensorStream = null;
+        tensorStream = null;
 
         imageSub?.cancel();
         imageMetaSub?.cancel();
         progressSub?.cancel();
 
         _videoState = nullptr;
+        if (_status != null) {
+          calloc.free(_status!);
+          _status = null;
+        }
         metadata = null;
         disposal?.complete();
       }
@@ -555,16 +1221,172 @@ class VidenaPlayer {
     }
   }
 
+  /// Plays [speed] times faster, or backwards when [speed] is negative.
+  ///
+  /// Decoding costs about the same at any speed. Up to 2x every frame is shown; above that only about
+  /// one frame in [speed] is, the others are dropped in the decoder, and once that skips whole GOPs
+  /// the player seeks from keyframe to keyframe. Playing backwards only shows keyframes.
+  /// Rewinding pauses at the first frame. Speeds beyond [maxPlaybackSpeed] are clamped to it.
   void setPlaybackSpeed(double speed) {
     if (_controllerPort != null) {
-      if (speed > 0) {
-        _controllerPort!.send(['speed', speed]);
+      if (speed != 0 && speed.isFinite) {
+        _controllerPort!.send(
+            ['speed', speed.clamp(-maxPlaybackSpeed, maxPlaybackSpeed)]);
       } else {
         throw Exception("Illegal speed value");
       }
     }
   }
 
+  /// {@template setRegion}
+  /// Restricts the frames to the rectangle of the source starting at [x], [y]
+  /// with the given [width] and [height], in source pixels.
+  /// Only this part of the picture is converted, which is cheaper than cropping afterwards.
+  /// The frames are scaled to [outputWidth] x [outputHeight] when both are given.
+  /// {@endtemplate}
+  void setRegion(int x, int y, int width, int height,
+      {int outputWidth = 0, int outputHeight = 0}) {
+    if (_controllerPort != null) {
+      _controllerPort!.send(
+          ['region', x, y, width, height, outputWidth, outputHeight]);
+    }
+  }
+
+  /// Changes the size of the rendition at [index] in the list passed to [open].
+  void resizeRendition(int index, int width, int height) {
+    if (_controllerPort != null) {
+      _controllerPort!.send(['resizeRendition', index + 1, width, height]);
+    }
+  }
+
+  /// Returns to converting the whole picture after a call to [setRegion].
+  void clearRegion() {
+    if (_controllerPort != null) {
+      _controllerPort!.send(['region', 0, 0, 0, 0, 0, 0]);
+    }
+  }
+
+  /// Outputs [framesPerSecond] frames for every second of video, picking the first frame
+  /// at or after each slot. The other frames are never converted, and when the GOP structure
+  /// of the file allows it they aren't even decoded.
+  /// Playback keeps its speed, each frame stays on screen until the next slot.
+  /// A rate of 0 outputs every frame again.
+  void setOutputRate(double framesPerSecond) {
+    if (framesPerSecond < 0) {
+      throw Exception("Illegal output rate");
+    }
+    if (_controllerPort != null) {
+      _controllerPort!
+          .send(['outputRate', (framesPerSecond * 1000).round(), 1000]);
+    }
+  }
+
+  /// Plays the range from [start] to [end] over and over, starting at [start] right away.
+  ///
+  /// The frames of the first pass are kept in memory, up to [cacheBytes] of decoded pictures,
+  /// and every later pass replays them without seeking or decoding, so the wrap doesn't stall.
+  /// A range that doesn't fit seeks back to [start] at every wrap instead.
+  /// Seeks outside the range are allowed, playback loops again once it reaches [end].
+  void setLoop(Duration start, Duration end, {int cacheBytes = 512 << 20}) {
+    if (end <= start) {
+      throw ArgumentError("The loop has to end after it starts");
+    }
+    if (_controllerPort != null) {
+      _controllerPort!.send(
+          ['loop', start.inMilliseconds, end.inMilliseconds, cacheBytes]);
+    }
+  }
+
+  /// Stops looping and frees the frames kept by [setLoop], playback continues from the frame on screen.
+  void clearLoop() {
+    if (_controllerPort != null) {
+      _controllerPort!.send(['clearLoop']);
+    }
+  }
+
+  /// Marks the video as running in the background, so it is the first to give up memory
+  /// when the process is over the budget set with [Videna.setMemoryBudget].
+  /// Its frames may then come out smaller than requested.
+  void setBackground(bool background) {
+    if (_controllerPort != null) {
+      _controllerPort!.send(['background', background]);
+    }
+  }
+
+  /// Moves the threads decoding and converting this video, and fetching it over http, to [placement].
+  /// Each of them applies it when it picks up its next frame or block.
+  void setThreadPlacement(ThreadPlacement placement) {
+    if (_controllerPort != null) {
+      _controllerPort!.send([
+        'placement',
+        placement.cpuMask,
+        placement.nice,
+        placement.realtime
+      ]);
+    }
+  }
+
+  /// Returns the native memory held by this video, or null when it isn't open.
+  MemoryUsage? memoryUsage() {
+    if (_videoState == null || _videoState == nullptr) {
+      return null;
+    }
+    return MemoryUsage.fromNative(ffi.memoryUsage(_videoState!));
+  }
+
+  /// Shows frames of the proxy at [proxyPath], made by [createVideoProxy] for the same file,
+  /// while scrubbing with [scrubTo].
+  void attachProxy(String proxyPath) {
+    if (_controllerPort != null) {
+      _controllerPort!.send(['proxy', proxyPath]);
+    }
+  }
+
+  /// Creates a proxy of the open file on a background isolate, or finds it in the cache,
+  /// and attaches it to the player once it is ready.
+  /// The player can be used as usual meanwhile.
+  Future<void> useProxy(
+      {String? cacheDirectory, int height = 360, int quality = 60}) async {
+    String? file = metadata?.path;
+    if (file == null) {
+      return;
+    }
+    String proxyPath = await createVideoProxy(file,
+        cacheDirectory: cacheDirectory, height: height, quality: quality);
+    attachProxy(proxyPath);
+  }
+
+  /// Pauses the video and shows the frame at [position], for use while dragging a seek bar.
+  /// Frames come from the attached proxy, so they are cheap to find even in long-GOP files.
+  /// The source catches up with the last scrubbed position on [endScrub] or [play].
+  /// Without a proxy this is a precise seek on the source.
+  void scrubTo(Duration position) {
+    if (_controllerPort != null) {
+      _controllerPort!.send(['scrub', position.inMilliseconds]);
+    }
+  }
+
+  /// Replaces the proxy frame shown by [scrubTo] with the full quality frame of the source.
+  void endScrub() {
+    if (_controllerPort != null) {
+      _controllerPort!.send(['endScrub']);
+    }
+  }
+
+  /// Encodes the last frame shown by the player as an image on a background isolate.
+  /// The player keeps playing while the image is encoded.
+  /// Returns null if no frame has been decoded yet, or while the memory governor
+  /// keeps the player from holding on to its last frame.
+  ///
+  /// {@macro snapshotFormat}
+  Future<Uint8List?> snapshot(
+      {SnapshotFormat format = SnapshotFormat.png, int quality = 90}) async {
+    if (_videoState == null || _videoState == nullptr) {
+      return null;
+    }
+    return encodeNativeSnapshot(_videoState!.address, format, quality);
+  }
+
   /// This function pauses the video and resends the last frame through the stream
   void pulse() {
     pause();
@@ -608,6 +1430,11 @@ class VidenaPlayer {
 
   /// Stops the processing of the video, if any was taking place, and closes all the streams.
   Future<void> close() async {
+    if (textureId != null) {
+      // the native side stops drawing into it before the texture is unregistered
+      await _channel.invokeMethod('disposeTexture', {'textureId': textureId});
+      textureId = null;
+    }
     if (_controllerPort != null && disposal == null) {
       disposal = Completer();
       _controllerPort!.send(['pause']);
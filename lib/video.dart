@@ -17,9 +17,7 @@
 
 import 'package:audio_video_progress_bar/audio_video_progress_bar.dart';
 import 'package:flutter/material.dart';
-import 'dart:async';
 import 'dart:typed_data';
-import 'dart:ui' as ui;
 import 'dart:io';
 import 'package:file_picker/file_picker.dart';
 import 'videna.dart';
@@ -73,11 +71,22 @@ class ProgressBarProviderState extends State<ProgressBarProvider> {
 /// A progress bar for this [Video] is obtainable by calling [getProgressBar]
 class Video extends StatefulWidget {
   final VidenaPlayer player = VidenaPlayer();
+  // the texture of the video opened, no frames reach Dart to tell it apart
+  final ValueNotifier<int?> texture = ValueNotifier(null);
 
   Video({super.key});
 
-  Future<void> open(String file, {bool startOnPause = false}) async {
-    await player.open(file: file, startOnPause: startOnPause);
+  Future<void> open(String file,
+      {bool startOnPause = false, bool fastStart = false}) async {
+    // on Linux the frames are drawn into a texture without going through Dart
+    await player.open(
+        file: file,
+        startOnPause: startOnPause,
+        fastStart: fastStart,
+        processStrategy: Platform.isLinux
+            ? ProcessStrategy.texture
+            : ProcessStrategy.image);
+    texture.value = player.textureId;
   }
 
   void pause() {
@@ -113,35 +122,31 @@ class Video extends StatefulWidget {
     player.seekPrecise(duration);
   }
 
-  /// Pauses the video and returns a [Snapshot].
+  /// {@macro setRegion}
+  void setRegion(int x, int y, int width, int height,
+      {int outputWidth = 0, int outputHeight = 0}) {
+    player.setRegion(x, y, width, height,
+        outputWidth: outputWidth, outputHeight: outputHeight);
+  }
+
+  void clearRegion() {
+    player.clearRegion();
+  }
+
+  /// Returns a [Snapshot] of the frame on screen, encoded as a png off the UI thread.
   Future<Snapshot?> getSnapshot() async {
-    player.pause();
-    VideoFrame? frame;
-    final future = Completer();
-    final sub = player.imageStream!.listen(null);
-    sub.onData((event) {
-      future.complete(event);
-      sub.cancel();
-    });
-    player.pulse();
-
-    frame = await future.future;
-    Snapshot snapshot;
-    if (frame != null && frame.size > 0) {
-      snapshot = Snapshot(
-        image: (await frame.content!.image
-                .toByteData(format: ui.ImageByteFormat.png))!
-            .buffer
-            .asUint8List(),
-        name: '${player.metadata?.filename}-${frame.pts}',
-      );
-      return snapshot;
+    Uint8List? image = await player.snapshot();
+    if (image == null) {
+      return null;
     }
-
-    return null;
+    return Snapshot(
+      image: image,
+      name:
+          '${player.metadata?.filename}-${DateTime.now().millisecondsSinceEpoch}',
+    );
   }
 
-  /// Pauses the video and saves a snapshot in the provided path.
+  /// Saves a snapshot of the frame on screen in the provided path.
   /// The snapshot will be saved as a png.
   Future<void> saveSnapshotTo(String path) async {
     Snapshot? snapshot = await getSnapshot();
@@ -150,7 +155,7 @@ class Video extends StatefulWidget {
     }
   }
 
-  /// Pauses the video and saves a snapshot in the desired location.
+  /// Saves a snapshot of the frame on screen in the desired location.
   Future<void> takeSnapshot() async {
     Snapshot? snapshot = await getSnapshot();
     if (snapshot != null) {
@@ -168,6 +173,7 @@ class Video extends StatefulWidget {
   }
 
   Future<void> dispose() async {
+    texture.value = null;
     player.close();
   }
 
@@ -190,10 +196,28 @@ class VideoState extends State<Video> {
   void initState() {
     super.initState();
     displayVideo();
+    widget.texture.addListener(_textureChanged);
+  }
+
+  void _textureChanged() {
+    setState(() {});
+  }
+
+  @override
+  void dispose() {
+    widget.texture.removeListener(_textureChanged);
+    super.dispose();
   }
 
   @override
   Widget build(BuildContext context) {
+    int? textureId = widget.texture.value;
+    if (textureId != null) {
+      return AspectRatio(
+          aspectRatio:
+              widget.player.metadata?.dimensions?.toDouble() ?? 16 / 9,
+          child: Texture(textureId: textureId));
+    }
     if (frame == null) {
       return Container(
           width: 800,
@@ -0,0 +1,174 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#include "include/videna/videna_plugin.h"
+#include <flutter_linux/flutter_linux.h>
+#include <string.h>
+#include "texture.h"
+
+#define VIDENA_PLUGIN(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST((obj), videna_plugin_get_type(), VidenaPlugin))
+
+// Texture drawn from the RGBA frames of a VideoState, the copy into GL is done by the engine on its raster thread.
+#define VIDENA_TYPE_TEXTURE (videna_texture_get_type())
+G_DECLARE_FINAL_TYPE(VidenaTexture, videna_texture, VIDENA, TEXTURE, FlPixelBufferTexture)
+
+struct _VidenaTexture {
+    FlPixelBufferTexture parent_instance;
+    FlTextureRegistrar* registrar;
+    // the TextureOutput of the VideoState, NULL once released
+    void* output;
+};
+
+G_DEFINE_TYPE(VidenaTexture, videna_texture, fl_pixel_buffer_texture_get_type())
+
+static gboolean videna_texture_copy_pixels(FlPixelBufferTexture* texture, const uint8_t** buffer,
+        uint32_t* width, uint32_t* height, GError** error) {
+    VidenaTexture* self = VIDENA_TEXTURE(texture);
+    if (self->output == NULL || acquireTexture(self->output, buffer, width, height) < 0) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No frame has been shown yet");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void videna_texture_release(VidenaTexture* self) {
+    if (self->output != NULL) {
+        releaseTexture(self->output);
+        self->output = NULL;
+    }
+}
+
+static void videna_texture_dispose(GObject* object) {
+    videna_texture_release(VIDENA_TEXTURE(object));
+    G_OBJECT_CLASS(videna_texture_parent_class)->dispose(object);
+}
+
+static void videna_texture_class_init(VidenaTextureClass* klass) {
+    FL_PIXEL_BUFFER_TEXTURE_CLASS(klass)->copy_pixels = videna_texture_copy_pixels;
+    G_OBJECT_CLASS(klass)->dispose = videna_texture_dispose;
+}
+
+static void videna_texture_init(VidenaTexture* self) {}
+
+// Called by the thread that shows a frame, the registrar can be told from any thread
+static void frame_available(void* opaque) {
+    VidenaTexture* self = (VidenaTexture*) opaque;
+    fl_texture_registrar_mark_texture_frame_available(self->registrar, FL_TEXTURE(self));
+}
+
+struct _VidenaPlugin {
+    GObject parent_instance;
+    FlTextureRegistrar* registrar;
+    // texture id to VidenaTexture
+    GHashTable* textures;
+};
+
+G_DEFINE_TYPE(VidenaPlugin, videna_plugin, g_object_get_type())
+
+static FlMethodResponse* create_texture(VidenaPlugin* self, FlValue* args) {
+    FlValue* videoState = NULL;
+    VidenaTexture* texture;
+    int64_t id;
+    if (args != NULL && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+        videoState = fl_value_lookup_string(args, "videoState");
+    }
+    if (videoState == NULL || fl_value_get_type(videoState) != FL_VALUE_TYPE_INT) {
+        return FL_METHOD_RESPONSE(fl_method_error_response_new("bad_args", "videoState is missing", NULL));
+    }
+    texture = VIDENA_TEXTURE(g_object_new(VIDENA_TYPE_TEXTURE, NULL));
+    texture->registrar = self->registrar;
+    if (!fl_texture_registrar_register_texture(self->registrar, FL_TEXTURE(texture))) {
+        g_object_unref(texture);
+        return FL_METHOD_RESPONSE(fl_method_error_response_new("texture", "Could not register the texture", NULL));
+    }
+    texture->output = attachTexture((void*) (intptr_t) fl_value_get_int(videoState), frame_available, texture);
+    if (texture->output == NULL) {
+        fl_texture_registrar_unregister_texture(self->registrar, FL_TEXTURE(texture));
+        g_object_unref(texture);
+        return FL_METHOD_RESPONSE(fl_method_error_response_new("texture", "Textures need RGBA frames", NULL));
+    }
+    id = fl_texture_get_id(FL_TEXTURE(texture));
+    g_hash_table_insert(self->textures, GSIZE_TO_POINTER((gsize) id), texture);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(fl_value_new_int(id)));
+}
+
+static FlMethodResponse* dispose_texture(VidenaPlugin* self, FlValue* args) {
+    FlValue* textureId = NULL;
+    VidenaTexture* texture;
+    if (args != NULL && fl_value_get_type(args) == FL_VALUE_TYPE_MAP) {
+        textureId = fl_value_lookup_string(args, "textureId");
+    }
+    if (textureId == NULL || fl_value_get_type(textureId) != FL_VALUE_TYPE_INT) {
+        return FL_METHOD_RESPONSE(fl_method_error_response_new("bad_args", "textureId is missing", NULL));
+    }
+    texture = g_hash_table_lookup(self->textures, GSIZE_TO_POINTER((gsize) fl_value_get_int(textureId)));
+    if (texture != NULL) {
+        // no frame is announced once the output is released
+        videna_texture_release(texture);
+        fl_texture_registrar_unregister_texture(self->registrar, FL_TEXTURE(texture));
+        g_hash_table_remove(self->textures, GSIZE_TO_POINTER((gsize) fl_value_get_int(textureId)));
+    }
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(NULL));
+}
+
+static void videna_plugin_handle_method_call(VidenaPlugin* self, FlMethodCall* method_call) {
+    g_autoptr(FlMethodResponse) response = NULL;
+    const gchar* method = fl_method_call_get_name(method_call);
+    FlValue* args = fl_method_call_get_args(method_call);
+
+    if (strcmp(method, "createTexture") == 0) {
+        response = create_texture(self, args);
+    }
+    else if (strcmp(method, "disposeTexture") == 0) {
+        response = dispose_texture(self, args);
+    }
+    else {
+        response = FL_METHOD_RESPONSE(fl_method_not_implemented_response_new());
+    }
+    fl_method_call_respond(method_call, response, NULL);
+}
+
+static void videna_plugin_dispose(GObject* object) {
+    VidenaPlugin* self = VIDENA_PLUGIN(object);
+    g_clear_pointer(&self->textures, g_hash_table_unref);
+    G_OBJECT_CLASS(videna_plugin_parent_class)->dispose(object);
+}
+
+static void videna_plugin_class_init(VidenaPluginClass* klass) {
+    G_OBJECT_CLASS(klass)->dispose = videna_plugin_dispose;
+}
+
+static void videna_plugin_init(VidenaPlugin* self) {
+    self->textures = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_object_unref);
+}
+
+static void method_call_cb(FlMethodChannel* channel, FlMethodCall* method_call, gpointer user_data) {
+    videna_plugin_handle_method_call(VIDENA_PLUGIN(user_data), method_call);
+}
+
+void videna_plugin_register_with_registrar(FlPluginRegistrar* registrar) {
+    VidenaPlugin* plugin = VIDENA_PLUGIN(g_object_new(videna_plugin_get_type(), NULL));
+    g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+    g_autoptr(FlMethodChannel) channel =
+        fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar), "videna", FL_METHOD_CODEC(codec));
+
+    plugin->registrar = fl_plugin_registrar_get_texture_registrar(registrar);
+    fl_method_channel_set_method_call_handler(channel, method_call_cb, g_object_ref(plugin), g_object_unref);
+    g_object_unref(plugin);
+}
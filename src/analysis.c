@@ -0,0 +1,188 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "analysis.h"
+#include <libavutil/mem.h>
+#include <string.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ANALYSIS_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ANALYSIS_NEON
+#endif
+
+// Sum of absolute differences between two buffers of n bytes
+static uint64_t sad(const uint8_t* a, const uint8_t* b, int n) {
+    uint64_t sum = 0;
+    int i = 0;
+#if defined(ANALYSIS_SSE2)
+    __m128i acc = _mm_setzero_si128();
+    uint64_t lanes[2];
+    for (; i + 16 <= n; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+    }
+    _mm_storeu_si128((__m128i*)lanes, acc);
+    sum = lanes[0] + lanes[1];
+#elif defined(ANALYSIS_NEON)
+    uint64x2_t acc = vdupq_n_u64(0);
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t diff = vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i));
+        acc = vpadalq_u32(acc, vpaddlq_u16(vpaddlq_u8(diff)));
+    }
+    sum = vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1);
+#endif
+    for (; i < n; i++) {
+        sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    }
+    return sum;
+}
+
+// Copies every step-th luma sample of every step-th row into dst, returns -1 for formats without a luma plane
+static int sample_luma(const AVFrame* pFrame, int step, uint8_t* dst, int width, int height) {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pFrame->format);
+    if (desc == NULL || desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_FLOAT)) {
+        return -1;
+    }
+    const AVComponentDescriptor* luma = &desc->comp[0];
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = pFrame->data[luma->plane] + (int64_t)y * step * pFrame->linesize[luma->plane] + luma->offset;
+        uint8_t* out = dst + (int64_t)y * width;
+        if (luma->depth > 8) {
+            int shift = luma->shift + luma->depth - 8;
+            for (int x = 0; x < width; x++) {
+                const uint8_t* sample = row + x * step * luma->step;
+                int value = desc->flags & AV_PIX_FMT_FLAG_BE ? (sample[0] << 8) | sample[1] : AV_RL16(sample);
+                out[x] = value >> shift;
+            }
+        }
+        else if (step == 1 && luma->step == 1) {
+            memcpy(out, row, width);
+        }
+        else {
+            for (int x = 0; x < width; x++) {
+                out[x] = row[x * step * luma->step];
+            }
+        }
+    }
+    return 0;
+}
+
+static void histogram(const uint8_t* luma, int n, uint32_t* bins) {
+    memset(bins, 0, ANALYSIS_BINS * sizeof(uint32_t));
+    for (int i = 0; i < n; i++) {
+        bins[luma[i] >> 2]++;
+    }
+}
+
+Analysis* analysis_alloc(int step, double cutThreshold) {
+    Analysis* analysis = av_mallocz(sizeof(Analysis));
+    if (analysis == NULL) {
+        return NULL;
+    }
+    analysis->step = step > 0 ? step : 1;
+    analysis->cutThreshold = cutThreshold;
+    init_lock(&analysis->mutex);
+    return analysis;
+}
+
+void analysis_free(Analysis** analysis) {
+    if (*analysis == NULL) {
+        return;
+    }
+    av_free((*analysis)->previous);
+    av_free((*analysis)->current);
+    destroy_lock(&(*analysis)->mutex);
+    av_freep(analysis);
+}
+
+void analysis_reset(Analysis* analysis) {
+    analysis->hasPrevious = 0;
+}
+
+int analysis_push_frame(Analysis* analysis, const AVFrame* pFrame, int64_t pts, int64_t progress) {
+    int width = (pFrame->width + analysis->step - 1) / analysis->step;
+    int height = (pFrame->height + analysis->step - 1) / analysis->step;
+    int n = width * height;
+    uint8_t* swap;
+    AnalysisEvent* event;
+    uint64_t histogramDistance = 0;
+
+    if (n <= 0) {
+        return -1;
+    }
+    if (width != analysis->width || height != analysis->height) {
+        av_free(analysis->previous);
+        av_free(analysis->current);
+        analysis->previous = av_malloc(n);
+        analysis->current = av_malloc(n);
+        if (analysis->previous == NULL || analysis->current == NULL) {
+            analysis->width = 0;
+            analysis->height = 0;
+            return -1;
+        }
+        analysis->width = width;
+        analysis->height = height;
+        analysis->hasPrevious = 0;
+    }
+    if (sample_luma(pFrame, analysis->step, analysis->current, width, height) < 0) {
+        return -1;
+    }
+    histogram(analysis->current, n, analysis->histogram);
+
+    if (analysis->hasPrevious) {
+        for (int i = 0; i < ANALYSIS_BINS; i++) {
+            int64_t d = (int64_t)analysis->histogram[i] - analysis->previousHistogram[i];
+            histogramDistance += d < 0 ? -d : d;
+        }
+        lock(&analysis->mutex);
+        if (analysis->count == ANALYSIS_EVENTS) {
+            // nobody is reading, the oldest events are dropped
+            analysis->first = (analysis->first + 1) % ANALYSIS_EVENTS;
+            analysis->count--;
+        }
+        event = &analysis->events[(analysis->first + analysis->count) % ANALYSIS_EVENTS];
+        event->pts = pts;
+        event->progress = progress;
+        event->motion = (double) sad(analysis->current, analysis->previous, n) / n;
+        event->histogramDifference = (double) histogramDistance / (2.0 * n);
+        event->sceneCut = event->histogramDifference >= analysis->cutThreshold;
+        analysis->count++;
+        unlock(&analysis->mutex);
+    }
+
+    swap = analysis->previous;
+    analysis->previous = analysis->current;
+    analysis->current = swap;
+    memcpy(analysis->previousHistogram, analysis->histogram, sizeof(analysis->histogram));
+    analysis->hasPrevious = 1;
+    return 0;
+}
+
+int analysis_read_events(Analysis* analysis, AnalysisEvent* events, int max) {
+    int read = 0;
+    lock(&analysis->mutex);
+    while (read < max && analysis->count > 0) {
+        events[read++] = analysis->events[analysis->first];
+        analysis->first = (analysis->first + 1) % ANALYSIS_EVENTS;
+        analysis->count--;
+    }
+    unlock(&analysis->mutex);
+    return read;
+}
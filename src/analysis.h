@@ -0,0 +1,65 @@
+// This file is a part of videna.
+// Copyright (C) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+#include <stdint.h>
+#include "threads.h"
+
+#define ANALYSIS_EVENTS 256
+#define ANALYSIS_BINS 64
+
+typedef struct {
+    int64_t pts;
+    int64_t progress; // in milliseconds
+    double motion; // mean absolute luma difference to the previous frame, 0 to 255
+    double histogramDifference; // 0 to 1
+    int sceneCut;
+} AnalysisEvent;
+
+typedef struct {
+    int step;
+    double cutThreshold;
+
+    // luma sampled every step pixels
+    int width;
+    int height;
+    uint8_t* previous;
+    uint8_t* current;
+    uint32_t previousHistogram[ANALYSIS_BINS];
+    uint32_t histogram[ANALYSIS_BINS];
+    int hasPrevious;
+
+    AnalysisEvent events[ANALYSIS_EVENTS];
+    int first;
+    int count;
+    Mutex mutex;
+} Analysis;
+
+Analysis* analysis_alloc(int step, double cutThreshold);
+
+void analysis_free(Analysis** analysis);
+
+void analysis_reset(Analysis* analysis);
+
+int analysis_push_frame(Analysis* analysis, const AVFrame* pFrame, int64_t pts, int64_t progress);
+
+int analysis_read_events(Analysis* analysis, AnalysisEvent* events, int max);
+
+#endif
@@ -0,0 +1,182 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "clip.h"
+#include <libavutil/mem.h>
+#include <stdio.h>
+
+static void close_clip(AVFormatContext** input, AVFormatContext** output, int** streamMap, AVPacket** packet) {
+    if (*output != NULL) {
+        if (!((*output)->oformat->flags & AVFMT_NOFILE)) {
+            avio_closep(&(*output)->pb);
+        }
+        avformat_free_context(*output);
+        *output = NULL;
+    }
+    avformat_close_input(input);
+    av_freep(streamMap);
+    av_packet_free(packet);
+}
+
+// Copies the packets between startMs and endMs of path into a new file at outputPath without decoding them.
+// The start is moved back to the keyframe before it and the clip ends at the first keyframe at or after endMs,
+// timestamps are rebased so the clip starts at 0.
+// Returns the start of the clip in the source in milliseconds, or a negative value on failure.
+FFI_EXPORT int64_t exportClip(char* path, char* outputPath, int64_t startMs, int64_t endMs) {
+    AVFormatContext* input = NULL;
+    AVFormatContext* output = NULL;
+    AVPacket* packet = NULL;
+    AVStream* videoStream;
+    int* streamMap = NULL;
+    int videoIndex;
+    int outputStreams = 0;
+    int started = 0;
+    int64_t startDts = 0;
+    int64_t endPts;
+    int ret;
+    AVRational thou;
+    thou.num = 1;
+    thou.den = 1000;
+
+    if (avformat_open_input(&input, path, NULL, NULL) < 0) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return -1;
+    }
+    if (avformat_find_stream_info(input, NULL) < 0) {
+        close_clip(&input, &output, &streamMap, &packet);
+        return -1;
+    }
+    videoIndex = av_find_best_stream(input, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+    if (videoIndex < 0) {
+        fprintf(stderr, "Could not find video stream\n");
+        close_clip(&input, &output, &streamMap, &packet);
+        return -1;
+    }
+    videoStream = input->streams[videoIndex];
+    endPts = av_rescale_q(endMs, thou, videoStream->time_base);
+
+    if (avformat_alloc_output_context2(&output, NULL, NULL, outputPath) < 0 || output == NULL) {
+        fprintf(stderr, "Could not guess the container of %s\n", outputPath);
+        close_clip(&input, &output, &streamMap, &packet);
+        return -1;
+    }
+    streamMap = av_malloc_array(input->nb_streams, sizeof(int));
+    packet = av_packet_alloc();
+    if (streamMap == NULL || packet == NULL) {
+        close_clip(&input, &output, &streamMap, &packet);
+        return -1;
+    }
+    for (unsigned int i = 0; i < input->nb_streams; i++) {
+        AVCodecParameters* codecpar = input->streams[i]->codecpar;
+        AVStream* stream;
+        streamMap[i] = -1;
+        if (codecpar->codec_type != AVMEDIA_TYPE_VIDEO
+                && codecpar->codec_type != AVMEDIA_TYPE_AUDIO
+                && codecpar->codec_type != AVMEDIA_TYPE_SUBTITLE) {
+            continue;
+        }
+        stream = avformat_new_stream(output, NULL);
+        if (stream == NULL || avcodec_parameters_copy(stream->codecpar, codecpar) < 0) {
+            close_clip(&input, &output, &streamMap, &packet);
+            return -1;
+        }
+        // the tag of the source container may mean something else in the new one
+        stream->codecpar->codec_tag = 0;
+        stream->time_base = input->streams[i]->time_base;
+        streamMap[i] = outputStreams++;
+    }
+    if (!(output->oformat->flags & AVFMT_NOFILE)) {
+        if (avio_open(&output->pb, outputPath, AVIO_FLAG_WRITE) < 0) {
+            fprintf(stderr, "Could not open %s\n", outputPath);
+            close_clip(&input, &output, &streamMap, &packet);
+            return -1;
+        }
+    }
+    if (avformat_write_header(output, NULL) < 0) {
+        close_clip(&input, &output, &streamMap, &packet);
+        // no partial clip is left behind
+        remove(outputPath);
+        return -1;
+    }
+
+    ret = av_seek_frame(input, videoIndex, av_rescale_q(startMs, thou, videoStream->time_base), AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) {
+        close_clip(&input, &output, &streamMap, &packet);
+        remove(outputPath);
+        return -1;
+    }
+    while (av_read_frame(input, packet) >= 0) {
+        AVStream* inStream = input->streams[packet->stream_index];
+        AVStream* outStream;
+        int64_t offset;
+        int key = packet->flags & AV_PKT_FLAG_KEY;
+        if (streamMap[packet->stream_index] < 0) {
+            av_packet_unref(packet);
+            continue;
+        }
+        if (packet->stream_index == videoIndex) {
+            if (!started) {
+                if (!key) {
+                    av_packet_unref(packet);
+                    continue;
+                }
+                started = 1;
+                startDts = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+            }
+            else if (key && packet->pts != AV_NOPTS_VALUE && packet->pts >= endPts) {
+                av_packet_unref(packet);
+                break;
+            }
+        }
+        else {
+            int64_t time = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            // other streams wait for the first video keyframe and stop at the requested end
+            if (!started || time == AV_NOPTS_VALUE
+                    || av_compare_ts(time, inStream->time_base, startDts, videoStream->time_base) < 0
+                    || av_compare_ts(time, inStream->time_base, endPts, videoStream->time_base) >= 0) {
+                av_packet_unref(packet);
+                continue;
+            }
+        }
+        offset = av_rescale_q(startDts, videoStream->time_base, inStream->time_base);
+        if (packet->pts != AV_NOPTS_VALUE) {
+            packet->pts -= offset;
+        }
+        if (packet->dts != AV_NOPTS_VALUE) {
+            packet->dts -= offset;
+        }
+        outStream = output->streams[streamMap[packet->stream_index]];
+        av_packet_rescale_ts(packet, inStream->time_base, outStream->time_base);
+        packet->stream_index = streamMap[packet->stream_index];
+        packet->pos = -1;
+        // takes ownership of the packet
+        if (av_interleaved_write_frame(output, packet) < 0) {
+            close_clip(&input, &output, &streamMap, &packet);
+            remove(outputPath);
+            return -1;
+        }
+    }
+    if (av_write_trailer(output) < 0 || !started) {
+        close_clip(&input, &output, &streamMap, &packet);
+        remove(outputPath);
+        return -1;
+    }
+    // the stream and its time base are freed with the input
+    startMs = av_rescale_q(startDts, videoStream->time_base, thou);
+    close_clip(&input, &output, &streamMap, &packet);
+    return startMs;
+}
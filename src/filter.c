@@ -0,0 +1,276 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "filter.h"
+#include <libavutil/avstring.h>
+#include <libavutil/display.h>
+#include <libavutil/mem.h>
+#include <libavutil/pixdesc.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+const char* filter_rotation(const AVStream* stream) {
+    size_t size = 0;
+    const int32_t* matrix = (const int32_t*)av_stream_get_side_data(stream, AV_PKT_DATA_DISPLAYMATRIX, &size);
+    double theta;
+    if (matrix == NULL || size < 9 * sizeof(int32_t)) {
+        return NULL;
+    }
+    // the matrix turns the picture counterclockwise, normalized to 0..360
+    theta = -av_display_rotation_get(matrix);
+    theta -= 360 * floor(theta / 360 + 0.9 / 360);
+    if (fabs(theta - 90) < 1) {
+        return "transpose=clock";
+    }
+    if (fabs(theta - 180) < 1) {
+        return "hflip,vflip";
+    }
+    if (fabs(theta - 270) < 1) {
+        return "transpose=cclock";
+    }
+    return NULL;
+}
+
+VideoFilter* filter_alloc(const char* description, int threads, AVRational time_base) {
+    VideoFilter* filter = av_mallocz(sizeof(VideoFilter));
+    if (filter == NULL) {
+        return NULL;
+    }
+    if (description != NULL && description[0] != '\0') {
+        filter->description = av_strdup(description);
+        if (filter->description == NULL) {
+            av_free(filter);
+            return NULL;
+        }
+    }
+    filter->tapFrame = av_frame_alloc();
+    if (filter->tapFrame == NULL) {
+        av_free(filter->description);
+        av_free(filter);
+        return NULL;
+    }
+    filter->threads = threads;
+    filter->time_base = time_base;
+    return filter;
+}
+
+// Builds buffer -> the filters of the user -> scale -> format -> buffersink for the frames like pFrame.
+// The conversion to the output runs in the graph, so a frame that comes out needs no other one.
+// With a tap the filtered frames are split before the conversion, the second branch ends in its own buffersink.
+static int configure(VideoFilter* filter, const AVFrame* pFrame, int width, int height, int format) {
+    AVFilterInOut* outputs = NULL;
+    AVFilterInOut* inputs = NULL;
+    AVFilterInOut* tapInput = NULL;
+    const char* formatName = format != AV_PIX_FMT_NONE ? av_get_pix_fmt_name(format) : NULL;
+    char args[256];
+    char conversion[128];
+    char* chain;
+    size_t length;
+    int ret;
+
+    avfilter_graph_free(&filter->graph);
+    av_frame_unref(filter->tapFrame);
+    filter->tapSink = NULL;
+    filter->eof = 0;
+    filter->graph = avfilter_graph_alloc();
+    if (filter->graph == NULL) {
+        return -1;
+    }
+    // slice threading splits every frame between the threads of the graph
+    filter->graph->nb_threads = filter->threads;
+    filter->graph->thread_type = AVFILTER_THREAD_SLICE;
+    snprintf(args, sizeof(args), "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=%d/%d",
+        pFrame->width, pFrame->height, pFrame->format, filter->time_base.num, filter->time_base.den,
+        pFrame->sample_aspect_ratio.num, FFMAX(pFrame->sample_aspect_ratio.den, 1));
+    ret = avfilter_graph_create_filter(&filter->source, avfilter_get_by_name("buffer"), "in", args, NULL, filter->graph);
+    if (ret >= 0) {
+        ret = avfilter_graph_create_filter(&filter->sink, avfilter_get_by_name("buffersink"), "out", NULL, NULL, filter->graph);
+    }
+    if (ret >= 0 && filter->tap) {
+        ret = avfilter_graph_create_filter(&filter->tapSink, avfilter_get_by_name("buffersink"), "tap", NULL, NULL, filter->graph);
+    }
+    if (ret < 0) {
+        avfilter_graph_free(&filter->graph);
+        return -1;
+    }
+
+    conversion[0] = '\0';
+    if (width > 0 && height > 0) {
+        snprintf(args, sizeof(args), "scale=%d:%d:flags=bilinear", width, height);
+        av_strlcat(conversion, args, sizeof(conversion));
+    }
+    if (formatName != NULL) {
+        snprintf(args, sizeof(args), "%sformat=pix_fmts=%s", conversion[0] != '\0' ? "," : "", formatName);
+        av_strlcat(conversion, args, sizeof(conversion));
+    }
+
+    length = (filter->description != NULL ? strlen(filter->description) : 0) + sizeof(conversion) + 64;
+    chain = av_malloc(length);
+    if (chain == NULL) {
+        avfilter_graph_free(&filter->graph);
+        return -1;
+    }
+    if (filter->tap) {
+        snprintf(chain, length, "[in]%s,split[main][tap];[main]%s[out]",
+            filter->description != NULL ? filter->description : "null", conversion[0] != '\0' ? conversion : "null");
+    }
+    else {
+        snprintf(chain, length, "%s%s%s", filter->description != NULL ? filter->description : "",
+            filter->description != NULL && conversion[0] != '\0' ? "," : "", conversion);
+        if (chain[0] == '\0') {
+            av_strlcat(chain, "null", length);
+        }
+    }
+
+    outputs = avfilter_inout_alloc();
+    inputs = avfilter_inout_alloc();
+    if (filter->tap) {
+        tapInput = avfilter_inout_alloc();
+    }
+    if (outputs == NULL || inputs == NULL || (filter->tap && tapInput == NULL)) {
+        avfilter_inout_free(&tapInput);
+        ret = -1;
+    }
+    else {
+        outputs->name = av_strdup("in");
+        outputs->filter_ctx = filter->source;
+        outputs->pad_idx = 0;
+        outputs->next = NULL;
+        inputs->name = av_strdup("out");
+        inputs->filter_ctx = filter->sink;
+        inputs->pad_idx = 0;
+        inputs->next = tapInput;
+        if (tapInput != NULL) {
+            tapInput->name = av_strdup("tap");
+            tapInput->filter_ctx = filter->tapSink;
+            tapInput->pad_idx = 0;
+            tapInput->next = NULL;
+        }
+        ret = avfilter_graph_parse_ptr(filter->graph, chain, &inputs, &outputs, NULL);
+    }
+    if (ret >= 0) {
+        ret = avfilter_graph_config(filter->graph, NULL);
+    }
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    if (ret < 0) {
+        fprintf(stderr, "Could not configure the filters %s\n", chain);
+        av_free(chain);
+        avfilter_graph_free(&filter->graph);
+        return -1;
+    }
+    av_free(chain);
+
+    filter->srcWidth = pFrame->width;
+    filter->srcHeight = pFrame->height;
+    filter->srcFormat = pFrame->format;
+    filter->srcAspect = pFrame->sample_aspect_ratio;
+    filter->width = width;
+    filter->height = height;
+    filter->format = format;
+    filter->tapped = filter->tap;
+    return 0;
+}
+
+int filter_push(VideoFilter* filter, AVFrame* pFrame, int width, int height, int format) {
+    int ret;
+    if (pFrame == NULL) {
+        if (filter->eof) {
+            return 0;
+        }
+        filter->eof = 1;
+        return filter->graph != NULL ? av_buffersrc_add_frame(filter->source, NULL) : 0;
+    }
+    // a change of the stream or the output needs a new graph, what the old one still held is dropped
+    if (filter->graph == NULL || pFrame->width != filter->srcWidth || pFrame->height != filter->srcHeight
+            || pFrame->format != filter->srcFormat || av_cmp_q(pFrame->sample_aspect_ratio, filter->srcAspect) != 0
+            || width != filter->width || height != filter->height || format != filter->format
+            || filter->tap != filter->tapped) {
+        if (configure(filter, pFrame, width, height, format) < 0) {
+            av_frame_unref(pFrame);
+            return -1;
+        }
+    }
+    // takes the reference of pFrame
+    ret = av_buffersrc_add_frame(filter->source, pFrame);
+    if (ret < 0) {
+        av_frame_unref(pFrame);
+        return -1;
+    }
+    return 0;
+}
+
+int filter_pull(VideoFilter* filter, AVFrame* pFrame) {
+    int ret;
+    if (filter->graph == NULL) {
+        return filter->eof ? AVERROR_EOF : AVERROR(EAGAIN);
+    }
+    ret = av_buffersink_get_frame(filter->sink, pFrame);
+    if (ret < 0) {
+        return ret;
+    }
+    if (pFrame->pts != AV_NOPTS_VALUE) {
+        pFrame->pts = av_rescale_q(pFrame->pts, av_buffersink_get_time_base(filter->sink), filter->time_base);
+    }
+    pFrame->best_effort_timestamp = pFrame->pts;
+    if (filter->tapSink != NULL) {
+        av_frame_unref(filter->tapFrame);
+        // split hands every frame to both branches, so its twin is already waiting in the tap
+        if (av_buffersink_get_frame_flags(filter->tapSink, filter->tapFrame, AV_BUFFERSINK_FLAG_NO_REQUEST) >= 0) {
+            filter->tapFrame->pts = pFrame->pts;
+            filter->tapFrame->best_effort_timestamp = pFrame->pts;
+        }
+    }
+    return 0;
+}
+
+void filter_set_tap(VideoFilter* filter, int tap) {
+    if (filter != NULL) {
+        filter->tap = tap != 0;
+    }
+}
+
+const AVFrame* filter_tapped(const VideoFilter* filter) {
+    if (filter == NULL || filter->tapSink == NULL || filter->tapFrame->buf[0] == NULL) {
+        return NULL;
+    }
+    return filter->tapFrame;
+}
+
+void filter_reset(VideoFilter* filter) {
+    if (filter == NULL) {
+        return;
+    }
+    // a graph can't be flushed without ending it, so it's built again from the next frame
+    avfilter_graph_free(&filter->graph);
+    av_frame_unref(filter->tapFrame);
+    filter->source = NULL;
+    filter->sink = NULL;
+    filter->tapSink = NULL;
+    filter->eof = 0;
+}
+
+void filter_free(VideoFilter** filter) {
+    if (*filter == NULL) {
+        return;
+    }
+    avfilter_graph_free(&(*filter)->graph);
+    av_frame_free(&(*filter)->tapFrame);
+    av_freep(&(*filter)->description);
+    av_freep(filter);
+}
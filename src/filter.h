@@ -0,0 +1,79 @@
+// This file is a part of videna.
+// Copyright (C) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef FILTER_H
+#define FILTER_H
+#include <libavfilter/avfilter.h>
+#include <libavfilter/buffersrc.h>
+#include <libavfilter/buffersink.h>
+#include <libavformat/avformat.h>
+#include <libavutil/frame.h>
+#include <stdint.h>
+
+typedef struct {
+    char* description;      // the filters of the user, NULL when only the conversion runs in the graph
+    int threads;
+    AVRational time_base;   // of the stream, frames come out of the graph in it
+
+    AVFilterGraph* graph;
+    AVFilterContext* source;
+    AVFilterContext* sink;
+    int eof;
+
+    // with tap a second sink gets every frame before the final scale and conversion, for the outputs
+    // that read the picture themselves, such as the scene analysis and the tensors
+    int tap;
+    AVFilterContext* tapSink;
+    AVFrame* tapFrame;      // the one of the frame pulled last
+
+    // input and output the graph was configured for, it's rebuilt when one of them changes
+    int srcWidth;
+    int srcHeight;
+    int srcFormat;
+    AVRational srcAspect;
+    int width;
+    int height;
+    int format;
+    int tapped;
+} VideoFilter;
+
+// Filters of the display matrix of stream, NULL when it isn't rotated
+const char* filter_rotation(const AVStream* stream);
+
+// description is in the syntax of ffmpeg -vf and may be NULL, threads 0 uses one per core
+VideoFilter* filter_alloc(const char* description, int threads, AVRational time_base);
+
+// Sends a decoded frame to the graph, or the end of the stream when pFrame is NULL.
+// width and height of 0 keep the size the filters output, format of AV_PIX_FMT_NONE their format.
+int filter_push(VideoFilter* filter, AVFrame* pFrame, int width, int height, int format);
+
+// 0 when pFrame holds a filtered frame, AVERROR(EAGAIN) when the graph needs more input
+// and AVERROR_EOF once it's drained after the end of the stream.
+int filter_pull(VideoFilter* filter, AVFrame* pFrame);
+
+// Adds or removes the second sink, the graph is rebuilt from the next frame when it changes
+void filter_set_tap(VideoFilter* filter, int tap);
+
+// The frame pulled last as it was before the final scale and conversion, NULL without a tap
+const AVFrame* filter_tapped(const VideoFilter* filter);
+
+// Drops what the graph holds, the next frame configures it again
+void filter_reset(VideoFilter* filter);
+
+void filter_free(VideoFilter** filter);
+
+#endif
@@ -0,0 +1,275 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "fingerprint.h"
+#include <libavutil/mem.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FINGERPRINT_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FINGERPRINT_NEON
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static void write_u16(uint8_t* dst, uint16_t value) {
+    dst[0] = value;
+    dst[1] = value >> 8;
+}
+
+static void write_u32(uint8_t* dst, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        dst[i] = value >> (8 * i);
+    }
+}
+
+static void write_u64(uint8_t* dst, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        dst[i] = value >> (8 * i);
+    }
+}
+
+static int write_header(FingerprintIndex* index, AVRational time_base) {
+    uint8_t header[FINGERPRINT_HEADER_SIZE];
+    memcpy(header, FINGERPRINT_MAGIC, 4);
+    write_u16(header + 4, FINGERPRINT_VERSION);
+    write_u16(header + 6, 0);
+    write_u32(header + 8, time_base.num);
+    write_u32(header + 12, time_base.den);
+    write_u32(header + 16, index->count);
+    if (fseek(index->file, 0, SEEK_SET) != 0) {
+        return -1;
+    }
+    return fwrite(header, FINGERPRINT_HEADER_SIZE, 1, index->file) == 1 ? 0 : -1;
+}
+
+static int compare_floats(const void* a, const void* b) {
+    float x = *(const float*) a;
+    float y = *(const float*) b;
+    return (x > y) - (x < y);
+}
+
+static int hamming(uint64_t a, uint64_t b) {
+    uint64_t x = a ^ b;
+    int bits = 0;
+    while (x) {
+        x &= x - 1;
+        bits++;
+    }
+    return bits;
+}
+
+FingerprintIndex* fingerprint_open(const char* path, AVRational time_base, int minDistance) {
+    FingerprintIndex* index = av_mallocz(sizeof(FingerprintIndex));
+    if (index == NULL) {
+        return NULL;
+    }
+    index->file = fopen(path, "wb");
+    if (index->file == NULL) {
+        av_free(index);
+        return NULL;
+    }
+    index->minDistance = minDistance;
+    for (int u = 0; u < FINGERPRINT_BITS; u++) {
+        for (int x = 0; x < FINGERPRINT_SIDE; x++) {
+            index->dct[u][x] = cos((2 * x + 1) * u * M_PI / (2 * FINGERPRINT_SIDE));
+        }
+    }
+    // the count is patched in by fingerprint_close
+    if (write_header(index, time_base) < 0) {
+        fclose(index->file);
+        av_free(index);
+        return NULL;
+    }
+    return index;
+}
+
+// First DCT pass for one frequency: row[x] = sum over y of basis[y] * samples[y][x], four columns at a time
+static void dct_row(const float* basis, const float* samples, float* row) {
+    int x = 0;
+#if defined(FINGERPRINT_SSE2)
+    for (; x + 4 <= FINGERPRINT_SIDE; x += 4) {
+        __m128 acc = _mm_setzero_ps();
+        for (int y = 0; y < FINGERPRINT_SIDE; y++) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(basis[y]), _mm_loadu_ps(samples + y * FINGERPRINT_SIDE + x)));
+        }
+        _mm_storeu_ps(row + x, acc);
+    }
+#elif defined(FINGERPRINT_NEON)
+    for (; x + 4 <= FINGERPRINT_SIDE; x += 4) {
+        float32x4_t acc = vdupq_n_f32(0);
+        for (int y = 0; y < FINGERPRINT_SIDE; y++) {
+            acc = vmlaq_n_f32(acc, vld1q_f32(samples + y * FINGERPRINT_SIDE + x), basis[y]);
+        }
+        vst1q_f32(row + x, acc);
+    }
+#endif
+    for (; x < FINGERPRINT_SIDE; x++) {
+        float sum = 0;
+        for (int y = 0; y < FINGERPRINT_SIDE; y++) {
+            sum += basis[y] * samples[y * FINGERPRINT_SIDE + x];
+        }
+        row[x] = sum;
+    }
+}
+
+// Second DCT pass: dot product of a first pass row with a basis vector
+static float dct_dot(const float* row, const float* basis) {
+    float sum = 0;
+    int x = 0;
+#if defined(FINGERPRINT_SSE2)
+    __m128 acc = _mm_setzero_ps();
+    float lanes[4];
+    for (; x + 4 <= FINGERPRINT_SIDE; x += 4) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(row + x), _mm_loadu_ps(basis + x)));
+    }
+    _mm_storeu_ps(lanes, acc);
+    sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(FINGERPRINT_NEON)
+    float32x4_t acc = vdupq_n_f32(0);
+    for (; x + 4 <= FINGERPRINT_SIDE; x += 4) {
+        acc = vmlaq_f32(acc, vld1q_f32(row + x), vld1q_f32(basis + x));
+    }
+    float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    sum = vget_lane_f32(vpadd_f32(pair, pair), 0);
+#endif
+    for (; x < FINGERPRINT_SIDE; x++) {
+        sum += row[x] * basis[x];
+    }
+    return sum;
+}
+
+// Downscales the luma to 32x32 and derives a 64 bit DCT hash and a 64 bit average hash from it
+int fingerprint_compute(FingerprintIndex* index, const AVFrame* pFrame, Fingerprint* fingerprint) {
+    uint8_t* dst[4] = {index->pixels, NULL, NULL, NULL};
+    int dstStride[4] = {FINGERPRINT_SIDE, 0, 0, 0};
+    float samples[FINGERPRINT_SIDE * FINGERPRINT_SIDE];
+    float rows[FINGERPRINT_BITS][FINGERPRINT_SIDE];
+    float coefficients[FINGERPRINT_BITS * FINGERPRINT_BITS];
+    float sorted[FINGERPRINT_BITS * FINGERPRINT_BITS - 1];
+    float median;
+    uint32_t blocks[FINGERPRINT_BITS * FINGERPRINT_BITS];
+    uint32_t total = 0;
+    int blockSide = FINGERPRINT_SIDE / FINGERPRINT_BITS;
+
+    index->sws_context = sws_getCachedContext(index->sws_context, pFrame->width,
+                            pFrame->height,
+                            pFrame->format,
+                            FINGERPRINT_SIDE,
+                            FINGERPRINT_SIDE,
+                            AV_PIX_FMT_GRAY8,
+                            SWS_AREA,
+                            NULL,
+                            NULL,
+                            NULL
+                            );
+    if (index->sws_context == NULL) {
+        return -1;
+    }
+    sws_scale(index->sws_context, (const uint8_t * const*)pFrame->data,
+        pFrame->linesize, 0, pFrame->height, dst, dstStride);
+
+    // separable DCT-II, only the lowest 8x8 frequencies are needed
+    for (int i = 0; i < FINGERPRINT_SIDE * FINGERPRINT_SIDE; i++) {
+        samples[i] = index->pixels[i];
+    }
+    for (int u = 0; u < FINGERPRINT_BITS; u++) {
+        dct_row(index->dct[u], samples, rows[u]);
+    }
+    for (int u = 0; u < FINGERPRINT_BITS; u++) {
+        for (int v = 0; v < FINGERPRINT_BITS; v++) {
+            coefficients[u * FINGERPRINT_BITS + v] = dct_dot(rows[u], index->dct[v]);
+        }
+    }
+    // the DC term only carries the brightness, so it is left out of the median
+    memcpy(sorted, coefficients + 1, sizeof(sorted));
+    qsort(sorted, FINGERPRINT_BITS * FINGERPRINT_BITS - 1, sizeof(float), compare_floats);
+    median = sorted[(FINGERPRINT_BITS * FINGERPRINT_BITS - 1) / 2];
+    fingerprint->dctHash = 0;
+    for (int i = 0; i < FINGERPRINT_BITS * FINGERPRINT_BITS; i++) {
+        if (coefficients[i] > median) {
+            fingerprint->dctHash |= (uint64_t)1 << i;
+        }
+    }
+
+    for (int by = 0; by < FINGERPRINT_BITS; by++) {
+        for (int bx = 0; bx < FINGERPRINT_BITS; bx++) {
+            uint32_t sum = 0;
+            for (int y = by * blockSide; y < (by + 1) * blockSide; y++) {
+                for (int x = bx * blockSide; x < (bx + 1) * blockSide; x++) {
+                    sum += index->pixels[y * FINGERPRINT_SIDE + x];
+                }
+            }
+            blocks[by * FINGERPRINT_BITS + bx] = sum;
+            total += sum;
+        }
+    }
+    fingerprint->averageHash = 0;
+    for (int i = 0; i < FINGERPRINT_BITS * FINGERPRINT_BITS; i++) {
+        if ((uint64_t)blocks[i] * FINGERPRINT_BITS * FINGERPRINT_BITS > total) {
+            fingerprint->averageHash |= (uint64_t)1 << i;
+        }
+    }
+    return 0;
+}
+
+// Returns 1 when a record was written, 0 when the frame was too similar to the last one
+int fingerprint_add(FingerprintIndex* index, const AVFrame* pFrame, int64_t pts) {
+    Fingerprint fingerprint;
+    uint8_t record[FINGERPRINT_RECORD_SIZE];
+    if (fingerprint_compute(index, pFrame, &fingerprint) < 0) {
+        return -1;
+    }
+    if (index->hasLast && index->minDistance > 0 && hamming(index->lastHash, fingerprint.dctHash) < index->minDistance) {
+        return 0;
+    }
+    write_u64(record, pts);
+    write_u64(record + 8, fingerprint.dctHash);
+    write_u64(record + 16, fingerprint.averageHash);
+    if (fwrite(record, FINGERPRINT_RECORD_SIZE, 1, index->file) != 1) {
+        return -1;
+    }
+    index->lastHash = fingerprint.dctHash;
+    index->hasLast = 1;
+    index->count++;
+    return 1;
+}
+
+int fingerprint_close(FingerprintIndex** index) {
+    uint8_t count[4];
+    int ret;
+    if (*index == NULL) {
+        return -1;
+    }
+    ret = (*index)->count;
+    write_u32(count, (*index)->count);
+    if (fseek((*index)->file, 16, SEEK_SET) != 0 || fwrite(count, 4, 1, (*index)->file) != 1) {
+        ret = -1;
+    }
+    if (fclose((*index)->file) != 0) {
+        ret = -1;
+    }
+    sws_freeContext((*index)->sws_context);
+    av_freep(index);
+    return ret;
+}
@@ -0,0 +1,61 @@
+// This file is a part of videna.
+// Copyright (C) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef FINGERPRINT_H
+#define FINGERPRINT_H
+#include <libavutil/frame.h>
+#include <libavutil/rational.h>
+#include <libswscale/swscale.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Index file layout, all little endian:
+//   header: "VFPI", uint16 version, uint16 reserved, int32 timebase num, int32 timebase den, uint32 count
+//   count records: int64 pts, uint64 DCT hash, uint64 average hash
+#define FINGERPRINT_MAGIC "VFPI"
+#define FINGERPRINT_VERSION 1
+#define FINGERPRINT_HEADER_SIZE 20
+#define FINGERPRINT_RECORD_SIZE 24
+#define FINGERPRINT_SIDE 32
+#define FINGERPRINT_BITS 8
+
+typedef struct {
+    int64_t pts;
+    uint64_t dctHash;
+    uint64_t averageHash;
+} Fingerprint;
+
+typedef struct {
+    FILE* file;
+    struct SwsContext* sws_context;
+    uint8_t pixels[FINGERPRINT_SIDE * FINGERPRINT_SIDE];
+    float dct[FINGERPRINT_BITS][FINGERPRINT_SIDE];
+    uint32_t count;
+    int minDistance;
+    uint64_t lastHash;
+    int hasLast;
+} FingerprintIndex;
+
+FingerprintIndex* fingerprint_open(const char* path, AVRational time_base, int minDistance);
+
+int fingerprint_compute(FingerprintIndex* index, const AVFrame* pFrame, Fingerprint* fingerprint);
+
+int fingerprint_add(FingerprintIndex* index, const AVFrame* pFrame, int64_t pts);
+
+int fingerprint_close(FingerprintIndex** index);
+
+#endif
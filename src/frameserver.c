@@ -0,0 +1,383 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "frameserver.h"
+#include "threads.h"
+#include <stdio.h>
+#include <string.h>
+#if (defined(__linux__) && !defined(__ANDROID__)) || defined(__APPLE__)
+#define FRAME_SERVER_SHM
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#define ALIGN_UP(x) (((x) + FRAME_SERVER_ALIGN - 1) / FRAME_SERVER_ALIGN * FRAME_SERVER_ALIGN)
+
+int64_t frameserver_frame_bytes(int planes, const int rowBytes[4], const int rows[4]) {
+    int64_t bytes = 0;
+    for (int i = 0; i < planes && i < 4; i++) {
+        bytes += (int64_t) ALIGN_UP(rowBytes[i]) * rows[i];
+    }
+    return bytes;
+}
+
+#ifdef FRAME_SERVER_SHM
+
+static int64_t now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+// The words live in memory shared between processes, so the futexes can't be private
+static void wait_word(volatile int32_t* word, int32_t seen, int timeoutMs) {
+#ifdef __linux__
+    struct timespec timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_nsec = (long) (timeoutMs % 1000) * 1000000;
+    syscall(SYS_futex, word, FUTEX_WAIT, seen, &timeout, NULL, 0);
+#else
+    int64_t deadline = now_ms() + timeoutMs;
+    while (__atomic_load_n(word, __ATOMIC_ACQUIRE) == seen && now_ms() < deadline) {
+        usleep(500);
+    }
+#endif
+}
+
+static void wake_word(volatile int32_t* word) {
+    __atomic_add_fetch(word, 1, __ATOMIC_RELEASE);
+#ifdef __linux__
+    syscall(SYS_futex, word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+static FrameServerSlot* slot_of(FrameServerHeader* header, int64_t frame) {
+    return (FrameServerSlot*) ((uint8_t*) header + header->dataOffset + ((frame - 1) % header->slots) * header->slotStride);
+}
+
+static uint8_t* picture_of(FrameServerSlot* slot) {
+    return (uint8_t*) slot + ALIGN_UP(sizeof(FrameServerSlot));
+}
+
+// POSIX names start with a single slash
+static void shm_name(const char* name, char* shmName, size_t size) {
+    snprintf(shmName, size, "%s%s", name[0] == '/' ? "" : "/", name);
+}
+
+// Whether the object at shmName was left behind by a server, closed or of a process that no longer runs.
+// Objects of servers still running, and those that aren't a frame server at all, are kept.
+static int shm_stale(const char* shmName) {
+    const FrameServerHeader* header;
+    struct stat info;
+    int stale = 0;
+    int fd = shm_open(shmName, O_RDONLY, 0);
+    if (fd < 0) {
+        return 0;
+    }
+    if (fstat(fd, &info) == 0 && (size_t) info.st_size >= sizeof(FrameServerHeader)) {
+        header = mmap(NULL, sizeof(FrameServerHeader), PROT_READ, MAP_SHARED, fd, 0);
+        if (header != MAP_FAILED) {
+            stale = header->magic == FRAME_SERVER_MAGIC && header->version == FRAME_SERVER_VERSION
+                && (header->closed || (kill(header->pid, 0) != 0 && errno == ESRCH));
+            munmap((void*) header, sizeof(FrameServerHeader));
+        }
+    }
+    close(fd);
+    return stale;
+}
+
+FrameServer* frameserver_create(const char* name, int slots, int64_t slotBytes, int policy) {
+    FrameServer* server;
+    FrameServerHeader* header;
+    int64_t dataOffset = ALIGN_UP(sizeof(FrameServerHeader));
+    int64_t slotStride = ALIGN_UP(sizeof(FrameServerSlot)) + ALIGN_UP(slotBytes);
+    if (name == NULL || slots < 1 || slots > FRAME_SERVER_MAX_SLOTS || slotBytes <= 0
+            || (policy != frameServerDropOldest && policy != frameServerBackpressure)) {
+        return NULL;
+    }
+    server = calloc(1, sizeof(FrameServer));
+    if (server == NULL) {
+        return NULL;
+    }
+    shm_name(name, server->name, sizeof(server->name));
+    server->size = (size_t) (dataOffset + slots * slotStride);
+    server->fd = shm_open(server->name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (server->fd < 0 && errno == EEXIST && shm_stale(server->name)) {
+        // a server that crashed leaves its object behind
+        shm_unlink(server->name);
+        server->fd = shm_open(server->name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    }
+    if (server->fd < 0) {
+        fprintf(stderr, "Could not create the shared memory %s\n", server->name);
+        free(server);
+        return NULL;
+    }
+    if (ftruncate(server->fd, (off_t) server->size) != 0) {
+        close(server->fd);
+        shm_unlink(server->name);
+        free(server);
+        return NULL;
+    }
+    header = mmap(NULL, server->size, PROT_READ | PROT_WRITE, MAP_SHARED, server->fd, 0);
+    if (header == MAP_FAILED) {
+        close(server->fd);
+        shm_unlink(server->name);
+        free(server);
+        return NULL;
+    }
+    // the object starts zeroed, so the slots are empty
+    header->slots = slots;
+    header->policy = policy;
+    header->slotBytes = slotBytes;
+    header->slotStride = slotStride;
+    header->dataOffset = dataOffset;
+    header->pid = (int32_t) getpid();
+    header->version = FRAME_SERVER_VERSION;
+    memory_fence();
+    // clients check the magic last
+    header->magic = FRAME_SERVER_MAGIC;
+    server->header = header;
+    return server;
+}
+
+// Waits for the backpressure client to release a slot, false when it stalled
+static int wait_for_client(FrameServerHeader* header, int64_t frame) {
+    int64_t deadline = now_ms() + FRAME_SERVER_STALL_MS;
+    for (;;) {
+        int32_t seen = __atomic_load_n(&header->released, __ATOMIC_ACQUIRE);
+        int64_t remaining;
+        if (!__atomic_load_n(&header->attached, __ATOMIC_ACQUIRE)
+                || frame - load_acquire(&header->read) <= header->slots) {
+            return 1;
+        }
+        remaining = deadline - now_ms();
+        if (remaining <= 0) {
+            // until it releases a frame again
+            __atomic_store_n(&header->attached, 0, __ATOMIC_RELEASE);
+            return 0;
+        }
+        wait_word(&header->released, seen, (int) remaining);
+    }
+}
+
+int frameserver_publish(FrameServer* server, int planes, const uint8_t* const data[4], const int linesize[4],
+        const int rowBytes[4], const int rows[4], int width, int height, int format, int64_t pts, int64_t delay) {
+    FrameServerHeader* header = server->header;
+    FrameServerSlot* slot;
+    uint8_t* picture;
+    int64_t frame = header->written + 1;
+    int64_t offset = 0;
+    int64_t sequence;
+    if (planes > 4 || frameserver_frame_bytes(planes, rowBytes, rows) > header->slotBytes
+            || (header->policy == frameServerBackpressure && !wait_for_client(header, frame))) {
+        store_release(&header->dropped, header->dropped + 1);
+        return -1;
+    }
+    slot = slot_of(header, frame);
+    picture = picture_of(slot);
+    sequence = slot->sequence;
+    store_release(&slot->sequence, sequence + 1);
+    memory_fence();
+    slot->frame = frame;
+    slot->pts = pts;
+    slot->delay = delay;
+    slot->width = width;
+    slot->height = height;
+    slot->format = format;
+    slot->planes = planes;
+    for (int i = 0; i < 4; i++) {
+        slot->linesize[i] = i < planes ? ALIGN_UP(rowBytes[i]) : 0;
+        slot->offset[i] = i < planes ? offset : 0;
+        for (int y = 0; i < planes && y < rows[i]; y++) {
+            memcpy(picture + offset + (int64_t) y * slot->linesize[i], data[i] + (int64_t) y * linesize[i], rowBytes[i]);
+        }
+        if (i < planes) {
+            offset += (int64_t) slot->linesize[i] * rows[i];
+        }
+    }
+    store_release(&slot->sequence, sequence + 2);
+    store_release(&header->written, frame);
+    wake_word(&header->published);
+    return 0;
+}
+
+void frameserver_close(FrameServer** server) {
+    if (*server == NULL) {
+        return;
+    }
+    __atomic_store_n(&(*server)->header->closed, 1, __ATOMIC_RELEASE);
+    wake_word(&(*server)->header->published);
+    munmap((*server)->header, (*server)->size);
+    close((*server)->fd);
+    // clients that mapped it keep their mapping until they close
+    shm_unlink((*server)->name);
+    free(*server);
+    *server = NULL;
+}
+
+FFI_EXPORT FrameClient* frameClientOpen(const char* name) {
+    char shmName[256];
+    struct stat info;
+    FrameClient* client;
+    FrameServerHeader* header;
+    if (name == NULL) {
+        return NULL;
+    }
+    client = calloc(1, sizeof(FrameClient));
+    if (client == NULL) {
+        return NULL;
+    }
+    shm_name(name, shmName, sizeof(shmName));
+    client->fd = shm_open(shmName, O_RDWR, 0);
+    if (client->fd < 0 || fstat(client->fd, &info) != 0 || (size_t) info.st_size < sizeof(FrameServerHeader)) {
+        fprintf(stderr, "Could not open the shared memory %s\n", shmName);
+        if (client->fd >= 0) {
+            close(client->fd);
+        }
+        free(client);
+        return NULL;
+    }
+    client->size = (size_t) info.st_size;
+    header = mmap(NULL, client->size, PROT_READ | PROT_WRITE, MAP_SHARED, client->fd, 0);
+    if (header == MAP_FAILED) {
+        close(client->fd);
+        free(client);
+        return NULL;
+    }
+    client->header = header;
+    if (header->magic != FRAME_SERVER_MAGIC || header->version != FRAME_SERVER_VERSION
+            || client->size < (size_t) (header->dataOffset + header->slots * header->slotStride)) {
+        fprintf(stderr, "%s isn't a frame server\n", shmName);
+        frameClientClose(&client);
+        return NULL;
+    }
+    memory_fence();
+    if (header->policy == frameServerBackpressure) {
+        // the frames published before the client came are left behind
+        store_release(&header->read, load_acquire(&header->written));
+        __atomic_store_n(&header->attached, 1, __ATOMIC_RELEASE);
+    }
+    client->next = load_acquire(&header->written) + 1;
+    return client;
+}
+
+FFI_EXPORT const FrameServerSlot* frameClientAcquire(FrameClient* client, int timeoutMs, const uint8_t** data) {
+    FrameServerHeader* header = client->header;
+    int64_t deadline = now_ms() + timeoutMs;
+    for (;;) {
+        int32_t seen = __atomic_load_n(&header->published, __ATOMIC_ACQUIRE);
+        int64_t written = load_acquire(&header->written);
+        FrameServerSlot* slot;
+        int64_t sequence;
+        if (written >= client->next) {
+            if (written - client->next >= header->slots) {
+                // overwritten already, the oldest frame left is the one after the slot being written
+                client->next = written - header->slots + 2;
+                client->next = client->next > written ? written : client->next;
+            }
+            slot = slot_of(header, client->next);
+            sequence = load_acquire(&slot->sequence);
+            if ((sequence & 1) == 0 && slot->frame == client->next) {
+                client->frame = client->next;
+                client->sequence = sequence;
+                *data = picture_of(slot);
+                return slot;
+            }
+            // the server got to the slot first
+            client->next = written;
+            continue;
+        }
+        if (__atomic_load_n(&header->closed, __ATOMIC_ACQUIRE)) {
+            return NULL;
+        }
+        if (timeoutMs >= 0 && now_ms() >= deadline) {
+            return NULL;
+        }
+        wait_word(&header->published, seen, timeoutMs >= 0 ? (int) (deadline - now_ms()) : 100);
+    }
+}
+
+FFI_EXPORT int frameClientRelease(FrameClient* client, const FrameServerSlot* slot) {
+    FrameServerHeader* header = client->header;
+    int intact;
+    memory_fence();
+    intact = load_acquire(&((FrameServerSlot*) slot)->sequence) == client->sequence;
+    client->next = client->frame + 1;
+    if (header->policy == frameServerBackpressure) {
+        store_release(&header->read, client->frame);
+        __atomic_store_n(&header->attached, 1, __ATOMIC_RELEASE);
+        wake_word(&header->released);
+    }
+    return intact ? 0 : -1;
+}
+
+FFI_EXPORT void frameClientClose(FrameClient** client) {
+    if (*client == NULL) {
+        return;
+    }
+    if ((*client)->header->magic == FRAME_SERVER_MAGIC && (*client)->header->policy == frameServerBackpressure) {
+        __atomic_store_n(&(*client)->header->attached, 0, __ATOMIC_RELEASE);
+        wake_word(&(*client)->header->released);
+    }
+    munmap((*client)->header, (*client)->size);
+    close((*client)->fd);
+    free(*client);
+    *client = NULL;
+}
+
+#else
+
+FrameServer* frameserver_create(const char* name, int slots, int64_t slotBytes, int policy) {
+    fprintf(stderr, "Shared memory frames aren't supported on this platform\n");
+    return NULL;
+}
+
+int frameserver_publish(FrameServer* server, int planes, const uint8_t* const data[4], const int linesize[4],
+        const int rowBytes[4], const int rows[4], int width, int height, int format, int64_t pts, int64_t delay) {
+    return -1;
+}
+
+void frameserver_close(FrameServer** server) {
+}
+
+FFI_EXPORT FrameClient* frameClientOpen(const char* name) {
+    fprintf(stderr, "Shared memory frames aren't supported on this platform\n");
+    return NULL;
+}
+
+FFI_EXPORT const FrameServerSlot* frameClientAcquire(FrameClient* client, int timeoutMs, const uint8_t** data) {
+    return NULL;
+}
+
+FFI_EXPORT int frameClientRelease(FrameClient* client, const FrameServerSlot* slot) {
+    return -1;
+}
+
+FFI_EXPORT void frameClientClose(FrameClient** client) {
+}
+
+#endif
@@ -0,0 +1,124 @@
+// This file is a part of videna.
+// Copyright (C) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef FRAMESERVER_H
+#define FRAMESERVER_H
+// Shared by the server and the clients in other processes, so it doesn't depend on FFmpeg
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef FFI_EXPORT
+#ifdef _WIN32
+#define FFI_EXPORT __declspec(dllexport)
+#else
+#define FFI_EXPORT
+#endif
+#endif
+
+#define FRAME_SERVER_MAGIC 0x5644534du
+#define FRAME_SERVER_VERSION 1
+#define FRAME_SERVER_MAX_SLOTS 64
+// planes and slots start on cache lines
+#define FRAME_SERVER_ALIGN 64
+// a backpressure client that doesn't release a frame for this long stops holding the server back
+#define FRAME_SERVER_STALL_MS 1000
+
+enum frameServerPolicies {
+    frameServerDropOldest,      // the newest frame overwrites the oldest, any number of clients
+    frameServerBackpressure     // the server waits for the one client to release its frame
+};
+
+// Header of one slot, its picture follows at FRAME_SERVER_ALIGN
+typedef struct {
+    volatile int64_t sequence;  // odd while the server writes the slot
+    int64_t frame;              // number of the frame in the slot, from 1
+    int64_t pts;                // milliseconds
+    int64_t delay;              // microseconds until the next frame
+    int32_t width;
+    int32_t height;
+    int32_t format;             // the formats of ReadyFrame
+    int32_t planes;
+    int32_t linesize[4];
+    int64_t offset[4];          // of every plane from the start of the picture
+} FrameServerSlot;
+
+// Start of the shared memory, the slots follow at dataOffset
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t slots;
+    int32_t policy;
+    int64_t slotBytes;          // largest picture a slot holds
+    int64_t slotStride;         // from one slot header to the next
+    int64_t dataOffset;
+    volatile int64_t written;   // frames published so far, frame n is in slot (n - 1) % slots
+    volatile int64_t read;      // last frame released by the backpressure client
+    volatile int64_t dropped;   // frames the server couldn't publish
+    volatile int32_t published; // futex words, they change with every frame published and released
+    volatile int32_t released;
+    volatile int32_t attached;  // a backpressure client is reading
+    volatile int32_t closed;
+    int32_t pid;                // process of the server, the object of one that crashed is replaced
+} FrameServerHeader;
+
+typedef struct {
+    char name[256];
+    int fd;
+    FrameServerHeader* header;
+    size_t size;
+} FrameServer;
+
+typedef struct {
+    int fd;
+    FrameServerHeader* header;
+    size_t size;
+    int64_t next;               // frame acquired next
+    int64_t frame;              // frame acquired last and its slot sequence when it was acquired
+    int64_t sequence;
+} FrameClient;
+
+// Bytes the planes take in a slot, rows of rowBytes aligned to FRAME_SERVER_ALIGN
+int64_t frameserver_frame_bytes(int planes, const int rowBytes[4], const int rows[4]);
+
+// Creates the POSIX shared memory object name. An object of that name is only replaced when it was left behind
+// by a server that closed or whose process is gone. Only available on Linux and macOS.
+FrameServer* frameserver_create(const char* name, int slots, int64_t slotBytes, int policy);
+
+// Copies a converted frame into the next slot and wakes the clients.
+// Returns 0, or -1 when the frame didn't fit or the backpressure client stalled and it was dropped.
+int frameserver_publish(FrameServer* server, int planes, const uint8_t* const data[4], const int linesize[4],
+    const int rowBytes[4], const int rows[4], int width, int height, int format, int64_t pts, int64_t delay);
+
+// Wakes the clients, which see the server closed, and removes the name
+void frameserver_close(FrameServer** server);
+
+// Client API, for the processes reading the frames
+
+FFI_EXPORT FrameClient* frameClientOpen(const char* name);
+
+// Waits up to timeoutMs, or forever when it's negative, for the next frame and returns its slot.
+// The picture is read in place from *data until frameClientRelease().
+// Dropping the oldest frames, a client that falls behind skips to the oldest frame still in the ring.
+// Returns NULL on timeout or once the server is closed.
+FFI_EXPORT const FrameServerSlot* frameClientAcquire(FrameClient* client, int timeoutMs, const uint8_t** data);
+
+// Returns 0 when the picture stayed intact while it was read, -1 when the server overwrote it meanwhile
+FFI_EXPORT int frameClientRelease(FrameClient* client, const FrameServerSlot* slot);
+
+FFI_EXPORT void frameClientClose(FrameClient** client);
+
+#endif
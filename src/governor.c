@@ -0,0 +1,203 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "governor.h"
+#include <libavutil/mem.h>
+
+// Every stream of the process shares one budget, so the accounts live in a global list.
+static Once governorOnce = ONCE_INIT;
+static Mutex governorMutex;
+static MemoryAccount* accounts = NULL;
+static int64_t budget = 0;
+
+static void init_governor(void) {
+    init_lock(&governorMutex);
+}
+
+static int64_t total_usage(void) {
+    int64_t total = 0;
+    for (MemoryAccount* account = accounts; account != NULL; account = account->next) {
+        total += account->usage.total;
+    }
+    return total;
+}
+
+// Bytes a stream is expected to give up when its pressure goes up one level.
+static int64_t relief(MemoryAccount* account) {
+    if (account->pressure == 0) {
+        return account->usage.caches;
+    }
+    // halving both sides of the output leaves a quarter of it
+    return account->usage.output * 3 / 4;
+}
+
+// Raises the pressure on background streams first, and on the foreground ones only as far as dropping
+// their caches, until the expected usage fits in the budget. Pressure is lifted one level at a time
+// once the bytes it saved fit in three quarters of the budget, so streams don't flip at the limit.
+// The streams react on their next frame. Called with governorMutex held.
+static void enforce(void) {
+    int64_t total = total_usage();
+    if (budget <= 0) {
+        for (MemoryAccount* account = accounts; account != NULL; account = account->next) {
+            account->pressure = 0;
+        }
+        return;
+    }
+    if (total > budget) {
+        for (int background = 1; background >= 0 && total > budget; background--) {
+            int limit = background ? MAX_PRESSURE : 1;
+            for (MemoryAccount* account = accounts; account != NULL && total > budget; account = account->next) {
+                if (account->background != background || account->pressure >= limit) {
+                    continue;
+                }
+                account->relief[account->pressure] = relief(account);
+                total -= account->relief[account->pressure];
+                account->pressure++;
+            }
+        }
+        return;
+    }
+    // foreground streams get their bytes back first
+    for (int background = 0; background <= 1; background++) {
+        for (MemoryAccount* account = accounts; account != NULL; account = account->next) {
+            if (account->background != background || account->pressure == 0) {
+                continue;
+            }
+            if (total + account->relief[account->pressure - 1] > budget - budget / 4) {
+                continue;
+            }
+            account->pressure--;
+            total += account->relief[account->pressure];
+        }
+    }
+}
+
+MemoryAccount* governor_register(void) {
+    MemoryAccount* account = av_mallocz(sizeof(MemoryAccount));
+    if (account == NULL) {
+        return NULL;
+    }
+    run_once(&governorOnce, init_governor);
+    lock(&governorMutex);
+    account->next = accounts;
+    if (accounts != NULL) {
+        accounts->prev = account;
+    }
+    accounts = account;
+    unlock(&governorMutex);
+    return account;
+}
+
+void governor_unregister(MemoryAccount** account) {
+    if (*account == NULL) {
+        return;
+    }
+    lock(&governorMutex);
+    if ((*account)->prev != NULL) {
+        (*account)->prev->next = (*account)->next;
+    }
+    else {
+        accounts = (*account)->next;
+    }
+    if ((*account)->next != NULL) {
+        (*account)->next->prev = (*account)->prev;
+    }
+    enforce();
+    unlock(&governorMutex);
+    av_freep(account);
+}
+
+void governor_update(MemoryAccount* account, const MemoryUsage* usage) {
+    if (account == NULL) {
+        return;
+    }
+    lock(&governorMutex);
+    account->usage.decoder = usage->decoder;
+    account->usage.output = usage->output;
+    account->usage.queues = usage->queues;
+    account->usage.caches = usage->caches;
+    account->usage.total = usage->decoder + usage->output + usage->queues + usage->caches;
+    enforce();
+    unlock(&governorMutex);
+}
+
+// 0 leaves the stream alone, 1 asks it to drop its caches,
+// every level above that halves the output of a background stream once more.
+int governor_pressure(MemoryAccount* account) {
+    int pressure;
+    if (account == NULL) {
+        return 0;
+    }
+    lock(&governorMutex);
+    pressure = account->pressure;
+    unlock(&governorMutex);
+    return pressure;
+}
+
+void governor_set_background(MemoryAccount* account, int background) {
+    if (account == NULL) {
+        return;
+    }
+    lock(&governorMutex);
+    account->background = background != 0;
+    if (!account->background && account->pressure > 1) {
+        account->pressure = 1;
+    }
+    enforce();
+    unlock(&governorMutex);
+}
+
+MemoryUsage governor_usage(MemoryAccount* account) {
+    MemoryUsage usage = {0};
+    if (account == NULL) {
+        return usage;
+    }
+    lock(&governorMutex);
+    usage = account->usage;
+    usage.budget = budget;
+    usage.pressure = account->pressure;
+    usage.streams = 1;
+    unlock(&governorMutex);
+    return usage;
+}
+
+// Sets the number of bytes all the streams of the process should fit in, 0 removes the budget.
+FFI_EXPORT void setMemoryBudget(int64_t bytes) {
+    run_once(&governorOnce, init_governor);
+    lock(&governorMutex);
+    budget = bytes > 0 ? bytes : 0;
+    enforce();
+    unlock(&governorMutex);
+}
+
+FFI_EXPORT MemoryUsage totalMemoryUsage(void) {
+    MemoryUsage usage = {0};
+    run_once(&governorOnce, init_governor);
+    lock(&governorMutex);
+    for (MemoryAccount* account = accounts; account != NULL; account = account->next) {
+        usage.decoder += account->usage.decoder;
+        usage.output += account->usage.output;
+        usage.queues += account->usage.queues;
+        usage.caches += account->usage.caches;
+        usage.total += account->usage.total;
+        usage.pressure = account->pressure > usage.pressure ? account->pressure : usage.pressure;
+        usage.streams++;
+    }
+    usage.budget = budget;
+    unlock(&governorMutex);
+    return usage;
+}
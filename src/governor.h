@@ -0,0 +1,73 @@
+// This file is a part of videna.
+// Copyright (C) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+#include <stdint.h>
+#include "threads.h"
+
+#ifndef FFI_EXPORT
+#if _WIN32
+#define FFI_EXPORT __declspec(dllexport)
+#else
+#define FFI_EXPORT
+#endif
+#endif
+
+// Pressure levels past the first one halve the output of background streams once more.
+#define MAX_PRESSURE 3
+
+// Bytes held natively, either by one stream or by the whole process.
+typedef struct {
+    int64_t decoder;    // surfaces the decoder keeps for reference and reordering
+    int64_t output;     // converted frames of the output and its renditions
+    int64_t queues;     // frames and packets waiting to be consumed
+    int64_t caches;     // memory every stream drops at pressure 1 and rebuilds once it is lifted, like the last frame
+                        // kept for snapshots, the frames of a loop and http blocks away from the reading position
+    int64_t total;
+    int64_t budget;     // 0 when there is no budget
+    int pressure;       // highest pressure applied, see governor_pressure()
+    int streams;
+} MemoryUsage;
+
+typedef struct MemoryAccount {
+    MemoryUsage usage;
+    int background;
+    int pressure;
+    // estimated bytes freed by each pressure level, given back when the level is lifted
+    int64_t relief[MAX_PRESSURE + 1];
+    struct MemoryAccount* prev;
+    struct MemoryAccount* next;
+} MemoryAccount;
+
+MemoryAccount* governor_register(void);
+
+void governor_unregister(MemoryAccount** account);
+
+void governor_update(MemoryAccount* account, const MemoryUsage* usage);
+
+int governor_pressure(MemoryAccount* account);
+
+void governor_set_background(MemoryAccount* account, int background);
+
+MemoryUsage governor_usage(MemoryAccount* account);
+
+FFI_EXPORT void setMemoryBudget(int64_t bytes);
+
+FFI_EXPORT MemoryUsage totalMemoryUsage(void);
+
+#endif
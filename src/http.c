@@ -0,0 +1,712 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#endif
+#include "http.h"
+#include "trace.h"
+#include <libavutil/avstring.h>
+#include <libavutil/common.h>
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+#include <libavutil/time.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define close_socket closesocket
+static Once winsockOnce = ONCE_INIT;
+
+static void init_winsock(void) {
+    WSADATA data;
+    WSAStartup(MAKEWORD(2, 2), &data);
+}
+#else
+#define close_socket close
+#endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Seconds a connection waits on the server before the block is failed
+#define HTTP_TIMEOUT 10
+#define AVIO_BUFFER_SIZE 65536
+
+// Splits http://host[:port]/path, anything else is refused.
+static int parse_url(HttpSource* source, const char* url) {
+    const char* host = url + 7;
+    const char* end;
+    const char* colon;
+    size_t hostLength;
+    if (strncmp(url, "http://", 7) != 0) {
+        return -1;
+    }
+    end = host + strcspn(host, "/?#");
+    colon = memchr(host, ':', end - host);
+    hostLength = (colon != NULL ? colon : end) - host;
+    if (hostLength == 0 || hostLength >= sizeof(source->host)) {
+        return -1;
+    }
+    memcpy(source->host, host, hostLength);
+    source->host[hostLength] = '\0';
+    if (colon != NULL) {
+        size_t portLength = end - colon - 1;
+        if (portLength == 0 || portLength >= sizeof(source->port)) {
+            return -1;
+        }
+        memcpy(source->port, colon + 1, portLength);
+        source->port[portLength] = '\0';
+    }
+    else {
+        strcpy(source->port, "80");
+    }
+    if (*end == '/') {
+        source->path = av_strdup(end);
+    }
+    else {
+        // a query without a path still needs the root
+        source->path = av_malloc(strlen(end) + 2);
+        if (source->path != NULL) {
+            source->path[0] = '/';
+            strcpy(source->path + 1, end);
+        }
+    }
+    return source->path == NULL ? -1 : 0;
+}
+
+static void disconnect(HttpConnection* connection) {
+    if (connection->socket != -1) {
+        close_socket(connection->socket);
+        connection->socket = -1;
+    }
+    connection->buffered = 0;
+    connection->consumed = 0;
+    connection->streamRemaining = 0;
+}
+
+static int connect_server(HttpConnection* connection) {
+    HttpSource* source = connection->source;
+    struct addrinfo hints;
+    struct addrinfo* addresses;
+    int flag = 1;
+#ifdef _WIN32
+    DWORD timeout = HTTP_TIMEOUT * 1000;
+#else
+    struct timeval timeout;
+    timeout.tv_sec = HTTP_TIMEOUT;
+    timeout.tv_usec = 0;
+#endif
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(source->host, source->port, &hints, &addresses) != 0) {
+        fprintf(stderr, "Could not resolve %s\n", source->host);
+        return -1;
+    }
+    for (struct addrinfo* address = addresses; address != NULL; address = address->ai_next) {
+        intptr_t fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd == -1) {
+            continue;
+        }
+        if (connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+            connection->socket = fd;
+            break;
+        }
+        close_socket(fd);
+    }
+    freeaddrinfo(addresses);
+    if (connection->socket == -1) {
+        fprintf(stderr, "Could not connect to %s\n", source->host);
+        return -1;
+    }
+    // requests are small and answered right away, they shouldn't wait on Nagle
+    setsockopt(connection->socket, IPPROTO_TCP, TCP_NODELAY, (const char*) &flag, sizeof(flag));
+    setsockopt(connection->socket, SOL_SOCKET, SO_RCVTIMEO, (const char*) &timeout, sizeof(timeout));
+    setsockopt(connection->socket, SOL_SOCKET, SO_SNDTIMEO, (const char*) &timeout, sizeof(timeout));
+    connection->buffered = 0;
+    connection->consumed = 0;
+    return 0;
+}
+
+static int send_all(HttpConnection* connection, const char* data, int size) {
+    while (size > 0) {
+        int sent = send(connection->socket, data, size, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return -1;
+        }
+        data += sent;
+        size -= sent;
+    }
+    return 0;
+}
+
+// Reads up to size bytes of the response, from what was already received first.
+static int receive(HttpConnection* connection, uint8_t* data, int size) {
+    int received;
+    if (connection->consumed < connection->buffered) {
+        int available = FFMIN(size, connection->buffered - connection->consumed);
+        memcpy(data, connection->buffer + connection->consumed, available);
+        connection->consumed += available;
+        return available;
+    }
+    // large reads skip the buffer
+    if (size >= (int) sizeof(connection->buffer)) {
+        return recv(connection->socket, (char*) data, size, 0);
+    }
+    received = recv(connection->socket, (char*) connection->buffer, sizeof(connection->buffer), 0);
+    if (received <= 0) {
+        return received;
+    }
+    connection->buffered = received;
+    connection->consumed = 0;
+    return receive(connection, data, size);
+}
+
+static int read_line(HttpConnection* connection, char* line, int size) {
+    int length = 0;
+    for (;;) {
+        uint8_t c;
+        if (receive(connection, &c, 1) != 1) {
+            return -1;
+        }
+        if (c == '\n') {
+            break;
+        }
+        if (c != '\r' && length < size - 1) {
+            line[length++] = c;
+        }
+    }
+    line[length] = '\0';
+    return length;
+}
+
+static int read_body(HttpConnection* connection, uint8_t* data, int64_t size) {
+    while (size > 0) {
+        int received = receive(connection, data, (int) FFMIN(size, INT32_MAX));
+        if (received <= 0) {
+            return -1;
+        }
+        data += received;
+        size -= received;
+    }
+    return 0;
+}
+
+static int discard_body(HttpConnection* connection, int64_t size) {
+    uint8_t scratch[4096];
+    while (size > 0) {
+        int received = receive(connection, scratch, (int) FFMIN(size, (int64_t) sizeof(scratch)));
+        if (received <= 0) {
+            return -1;
+        }
+        size -= received;
+    }
+    return 0;
+}
+
+// Fetches the bytes from start to start + size of the source into data over connection, reusing it when it's open.
+// The size of the whole file is stored in total when the response tells it.
+// Returns the number of bytes stored, or -1 on failure.
+static int fetch_range(HttpConnection* connection, int64_t start, int size, uint8_t* data, int64_t* total) {
+    HttpSource* source = connection->source;
+    char request[2048];
+    char line[1024];
+    int requestSize;
+
+    requestSize = snprintf(request, sizeof(request),
+        "GET %s HTTP/1.1\r\nHost: %s\r\nRange: bytes=%" PRId64 "-%" PRId64 "\r\nUser-Agent: videna\r\nConnection: keep-alive\r\n\r\n",
+        source->path, source->host, start, start + size - 1);
+    if (requestSize < 0 || requestSize >= (int) sizeof(request)) {
+        return -1;
+    }
+    // a kept-alive connection may have been closed by the server in the meantime, so it gets a second try
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int reused = connection->socket != -1;
+        int status = 0;
+        int keepAlive = 1;
+        int64_t length = -1;
+        int64_t rangeStart = 0;
+        int stored;
+
+        if (!reused && connect_server(connection) < 0) {
+            return -1;
+        }
+        if (send_all(connection, request, requestSize) < 0 || read_line(connection, line, sizeof(line)) < 0) {
+            disconnect(connection);
+            if (reused) {
+                continue;
+            }
+            return -1;
+        }
+        if (sscanf(line, "HTTP/%*d.%*d %d", &status) != 1) {
+            disconnect(connection);
+            return -1;
+        }
+        if (strncmp(line, "HTTP/1.0", 8) == 0) {
+            keepAlive = 0;
+        }
+        for (;;) {
+            int lineLength = read_line(connection, line, sizeof(line));
+            if (lineLength < 0) {
+                disconnect(connection);
+                return -1;
+            }
+            if (lineLength == 0) {
+                break;
+            }
+            if (av_strncasecmp(line, "Content-Length:", 15) == 0) {
+                length = strtoll(line + 15, NULL, 10);
+            }
+            else if (av_strncasecmp(line, "Content-Range:", 14) == 0) {
+                const char* slash = strchr(line, '/');
+                const char* bytes = strstr(line, "bytes");
+                if (bytes != NULL) {
+                    rangeStart = strtoll(bytes + 5, NULL, 10);
+                }
+                if (slash != NULL && slash[1] != '*') {
+                    *total = strtoll(slash + 1, NULL, 10);
+                }
+            }
+            else if (av_strncasecmp(line, "Connection:", 11) == 0) {
+                keepAlive = av_stristr(line + 11, "close") == NULL;
+            }
+            else if (av_strncasecmp(line, "Transfer-Encoding:", 18) == 0 && av_stristr(line + 18, "chunked") != NULL) {
+                fprintf(stderr, "Chunked responses aren't supported for %s\n", source->path);
+                disconnect(connection);
+                return -1;
+            }
+        }
+        if ((status != 206 && status != 200) || length < 0) {
+            fprintf(stderr, "Request for %s failed with status %d\n", source->path, status);
+            disconnect(connection);
+            return -1;
+        }
+        if (status == 200) {
+            // the range was ignored and the whole file follows
+            source->noRanges = 1;
+            *total = length;
+            rangeStart = 0;
+        }
+        if (rangeStart > start || discard_body(connection, start - rangeStart) < 0) {
+            disconnect(connection);
+            return -1;
+        }
+        length -= start - rangeStart;
+        stored = (int) FFMIN(length, (int64_t) size);
+        if (read_body(connection, data, stored) < 0) {
+            disconnect(connection);
+            return -1;
+        }
+        connection->streamOffset = start + stored;
+        connection->streamRemaining = length - stored;
+        if (connection->streamRemaining > 0 && connection == &source->connections[0]) {
+            // the rest of the file is read from this response by fetch_stream()
+            return stored;
+        }
+        // the rest of an ignored range would have to be drained before the connection can be reused
+        if (!keepAlive || length > stored) {
+            disconnect(connection);
+        }
+        return stored;
+    }
+    return -1;
+}
+
+// Fetches like fetch_range() for servers that ignore ranges, going on with the whole-file response kept open on
+// connection when it hasn't passed start yet. Reading a file in order costs a single request this way.
+static int fetch_stream(HttpConnection* connection, int64_t start, int size, uint8_t* data, int64_t* total) {
+    if (connection->socket != -1 && connection->streamRemaining > 0 && connection->streamOffset <= start
+            && start - connection->streamOffset < connection->streamRemaining) {
+        int64_t skip = start - connection->streamOffset;
+        int stored = (int) FFMIN((int64_t) size, connection->streamRemaining - skip);
+        if (discard_body(connection, skip) == 0 && read_body(connection, data, stored) == 0) {
+            connection->streamOffset = start + stored;
+            connection->streamRemaining -= skip + stored;
+            if (connection->streamRemaining == 0) {
+                disconnect(connection);
+            }
+            return stored;
+        }
+    }
+    // the response is behind start or gone, the file is requested again
+    disconnect(connection);
+    return fetch_range(connection, start, size, data, total);
+}
+
+static int64_t block_count(HttpSource* source) {
+    return (source->size + HTTP_BLOCK_SIZE - 1) / HTTP_BLOCK_SIZE;
+}
+
+static HttpBlock* find_block(HttpSource* source, int64_t index) {
+    for (int i = 0; i < HTTP_CACHE_BLOCKS; i++) {
+        if (source->blocks[i].state != blockEmpty && source->blocks[i].index == index) {
+            return &source->blocks[i];
+        }
+    }
+    return NULL;
+}
+
+// Takes the least recently read block that isn't being fetched or about to be read.
+static HttpBlock* evict_block(HttpSource* source, int64_t current) {
+    HttpBlock* victim = NULL;
+    for (int i = 0; i < HTTP_CACHE_BLOCKS; i++) {
+        HttpBlock* block = &source->blocks[i];
+        if (block->state == blockEmpty) {
+            return block;
+        }
+        if (block->state == blockWanted || block->state == blockPending
+                || (block->index >= current && block->index <= current + HTTP_READ_AHEAD)) {
+            continue;
+        }
+        if (victim == NULL || block->lastUse < victim->lastUse) {
+            victim = block;
+        }
+    }
+    return victim;
+}
+
+// Asks the workers for block index unless it's cached or on its way. Called with the mutex held.
+static HttpBlock* request_block(HttpSource* source, int64_t index, int64_t current) {
+    HttpBlock* block = find_block(source, index);
+    if (block != NULL) {
+        if (block->state == blockFailed) {
+            block->state = blockWanted;
+            post_semaphore(&source->work);
+        }
+        return block;
+    }
+    block = evict_block(source, current);
+    if (block == NULL) {
+        return NULL;
+    }
+    block->index = index;
+    block->state = blockWanted;
+    block->size = 0;
+    block->lastUse = source->clock;
+    post_semaphore(&source->work);
+    return block;
+}
+
+static void* http_worker(void* connectionV) {
+    HttpConnection* connection = (HttpConnection*) connectionV;
+    HttpSource* source = connection->source;
+    placement_worker("videna http");
+    for (;;) {
+        HttpBlock* block = NULL;
+        int64_t current;
+        int64_t start;
+        int64_t total = source->size;
+        int size;
+        // set before the workers start and never cleared
+        int streamed = source->noRanges;
+        wait_semaphore(&source->work);
+        if (source->placement != NULL) {
+            placement_bind(source->placement, source);
+        }
+        if (streamed) {
+            // blocks are taken and read one at a time, in order, from the single response
+            lock(&source->streamMutex);
+        }
+        lock(&source->mutex);
+        if (source->quit) {
+            unlock(&source->mutex);
+            if (streamed) {
+                unlock(&source->streamMutex);
+            }
+            break;
+        }
+        // the block closest after the reading position goes first
+        current = source->position / HTTP_BLOCK_SIZE;
+        for (int i = 0; i < HTTP_CACHE_BLOCKS; i++) {
+            HttpBlock* candidate = &source->blocks[i];
+            if (candidate->state != blockWanted) {
+                continue;
+            }
+            if (block == NULL || llabs(candidate->index - current) < llabs(block->index - current)) {
+                block = candidate;
+            }
+        }
+        if (block == NULL) {
+            // cancelled by a seek
+            unlock(&source->mutex);
+            if (streamed) {
+                unlock(&source->streamMutex);
+            }
+            continue;
+        }
+        block->state = blockPending;
+        start = block->index * HTTP_BLOCK_SIZE;
+        size = (int) FFMIN((int64_t) HTTP_BLOCK_SIZE, source->size - start);
+        unlock(&source->mutex);
+
+        // a pending block is never evicted, so its memory can be set up without the mutex
+        if (block->data == NULL) {
+            block->data = av_malloc(HTTP_BLOCK_SIZE);
+        }
+        TRACE_BEGIN("http fetch", NULL, start);
+        if (block->data == NULL) {
+            size = -1;
+        }
+        else if (streamed) {
+            size = fetch_stream(&source->connections[0], start, size, block->data, &total);
+        }
+        else {
+            size = fetch_range(connection, start, size, block->data, &total);
+        }
+        TRACE_END("http fetch", NULL, size);
+        if (streamed) {
+            unlock(&source->streamMutex);
+        }
+
+        lock(&source->mutex);
+        block->size = FFMAX(size, 0);
+        block->state = size > 0 ? blockReady : blockFailed;
+        unlock(&source->mutex);
+    }
+    return NULL;
+}
+
+static int read_source(void* opaque, uint8_t* buf, int bufSize) {
+    HttpSource* source = (HttpSource*) opaque;
+    HttpBlock* block;
+    int64_t index;
+    int offset;
+    int copied;
+
+    lock(&source->mutex);
+    if (source->position >= source->size) {
+        unlock(&source->mutex);
+        return AVERROR_EOF;
+    }
+    index = source->position / HTTP_BLOCK_SIZE;
+    offset = (int) (source->position % HTTP_BLOCK_SIZE);
+    while ((block = request_block(source, index, index)) == NULL) {
+        // every block is being fetched, one of them frees up soon
+        unlock(&source->mutex);
+        av_usleep(1000);
+        lock(&source->mutex);
+    }
+    for (int64_t ahead = index + 1; ahead <= index + HTTP_READ_AHEAD && ahead < block_count(source); ahead++) {
+        if (request_block(source, ahead, index) == NULL) {
+            break;
+        }
+    }
+    while (block->state == blockWanted || block->state == blockPending) {
+        unlock(&source->mutex);
+        av_usleep(1000);
+        lock(&source->mutex);
+    }
+    if (block->state == blockFailed || offset >= block->size) {
+        // dropped so the next read tries again
+        block->state = blockEmpty;
+        unlock(&source->mutex);
+        return AVERROR(EIO);
+    }
+    copied = FFMIN(bufSize, block->size - offset);
+    memcpy(buf, block->data + offset, copied);
+    block->lastUse = ++source->clock;
+    source->position += copied;
+    unlock(&source->mutex);
+    return copied;
+}
+
+static int64_t seek_source(void* opaque, int64_t offset, int whence) {
+    HttpSource* source = (HttpSource*) opaque;
+    int64_t position;
+    int64_t current;
+    if (whence & AVSEEK_SIZE) {
+        return source->size;
+    }
+    lock(&source->mutex);
+    switch (whence & ~AVSEEK_FORCE) {
+        case SEEK_SET:
+            position = offset;
+            break;
+        case SEEK_CUR:
+            position = source->position + offset;
+            break;
+        case SEEK_END:
+            position = source->size + offset;
+            break;
+        default:
+            unlock(&source->mutex);
+            return AVERROR(EINVAL);
+    }
+    if (position < 0) {
+        unlock(&source->mutex);
+        return AVERROR(EINVAL);
+    }
+    source->position = position;
+    // read-ahead for the old position isn't needed anymore
+    current = position / HTTP_BLOCK_SIZE;
+    for (int i = 0; i < HTTP_CACHE_BLOCKS; i++) {
+        HttpBlock* block = &source->blocks[i];
+        if (block->state == blockWanted && (block->index < current || block->index > current + HTTP_READ_AHEAD)) {
+            block->state = blockEmpty;
+        }
+    }
+    unlock(&source->mutex);
+    return position;
+}
+
+// Opens url for reading through range requests. The first block is fetched right away, its response gives the size.
+HttpSource* http_open(const char* url) {
+    HttpSource* source;
+    HttpBlock* first;
+    uint8_t* buffer;
+    int size;
+
+#ifdef _WIN32
+    run_once(&winsockOnce, init_winsock);
+#endif
+    if (strncmp(url, "http://", 7) != 0) {
+        return NULL;
+    }
+    source = av_mallocz(sizeof(HttpSource));
+    if (source == NULL) {
+        return NULL;
+    }
+    init_lock(&source->mutex);
+    init_lock(&source->streamMutex);
+    init_semaphore(&source->work);
+    for (int i = 0; i < HTTP_CONNECTIONS; i++) {
+        source->connections[i].source = source;
+        source->connections[i].socket = -1;
+    }
+    if (parse_url(source, url) < 0) {
+        fprintf(stderr, "Could not parse %s\n", url);
+        http_close(&source);
+        return NULL;
+    }
+
+    first = &source->blocks[0];
+    first->data = av_malloc(HTTP_BLOCK_SIZE);
+    if (first->data == NULL) {
+        http_close(&source);
+        return NULL;
+    }
+    source->size = -1;
+    size = fetch_range(&source->connections[0], 0, HTTP_BLOCK_SIZE, first->data, &source->size);
+    if (size <= 0 || source->size <= 0) {
+        http_close(&source);
+        return NULL;
+    }
+    if (source->noRanges) {
+        fprintf(stderr, "%s doesn't support range requests, it is read in order and seeking back reads it again from the start\n", url);
+    }
+    first->index = 0;
+    first->size = size;
+    first->state = blockReady;
+
+    for (int i = 0; i < HTTP_CONNECTIONS; i++) {
+        if (start_thread(&source->workers[i], http_worker, &source->connections[i]) < 0) {
+            break;
+        }
+        source->numWorkers++;
+    }
+    buffer = av_malloc(AVIO_BUFFER_SIZE);
+    if (buffer != NULL) {
+        source->avio = avio_alloc_context(buffer, AVIO_BUFFER_SIZE, 0, source, read_source, NULL, seek_source);
+    }
+    if (source->numWorkers == 0 || source->avio == NULL) {
+        av_free(buffer);
+        http_close(&source);
+        return NULL;
+    }
+    source->avio->seekable = AVIO_SEEKABLE_NORMAL;
+    return source;
+}
+
+void http_close(HttpSource** source) {
+    if (*source == NULL) {
+        return;
+    }
+    lock(&(*source)->mutex);
+    (*source)->quit = 1;
+    unlock(&(*source)->mutex);
+    for (int i = 0; i < (*source)->numWorkers; i++) {
+        post_semaphore(&(*source)->work);
+    }
+    for (int i = 0; i < (*source)->numWorkers; i++) {
+        join_thread(&(*source)->workers[i]);
+    }
+    for (int i = 0; i < HTTP_CONNECTIONS; i++) {
+        disconnect(&(*source)->connections[i]);
+    }
+    for (int i = 0; i < HTTP_CACHE_BLOCKS; i++) {
+        av_freep(&(*source)->blocks[i].data);
+    }
+    if ((*source)->avio != NULL) {
+        av_freep(&(*source)->avio->buffer);
+        avio_context_free(&(*source)->avio);
+    }
+    av_freep(&(*source)->path);
+    destroy_semaphore(&(*source)->work);
+    destroy_lock(&(*source)->streamMutex);
+    destroy_lock(&(*source)->mutex);
+    av_freep(source);
+}
+
+static int in_window(HttpSource* source, const HttpBlock* block) {
+    int64_t current = source->position / HTTP_BLOCK_SIZE;
+    return block->index >= current && block->index <= current + HTTP_READ_AHEAD;
+}
+
+void http_memory(HttpSource* source, int64_t* queued, int64_t* cached) {
+    *queued = 0;
+    *cached = 0;
+    lock(&source->mutex);
+    for (int i = 0; i < HTTP_CACHE_BLOCKS; i++) {
+        HttpBlock* block = &source->blocks[i];
+        if (block->data == NULL) {
+            continue;
+        }
+        if (block->state == blockWanted || block->state == blockPending || in_window(source, block)) {
+            *queued += HTTP_BLOCK_SIZE;
+        }
+        else {
+            *cached += HTTP_BLOCK_SIZE;
+        }
+    }
+    unlock(&source->mutex);
+}
+
+void http_trim(HttpSource* source) {
+    lock(&source->mutex);
+    for (int i = 0; i < HTTP_CACHE_BLOCKS; i++) {
+        HttpBlock* block = &source->blocks[i];
+        if (block->data == NULL || block->state == blockWanted || block->state == blockPending || in_window(source, block)) {
+            continue;
+        }
+        av_freep(&block->data);
+        block->state = blockEmpty;
+        block->size = 0;
+    }
+    unlock(&source->mutex);
+}
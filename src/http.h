@@ -0,0 +1,101 @@
+// This file is a part of videna.
+// Copyright (C) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef HTTP_H
+#define HTTP_H
+#include <libavformat/avio.h>
+#include <stdint.h>
+#include "threads.h"
+#include "placement.h"
+
+// Sources are read in blocks fetched with range requests and kept in a bounded cache
+#define HTTP_BLOCK_SIZE (256 * 1024)
+#define HTTP_CACHE_BLOCKS 64
+// blocks after the one being read that are fetched ahead of it
+#define HTTP_READ_AHEAD 6
+// connections kept alive to the server, one per fetching thread
+#define HTTP_CONNECTIONS 3
+
+enum httpBlockStates {
+    blockEmpty,
+    blockWanted,
+    blockPending,
+    blockReady,
+    blockFailed
+};
+
+typedef struct {
+    int64_t index;
+    // allocated when the block is first fetched
+    uint8_t* data;
+    int size;
+    int state;
+    // value of the source's clock when the block was last read, for eviction
+    int64_t lastUse;
+} HttpBlock;
+
+typedef struct {
+    struct HttpSource* source;
+    intptr_t socket;    // -1 while closed
+    // response bytes received but not consumed yet
+    uint8_t buffer[4096];
+    int buffered;
+    int consumed;
+    // offset and bytes left of a whole-file response that is kept open, for servers that ignore ranges
+    int64_t streamOffset;
+    int64_t streamRemaining;
+} HttpConnection;
+
+typedef struct HttpSource {
+    char host[256];
+    char port[8];
+    char* path;
+    int64_t size;
+    // the server ignores ranges: blocks are read in order from one whole-file response on the first connection,
+    // only a read before its offset requests the file again
+    int noRanges;
+    Mutex streamMutex;
+
+    int64_t position;
+    HttpBlock blocks[HTTP_CACHE_BLOCKS];
+    int64_t clock;
+    Mutex mutex;
+
+    HttpConnection connections[HTTP_CONNECTIONS];
+    Thread workers[HTTP_CONNECTIONS];
+    int numWorkers;
+    Semaphore work;
+    int quit;
+    // placement of the video reading the source, NULL until one is attached
+    const ThreadPlacement* volatile placement;
+
+    AVIOContext* avio;
+} HttpSource;
+
+// Returns NULL for URLs that aren't plain http, which are left to FFmpeg's own protocols.
+HttpSource* http_open(const char* url);
+
+void http_close(HttpSource** source);
+
+// Bytes of the blocks at and ahead of the reading position in queued, and of the other cached blocks in cached
+void http_memory(HttpSource* source, int64_t* queued, int64_t* cached);
+
+// Frees the cached blocks http_memory() counts in cached, for memory pressure
+void http_trim(HttpSource* source);
+
+#endif
@@ -17,89 +17,135 @@
 
 #include "navigator.h"
 
-#ifdef _WIN32
-static void init_lock(HANDLE* mutex) {
-    *mutex = CreateMutex(NULL,false,NULL);
-}
-static int lock(HANDLE* mutex) {
-    DWORD ret = WaitForSingleObject(*mutex, INFINITE);
-    if (ret == WAIT_OBJECT_0) {
-        return 0;
+const int fmt[UNKOWN_FORMAT] = {
+    AV_PIX_FMT_RGBA,
+    AV_PIX_FMT_BGRA,
+    AV_PIX_FMT_ARGB,
+    AV_PIX_FMT_ABGR,
+    AV_PIX_FMT_YUV420P,
+    AV_PIX_FMT_GRAY8A,
+    AV_PIX_FMT_GRAY16LE,
+    AV_PIX_FMT_NV12,
+    AV_PIX_FMT_RGB24,
+    AV_PIX_FMT_RGB565LE,
+    AV_PIX_FMT_GRAY8,
+    AV_PIX_FMT_P010LE
+};
+
+static int rescale_frame(VideoState* videoState, AVFrame* pFrame, int64_t ptsPacket);
+static int64_t calculateSyncMini(VideoState* videoState, int64_t ptsPacket);
+
+// Whether the container headers describe the video streams well enough to open a decoder
+// without reading packets in avformat_find_stream_info().
+static int headers_suffice(AVFormatContext* pFormatContext) {
+    int found = 0;
+    for (unsigned int i = 0; i < pFormatContext->nb_streams; i++) {
+        AVCodecParameters* codecpar = pFormatContext->streams[i]->codecpar;
+        if (codecpar->codec_type != AVMEDIA_TYPE_VIDEO) {
+            continue;
+        }
+        if (codecpar->codec_id == AV_CODEC_ID_NONE || codecpar->width <= 0 || codecpar->height <= 0
+                || codecpar->format == AV_PIX_FMT_NONE) {
+            return 0;
+        }
+        found = 1;
     }
-    return -1;
+    return found;
 }
-static int unlock(HANDLE* mutex) {
-    bool ret = ReleaseMutex(*mutex);
-    if (ret){
-        return 0;
+
+// Frees what open_video() got before failing, the format context before the HttpSource its AVIOContext belongs to
+static VideoState* open_failed(VideoState* videoState, struct SwsContext* sws_ctx, AVCodecContext** pCodecContext,
+        AVFormatContext** pFormatContext, HttpSource** http) {
+    if (videoState != NULL) {
+        av_packet_free(&videoState->Dpacket);
+        av_frame_free(&videoState->Dframe);
+        av_frame_free(&videoState->lastFrame);
+        av_freep(&videoState->pPlayerFrame);
+        av_free(videoState);
     }
-    return -1;
-}
-static void destroy_lock(HANDLE* mutex) {
-    CloseHandle(*mutex);
-}
-#else
-static void init_lock(pthread_mutex_t* mutex) {
-    pthread_mutex_init(mutex, NULL);
-}
-static int lock(pthread_mutex_t* mutex) {
-    pthread_mutex_lock(mutex);
-    return 0;
-}
-static int unlock(pthread_mutex_t* mutex) {
-    pthread_mutex_unlock(mutex);
-    return 0;
+    sws_freeContext(sws_ctx);
+    avcodec_free_context(pCodecContext);
+    avformat_close_input(pFormatContext);
+    http_close(http);
+    return NULL;
 }
-static void destroy_lock(pthread_mutex_t* mutex) {
-    pthread_mutex_destroy(mutex);
-}
-#endif
-
-
-static int rescale_frame(VideoState* videoState, AVFrame* pFrame, int64_t ptsPacket);
 
-FFI_EXPORT void* openVideo(char* path, int pxl, int width, int height){
+static VideoState* open_video(char* path, int pxl, int width, int height, int fastStart) {
     AVFormatContext* pFormatContext = NULL;
+    AVDictionary* options = NULL;
     const AVCodec* pCodec = NULL;
     AVCodecContext* pCodecContext = NULL;
-    VideoState* videoState;
+    VideoState* videoState = NULL;
     int videoStream = -1;
     int ret = 0;
     struct SwsContext* sws_ctx = NULL;
+    int64_t openTime = av_gettime_relative();
+    // falls back to FFmpeg's own protocol when the server can't be read in ranges
+    HttpSource* http = http_open(path);
 
-    avformat_open_input(&pFormatContext, path, NULL, NULL);
+    if (http != NULL) {
+        pFormatContext = avformat_alloc_context();
+        if (pFormatContext == NULL) {
+            http_close(&http);
+            return NULL;
+        }
+        pFormatContext->pb = http->avio;
+        pFormatContext->flags |= AVFMT_FLAG_CUSTOM_IO;
+    }
+    if (fastStart) {
+        // bounded probing, enough for the headers of common containers
+        av_dict_set(&options, "probesize", FAST_START_PROBESIZE, 0);
+        av_dict_set(&options, "analyzeduration", FAST_START_ANALYZEDURATION, 0);
+    }
+    ret = avformat_open_input(&pFormatContext, path, NULL, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        fprintf(stderr, "Could not open %s\n", path);
+        http_close(&http);
+        return NULL;
+    }
     
-    avformat_find_stream_info(pFormatContext, NULL);
+    if (!fastStart || !headers_suffice(pFormatContext)) {
+        avformat_find_stream_info(pFormatContext, NULL);
+    }
     for (unsigned int i = 0; i < pFormatContext->nb_streams; i++) {
         if(pFormatContext->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
             videoStream = i;
             pCodec = avcodec_find_decoder(pFormatContext->streams[i]->codecpar->codec_id);
             if (pCodec == NULL) {
-                printf("Codec isn't supported\n");
-                return NULL;
+                fprintf(stderr, "Codec isn't supported\n");
+                return open_failed(videoState, sws_ctx, &pCodecContext, &pFormatContext, &http);
             }
             break;
         }
     }
 
     if (videoStream == -1 ) {
-        printf("Could not find video stream\n");
-        return NULL;
+        fprintf(stderr, "Could not find video stream\n");
+        return open_failed(videoState, sws_ctx, &pCodecContext, &pFormatContext, &http);
     }
 
     pCodecContext = avcodec_alloc_context3(pCodec);
+    if (pCodecContext == NULL) {
+        fprintf(stderr, "No memory for codec context\n");
+        return open_failed(videoState, sws_ctx, &pCodecContext, &pFormatContext, &http);
+    }
     ret = avcodec_parameters_to_context(pCodecContext,pFormatContext->streams[videoStream]->codecpar);
     if (ret != 0) {
-        printf("Failed while copying params\n");
-        return NULL;
+        fprintf(stderr, "Failed while copying params\n");
+        return open_failed(videoState, sws_ctx, &pCodecContext, &pFormatContext, &http);
     }
 
     ret = avcodec_open2(pCodecContext,pCodec,NULL);
     if (ret != 0) {
-        printf("Failed on open_codec2\n");
-        return NULL;
+        fprintf(stderr, "Failed on open_codec2\n");
+        return open_failed(videoState, sws_ctx, &pCodecContext, &pFormatContext, &http);
     }
     videoState = av_mallocz(sizeof(VideoState));
+    if (videoState == NULL) {
+        fprintf(stderr, "No memory for video state\n");
+        return open_failed(videoState, sws_ctx, &pCodecContext, &pFormatContext, &http);
+    }
 
     if (pxl >= 0 && pxl < sizeof(fmt)/sizeof(fmt[0])) {
         sws_ctx = sws_getContext(pCodecContext->width,
@@ -115,13 +161,30 @@ FFI_EXPORT void* openVideo(char* path, int pxl, int width, int height){
                             );
 
         if (sws_ctx == NULL) {
-            return NULL;
+            return open_failed(videoState, sws_ctx, &pCodecContext, &pFormatContext, &http);
         }
-        
-        videoState->sws_context = sws_ctx;
     }
+    // everything else a failed open frees is allocated before the locks and the governor account
+    videoState->pPlayerFrame = av_mallocz(sizeof(PlayerFrame));
+    videoState->Dpacket = av_packet_alloc();
+    videoState->Dframe = av_frame_alloc();
+    videoState->lastFrame = av_frame_alloc();
+    if (videoState->pPlayerFrame == NULL) {
+        fprintf(stderr, "No memory for player frame\n");
+        return open_failed(videoState, sws_ctx, &pCodecContext, &pFormatContext, &http);
+    }
+    if (videoState->Dpacket == NULL) {
+        fprintf(stderr, "No memory for packet\n");
+        return open_failed(videoState, sws_ctx, &pCodecContext, &pFormatContext, &http);
+    }
+    if (videoState->Dframe == NULL || videoState->lastFrame == NULL) {
+        fprintf(stderr, "No memory for frame\n");
+        return open_failed(videoState, sws_ctx, &pCodecContext, &pFormatContext, &http);
+    }
+    videoState->sws_context = sws_ctx;
     
     videoState->pFormatContext = pFormatContext;
+    videoState->http = http;
     videoState->pCodecContext = pCodecContext;
     videoState->width = pCodecContext->width;
     videoState->height = pCodecContext->height;
@@ -130,8 +193,17 @@ FFI_EXPORT void* openVideo(char* path, int pxl, int width, int height){
     videoState->time_base = pFormatContext->streams[videoStream]->time_base;
     videoState->format = pxl;
     videoState->timescale = videoState->time_base.den;
+    videoState->openTime = openTime;
+    videoState->nextOutputPts = AV_NOPTS_VALUE;
+    videoState->lastKeyPts = AV_NOPTS_VALUE;
+    videoState->trickSpeed = 1;
+    videoState->trickPts = AV_NOPTS_VALUE;
+    placement_default(&videoState->placement);
+    if (http != NULL) {
+        http->placement = &videoState->placement;
+    }
     init_lock(&videoState->mutex);
-    videoState->pPlayerFrame = av_mallocz(sizeof(PlayerFrame));
+    videoState->account = governor_register();
     init_lock(&videoState->pPlayerFrame->mutex);    
     if (width == 0 || height == 0) {
         videoState->pPlayerFrame->width = videoState->width;
@@ -141,19 +213,233 @@ FFI_EXPORT void* openVideo(char* path, int pxl, int width, int height){
         videoState->pPlayerFrame->width = width;
         videoState->pPlayerFrame->height = height;
     }
-    videoState->Dpacket = av_packet_alloc();
-    videoState->Dframe = av_frame_alloc();
-    if (videoState->Dpacket == NULL) {
-        printf("No memory for packet\n");
+    return videoState;
+}
+
+FFI_EXPORT void* openVideo(char* path, int pxl, int width, int height){
+    return (void*)open_video(path, pxl, width, height, 0);
+}
+
+// Opens the video with bounded probing, skipping the stream info analysis when the container headers
+// are enough, and converts the first frame right away. The first call to make_frame() returns that frame.
+FFI_EXPORT void* openVideoFast(char* path, int pxl, int width, int height) {
+    VideoState* videoState = open_video(path, pxl, width, height, 1);
+    if (videoState == NULL) {
+        return NULL;
+    }
+    if (make_frame(videoState) >= 0) {
+        videoState->primed = 1;
+    }
+    return (void*)videoState;
+}
+
+// Opens the video with a filter graph between the decoder and the outputs, in the syntax of ffmpeg -vf.
+// With rotate the picture is first turned upright by the display matrix of the stream.
+// The graph also scales and converts to the output, so the filtered frames aren't converted again.
+// threads are the slice threads of the graph, 0 uses one per core. fastStart bounds the probing like openVideoFast(),
+// the first frame is converted during the open either way.
+FFI_EXPORT void* openVideoFiltered(char* path, int pxl, int width, int height, char* filters, int rotate, int threads, int fastStart) {
+    VideoState* videoState = open_video(path, pxl, width, height, fastStart);
+    const char* rotation;
+    char* description;
+    size_t length;
+    if (videoState == NULL) {
         return NULL;
     }
-    if (videoState->Dframe == NULL ) {
-        printf("No memory for frame\n");
+    rotation = rotate ? filter_rotation(videoState->videoStream) : NULL;
+    length = (rotation != NULL ? strlen(rotation) + 1 : 0) + (filters != NULL ? strlen(filters) : 0) + 1;
+    description = av_mallocz(length);
+    if (description == NULL) {
+        disposeVideo(videoState);
         return NULL;
     }
+    if (rotation != NULL) {
+        av_strlcat(description, rotation, length);
+    }
+    if (filters != NULL && filters[0] != '\0') {
+        if (description[0] != '\0') {
+            av_strlcat(description, ",", length);
+        }
+        av_strlcat(description, filters, length);
+    }
+    videoState->filter = filter_alloc(description, threads, videoState->time_base);
+    av_free(description);
+    if (videoState->filter == NULL) {
+        disposeVideo(videoState);
+        return NULL;
+    }
+    videoState->filterSized = width == 0 || height == 0;
+    // the first frame is converted right away, so filters the graph can't be built with fail the open
+    if (make_frame(videoState) < 0) {
+        disposeVideo(videoState);
+        return NULL;
+    }
+    videoState->primed = 1;
+    return (void*)videoState;
+}
+
+// Opens the numbered images matching pattern, like shot/frame_%04d.png, as a video of rateNum/rateDen frames per second.
+// The first image is the one numbered 0 to 4, the sequence ends before the first missing number.
+// Every image is reached directly by its index, and up to readAhead images after the one output are decoded
+// in parallel on threads workers, 0 uses the defaults for both.
+FFI_EXPORT void* openSequence(char* pattern, int rateNum, int rateDen, int pxl, int width, int height, int threads, int readAhead) {
+    ImageSequence* sequence;
+    VideoState* videoState;
+    AVRational rate;
+    char path[4096];
+    rate.num = rateNum;
+    rate.den = rateDen;
+    sequence = sequence_open(pattern, rate, threads, readAhead);
+    if (sequence == NULL) {
+        return NULL;
+    }
+    // the first image sets up the decoder and the outputs like a video of a single frame
+    videoState = sequence_path(sequence, 0, path, sizeof(path)) >= 0 ? open_video(path, pxl, width, height, 1) : NULL;
+    if (videoState == NULL) {
+        sequence_close(&sequence);
+        return NULL;
+    }
+    sequence->placement = &videoState->placement;
+    videoState->sequence = sequence;
+    // the pts of an image is its index
+    videoState->time_base = av_inv_q(rate);
+    videoState->timescale = videoState->time_base.den;
     return (void*)videoState;
 }
 
+// Microseconds from the start of the open to the first converted frame, or -1 if there was none yet.
+FFI_EXPORT int64_t timeToFirstFrame(void* videoStateV) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    if (videoState->firstFrameTime == 0) {
+        return -1;
+    }
+    return videoState->firstFrameTime - videoState->openTime;
+}
+
+// Metadata read from the headers of an open video, without seeking to its end like getMetadata().
+// The duration is the one declared by the container, which may be off by a few frames.
+FFI_EXPORT Metadata videoMetadata(void* videoStateV) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    Metadata meta;
+    AVRational thou;
+    thou.num = 1;
+    thou.den = 1000;
+    if (videoState->sequence != NULL) {
+        meta.startTime = 0;
+        meta.duration = av_rescale_q(videoState->sequence->count, videoState->time_base, thou);
+        meta.timescale = videoState->timescale;
+        meta.width = videoState->width;
+        meta.height = videoState->height;
+        meta.numStreams = 1;
+        return meta;
+    }
+    meta.startTime = videoState->videoStream->start_time != AV_NOPTS_VALUE
+        ? av_rescale_q(videoState->videoStream->start_time, videoState->time_base, AV_TIME_BASE_Q) : 0;
+    if (videoState->videoStream->duration != AV_NOPTS_VALUE) {
+        meta.duration = av_rescale_q(videoState->videoStream->duration, videoState->time_base, thou);
+    }
+    else if (videoState->pFormatContext->duration != AV_NOPTS_VALUE) {
+        meta.duration = av_rescale_q(videoState->pFormatContext->duration, AV_TIME_BASE_Q, thou);
+    }
+    else {
+        meta.duration = 0;
+    }
+    meta.timescale = videoState->timescale;
+    meta.width = videoState->width;
+    meta.height = videoState->height;
+    meta.numStreams = videoState->pFormatContext->nb_streams;
+    return meta;
+}
+
+// Stream time base between two output frames, from the fixed output rate or trick-play, whichever is sparser
+static int64_t output_interval(VideoState* videoState) {
+    return FFMAX(videoState->outputInterval, videoState->trickInterval);
+}
+
+// Discards in the decoder the frames the output rate would skip anyway, as far as the GOP structure allows:
+// only keyframes when the output interval spans the longest GOP seen, only reference frames when it spans
+// at least two frames. Reverse trick-play only ever shows keyframes.
+static void update_discard(VideoState* videoState) {
+    enum AVDiscard discard = AVDISCARD_DEFAULT;
+    AVRational frameRate = videoState->videoStream->avg_frame_rate;
+    int64_t interval = output_interval(videoState);
+    if (videoState->trickSpeed < 0) {
+        discard = AVDISCARD_NONKEY;
+    }
+    else if (interval > 0) {
+        if (videoState->keyInterval > 0 && interval >= videoState->keyInterval) {
+            discard = AVDISCARD_NONKEY;
+        }
+        else if (frameRate.num > 0 && frameRate.den > 0
+                && interval >= 2 * av_rescale_q(1, av_inv_q(frameRate), videoState->time_base)) {
+            discard = AVDISCARD_NONREF;
+        }
+    }
+    videoState->pCodecContext->skip_frame = discard;
+}
+
+// Whether the decoded frame at pts is due at the output rate. The next slot stays on the grid
+// of the rate unless the frame is late by a whole interval, so skipping doesn't accumulate drift.
+static int frame_due(VideoState* videoState, int64_t pts) {
+    int64_t interval = output_interval(videoState);
+    if (interval <= 0) {
+        return 1;
+    }
+    if (videoState->nextOutputPts != AV_NOPTS_VALUE && pts < videoState->nextOutputPts) {
+        return 0;
+    }
+    if (videoState->nextOutputPts == AV_NOPTS_VALUE || pts >= videoState->nextOutputPts + interval) {
+        videoState->nextOutputPts = pts + interval;
+    }
+    else {
+        videoState->nextOutputPts += interval;
+    }
+    return 1;
+}
+
+static Track* find_track(VideoState* videoState, int streamIndex) {
+    for (int i = 0; i < videoState->numTracks; i++) {
+        if (videoState->tracks[i]->streamIndex == streamIndex) {
+            return videoState->tracks[i];
+        }
+    }
+    return NULL;
+}
+
+// Decodes a packet of one of the tracks into its queue, dropping the oldest frame when the queue is full.
+static void decode_track(VideoState* videoState, AVPacket* pPacket) {
+    Track* track = find_track(videoState, pPacket->stream_index);
+    if (track == NULL) {
+        return;
+    }
+    if (avcodec_send_packet(track->pCodecContext, pPacket) < 0) {
+        return;
+    }
+    while (avcodec_receive_frame(track->pCodecContext, track->decoded) >= 0) {
+        if (track->queued == TRACK_QUEUE) {
+            AVFrame* oldest = track->queue[0];
+            av_frame_unref(oldest);
+            memmove(track->queue, track->queue + 1, (TRACK_QUEUE - 1) * sizeof(AVFrame*));
+            track->queue[TRACK_QUEUE - 1] = oldest;
+            track->queued--;
+            track->skipped++;
+        }
+        av_frame_move_ref(track->queue[track->queued++], track->decoded);
+    }
+}
+
+// The demuxer moved, what the tracks decoded or queued belongs to the old position.
+static void flush_tracks(VideoState* videoState) {
+    for (int i = 0; i < videoState->numTracks; i++) {
+        Track* track = videoState->tracks[i];
+        avcodec_flush_buffers(track->pCodecContext);
+        for (int j = 0; j < track->queued; j++) {
+            av_frame_unref(track->queue[j]);
+        }
+        track->queued = 0;
+    }
+}
+
 static int decode_frame(VideoState* videoState){
     int frameReady = 0;
     int ret;
@@ -166,15 +452,26 @@ static int decode_frame(VideoState* videoState){
         if (quitting){
             return -1;
         }
+        TRACE_BEGIN("read", videoState, 0);
         ret = av_read_frame(videoState->pFormatContext, pPacket);
+        TRACE_END("read", videoState, ret < 0 ? ret : pPacket->size);
         if (ret < 0){
             return -2;
         }
         
         if (pPacket->stream_index == videoState->videoIndex){
             localPts = pPacket->pts;
+            if ((pPacket->flags & AV_PKT_FLAG_KEY) && pPacket->pts != AV_NOPTS_VALUE) {
+                if (videoState->lastKeyPts != AV_NOPTS_VALUE && pPacket->pts - videoState->lastKeyPts > videoState->keyInterval) {
+                    videoState->keyInterval = pPacket->pts - videoState->lastKeyPts;
+                    update_discard(videoState);
+                }
+                videoState->lastKeyPts = pPacket->pts;
+            }
+            TRACE_BEGIN("decode", videoState, pPacket->pts);
             ret = avcodec_send_packet(videoState->pCodecContext, pPacket) == AVERROR(EAGAIN);
             if (ret < 0){
+                TRACE_END("decode", videoState, ret);
                 quitting =1;
                 return -1;
             }
@@ -182,6 +479,7 @@ static int decode_frame(VideoState* videoState){
                 ret = avcodec_receive_frame(videoState->pCodecContext, pFrame);
                 if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
                     if (ret == AVERROR_EOF){
+                        TRACE_END("decode", videoState, ret);
                         av_packet_unref(pPacket);
                         return -2;
                     }
@@ -200,11 +498,17 @@ static int decode_frame(VideoState* videoState){
                 }
                 //pts
             }
+            TRACE_END("decode", videoState, frameReady);
             if (frameReady && ret >= 0) {
                 break;
             }
 
             
+        }
+        else if (videoState->numTracks > 0) {
+            TRACE_BEGIN("decode track", videoState, pPacket->stream_index);
+            decode_track(videoState, pPacket);
+            TRACE_END("decode track", videoState, pPacket->stream_index);
         }
         av_packet_unref(pPacket);
     }
@@ -213,16 +517,778 @@ static int decode_frame(VideoState* videoState){
     return localPts;
 }
 
-FFI_EXPORT int make_frame(void* videoStateV) {
-    VideoState* videoState = (VideoState*) videoStateV;
-    int ret = decode_frame(videoState);
+// Returns the next frame the decoder still holds once av_read_frame() hit the end of the file, -2 when it is empty.
+// Repeated flush packets are refused with AVERROR_EOF, so this can be called until it returns -2.
+static int drain_frame(VideoState* videoState) {
+    avcodec_send_packet(videoState->pCodecContext, NULL);
+    if (avcodec_receive_frame(videoState->pCodecContext, videoState->Dframe) < 0) {
+        return -2;
+    }
+    videoState->last_dts = videoState->Dframe->pkt_dts;
+    return videoState->Dframe->pts == AV_NOPTS_VALUE ? 0 : videoState->Dframe->pts;
+}
+
+// Decodes the next frame into Dframe through the filter graph when there is one, returns like decode_frame()
+static int next_frame(VideoState* videoState) {
+    VideoFilter* filter = videoState->filter;
+    PlayerFrame* pPlayerFrame = videoState->pPlayerFrame;
+    AVFrame* pFrame = videoState->Dframe;
+    int width = 0;
+    int height = 0;
+    int format = videoState->sws_context != NULL ? fmt[videoState->format] : AV_PIX_FMT_NONE;
+    int ret;
+    if (filter == NULL) {
+        return decode_frame(videoState);
+    }
+    if (!videoState->filterSized) {
+        width = pPlayerFrame->width;
+        height = pPlayerFrame->height;
+    }
+    for (;;) {
+        TRACE_BEGIN("filter", videoState, 0);
+        ret = filter_pull(filter, pFrame);
+        TRACE_END("filter", videoState, ret);
+        if (ret == 0) {
+            if (videoState->filterSized) {
+                // rotations and crops change the size of the output
+                pPlayerFrame->width = pFrame->width;
+                pPlayerFrame->height = pFrame->height;
+            }
+            return pFrame->pts > 0 ? pFrame->pts : 0;
+        }
+        if (ret == AVERROR_EOF) {
+            return -2;
+        }
+        if (ret != AVERROR(EAGAIN)) {
+            return -1;
+        }
+        ret = decode_frame(videoState);
+        if (ret == -2) {
+            // drains what filters like fps still hold
+            filter_push(filter, NULL, width, height, format);
+            continue;
+        }
+        if (ret < 0) {
+            return ret;
+        }
+        if (pFrame->pts == AV_NOPTS_VALUE) {
+            pFrame->pts = pFrame->best_effort_timestamp;
+        }
+        if (filter_push(filter, pFrame, width, height, format) < 0) {
+            return -1;
+        }
+    }
+}
+
+// The frame the analysis and the tensor read. With a filter graph it's the filtered frame before the graph's
+// final scale and conversion, as the output format, RGB more often than not, has no luma plane to sample.
+static const AVFrame* source_frame(VideoState* videoState) {
+    const AVFrame* tapped = filter_tapped(videoState->filter);
+    // frames replayed from the loop cache didn't just come out of the graph
+    return tapped != NULL && tapped->pts == videoState->Dframe->pts ? tapped : videoState->Dframe;
+}
+
+// The graph taps the frames before the conversion only while something reads them
+static void update_tap(VideoState* videoState) {
+    filter_set_tap(videoState->filter, videoState->analysis != NULL || videoState->tensor != NULL);
+}
+
+static void analyze_frame(VideoState* videoState, int64_t ptsPacket) {
+    AVRational thou;
+    int64_t pts;
+    if (videoState->analysis == NULL) {
+        return;
+    }
+    thou.num = 1;
+    thou.den = 1000;
+    pts = calculateSyncMini(videoState, ptsPacket);
+    analysis_push_frame(videoState->analysis, source_frame(videoState), pts, av_rescale_q(pts, videoState->time_base, thou));
+}
+
+static void free_loop_frames(LoopCache* loop) {
+    for (int i = 0; i < loop->count; i++) {
+        av_frame_free(&loop->frames[i]);
+    }
+    loop->count = 0;
+    loop->bytes = 0;
+}
+
+// Keeps a reference to a frame about to be output if it continues the cached run from the start of the loop.
+// Frames that aren't consecutive, from trick-play or after a seek, start the run over.
+static void loop_store(VideoState* videoState, AVFrame* pFrame, int64_t pts) {
+    LoopCache* loop = videoState->loop;
+    AVFrame* frame;
+    if (loop == NULL || loop->complete || loop->streaming || loop->position >= 0) {
+        return;
+    }
+    if (videoState->trickSpeed < 0 || videoState->trickInterval > 0) {
+        free_loop_frames(loop);
+        return;
+    }
+    if (pts < loop->start || pts >= loop->end) {
+        return;
+    }
+    // the run has to begin at the first frame of the loop, the next wrap seeks there otherwise
+    if (loop->count == 0 && pts > loop->start + FFMAX(videoState->last_pts_delay, 1)) {
+        return;
+    }
+    if (loop->count == loop->capacity) {
+        int capacity = FFMAX(2 * loop->capacity, 64);
+        AVFrame** frames = av_realloc_array(loop->frames, capacity, sizeof(AVFrame*));
+        if (frames == NULL) {
+            return;
+        }
+        loop->frames = frames;
+        loop->capacity = capacity;
+        videoState->pPlayerFrame->allocations++;
+    }
+    frame = av_frame_clone(pFrame);
+    if (frame == NULL) {
+        return;
+    }
+    videoState->pPlayerFrame->allocations++;
+    loop->frames[loop->count++] = frame;
+    loop->bytes += FFMAX(av_image_get_buffer_size(frame->format, frame->width, frame->height, 1), 0);
+    if (loop->bytes > loop->budget) {
+        // too long for the budget, give the memory back and stream every pass
+        free_loop_frames(loop);
+        loop->streaming = 1;
+    }
+}
+
+// Gives the cached frames back under memory pressure, the next pass decodes again and caches once it is lifted.
+// Returns the pts of the frame that was due next when they were being replayed, the decoder has to seek to it,
+// or AV_NOPTS_VALUE.
+static int64_t loop_shed(LoopCache* loop) {
+    int64_t resume = loop->position >= 0 ? loop->frames[loop->position]->pts : AV_NOPTS_VALUE;
+    free_loop_frames(loop);
+    loop->complete = 0;
+    loop->position = -1;
+    return resume;
+}
+
+// Outputs the next cached frame, going back to the first one after the last.
+static int loop_replay(VideoState* videoState) {
+    LoopCache* loop = videoState->loop;
+    AVFrame* frame = loop->frames[loop->position];
+    loop->position = (loop->position + 1) % loop->count;
+    av_frame_unref(videoState->Dframe);
+    if (av_frame_ref(videoState->Dframe, frame) < 0) {
+        return -1;
+    }
+    return rescale_frame(videoState, videoState->Dframe, frame->pts);
+}
+
+// Playback reached the end of the loop: replays the cache when it holds the whole range,
+// and seeks back to the start otherwise.
+static int loop_wrap(VideoState* videoState) {
+    LoopCache* loop = videoState->loop;
+    if (!loop->streaming && loop->count > 0) {
+        loop->complete = 1;
+        loop->position = 0;
+        return loop_replay(videoState);
+    }
+    return seek_precise(videoState, loop->start, 1);
+}
+
+// A seek leaves the cache, and breaks the run of a cache that isn't complete yet
+static void loop_seeked(VideoState* videoState) {
+    LoopCache* loop = videoState->loop;
+    if (loop == NULL) {
+        return;
+    }
+    loop->position = -1;
+    if (!loop->complete) {
+        free_loop_frames(loop);
+    }
+}
+
+// Seeks for trick-play, dropping what the decoder still holds from before the jump
+static int trick_seek(VideoState* videoState, int64_t pts, int flags) {
+    int ret;
+    TRACE_BEGIN("trick seek", videoState, pts);
+    ret = av_seek_frame(videoState->pFormatContext, videoState->videoIndex, pts, flags);
+    TRACE_END("trick seek", videoState, ret);
+    if (ret < 0) {
+        return -1;
+    }
+    avcodec_flush_buffers(videoState->pCodecContext);
+    flush_tracks(videoState);
+    filter_reset(videoState->filter);
+    if (videoState->analysis != NULL) {
+        analysis_reset(videoState->analysis);
+    }
+    videoState->lastKeyPts = AV_NOPTS_VALUE;
+    return 0;
+}
+
+// Outputs the keyframe before the last one shown by reverse trick-play, at least trickInterval earlier.
+// When a GOP is longer than the interval the same keyframe comes back, so the target moves further back.
+static int reverse_frame(VideoState* videoState) {
+    int64_t start = videoState->videoStream->start_time != AV_NOPTS_VALUE ? videoState->videoStream->start_time : 0;
+    int64_t target = videoState->trickPts - videoState->trickInterval;
+    int ret;
+    for (int attempt = 0; attempt < TRICK_REVERSE_ATTEMPTS; attempt++) {
+        int64_t pts;
+        if (videoState->trickPts <= start) {
+            return REACHED_START;
+        }
+        target = FFMAX(target, start);
+        if (trick_seek(videoState, target, AVSEEK_FLAG_BACKWARD) < 0) {
+            return REACHED_START;
+        }
+        ret = next_frame(videoState);
+        if (ret < 0) {
+            return ret;
+        }
+        pts = calculateSyncMini(videoState, ret);
+        if (pts < videoState->trickPts) {
+            videoState->trickPts = pts;
+            return rescale_frame(videoState, videoState->Dframe, ret);
+        }
+        av_frame_unref(videoState->Dframe);
+        if (target == start) {
+            return REACHED_START;
+        }
+        target -= FFMAX(videoState->keyInterval, videoState->trickInterval);
+    }
+    return REACHED_START;
+}
+
+// Outputs the next image of the sequence. Faster trick-play steps over images instead of decoding them.
+static int sequence_frame(VideoState* videoState) {
+    int64_t index = videoState->sequenceNext;
+    int step = (int) llrint(videoState->trickSpeed);
+    int ret;
+    if (step == 0) {
+        step = videoState->trickSpeed < 0 ? -1 : 1;
+    }
+    if (videoState->loop != NULL && index >= videoState->loop->end) {
+        index = videoState->loop->start;
+    }
+    if (index < 0) {
+        return REACHED_START;
+    }
+    TRACE_BEGIN("sequence", videoState, index);
+    ret = sequence_read(videoState->sequence, index, step, videoState->Dframe);
+    TRACE_END("sequence", videoState, ret);
     if (ret < 0) {
         return ret;
     }
+    videoState->Dframe->pts = index;
+    videoState->Dframe->best_effort_timestamp = index;
+    videoState->Dframe->pkt_dts = index;
+    videoState->last_dts = index;
+    videoState->sequenceNext = index + step;
+    analyze_frame(videoState, index);
+    return rescale_frame(videoState, videoState->Dframe, index);
+}
+
+FFI_EXPORT int make_frame(void* videoStateV) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    int ret;
+    placement_bind(&videoState->placement, videoState);
+    if (videoState->primed) {
+        // converted by openVideoFast() and not handed out yet
+        videoState->primed = 0;
+        return videoState->pPlayerFrame->pts;
+    }
+    if (videoState->sequence != NULL) {
+        return sequence_frame(videoState);
+    }
+    if (videoState->trickSpeed < 0 && videoState->trickPts != AV_NOPTS_VALUE) {
+        return reverse_frame(videoState);
+    }
+    if (videoState->loop != NULL && videoState->loop->count > 0 && governor_pressure(videoState->account) > 0) {
+        int64_t resume = loop_shed(videoState->loop);
+        if (resume != AV_NOPTS_VALUE) {
+            return seek_precise(videoState, resume, 1);
+        }
+    }
+    if (videoState->loop != NULL && videoState->loop->position >= 0) {
+        return loop_replay(videoState);
+    }
+    // once the interval spans whole GOPs, the packets in between aren't even read
+    if (videoState->trickInterval > 0 && videoState->keyInterval > 0 && videoState->nextOutputPts != AV_NOPTS_VALUE
+            && videoState->trickInterval >= TRICK_SEEK_GOPS * videoState->keyInterval) {
+        // lands on the keyframe at or after the slot, or stays put when there is none
+        trick_seek(videoState, videoState->nextOutputPts, 0);
+    }
+    for (;;) {
+        ret = next_frame(videoState);
+        if (ret == -2 && videoState->loop != NULL) {
+            // the loop runs to the end of the file
+            return loop_wrap(videoState);
+        }
+        if (ret < 0) {
+            return ret;
+        }
+        if (videoState->loop != NULL && calculateSyncMini(videoState, ret) >= videoState->loop->end) {
+            av_frame_unref(videoState->Dframe);
+            return loop_wrap(videoState);
+        }
+        analyze_frame(videoState, ret);
+        // frames between two output slots are never converted
+        if (frame_due(videoState, calculateSyncMini(videoState, ret))) {
+            break;
+        }
+        av_frame_unref(videoState->Dframe);
+    }
+    if (videoState->trickSpeed < 0) {
+        // the first frame after a seek, reverse trick-play steps back from it
+        videoState->trickPts = calculateSyncMini(videoState, ret);
+    }
 
     return rescale_frame(videoState, videoState->Dframe, ret);
 }
 
+// Decodes and analyzes up to count frames without converting or delivering them
+FFI_EXPORT int analyze_frames(void* videoStateV, int count) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    int analyzed = 0;
+    int ret;
+    while (analyzed < count) {
+        ret = decode_frame(videoState);
+        if (ret == -2) {
+            ret = drain_frame(videoState);
+        }
+        if (ret < 0) {
+            return analyzed > 0 ? analyzed : ret;
+        }
+        analyze_frame(videoState, ret);
+        av_frame_unref(videoState->Dframe);
+        analyzed++;
+    }
+    return analyzed;
+}
+
+// Writes the fingerprints of the frames of path to indexPath, one every intervalMs at most.
+// Returns the number of fingerprints written or -1 on failure.
+FFI_EXPORT int fingerprintVideo(char* path, char* indexPath, int64_t intervalMs, int keyframesOnly, int minDistance) {
+    VideoState* videoState = (VideoState*) openVideo(path, UNKOWN_FORMAT, 0, 0);
+    FingerprintIndex* index;
+    AVRational thou;
+    int64_t next = INT64_MIN;
+    int64_t pts;
+    int64_t progress;
+    int ret;
+    int count;
+    if (!videoState) {
+        return -1;
+    }
+    thou.num = 1;
+    thou.den = 1000;
+    if (keyframesOnly) {
+        videoState->pCodecContext->skip_frame = AVDISCARD_NONKEY;
+    }
+    index = fingerprint_open(indexPath, videoState->time_base, minDistance);
+    if (index == NULL) {
+        disposeVideo(videoState);
+        return -1;
+    }
+    for (;;) {
+        ret = decode_frame(videoState);
+        if (ret == -2) {
+            ret = drain_frame(videoState);
+        }
+        if (ret < 0) {
+            break;
+        }
+        pts = calculateSyncMini(videoState, ret);
+        progress = av_rescale_q(pts, videoState->time_base, thou);
+        if (progress >= next) {
+            if (fingerprint_add(index, videoState->Dframe, pts) < 0) {
+                ret = -1;
+                av_frame_unref(videoState->Dframe);
+                break;
+            }
+            next = progress + intervalMs;
+        }
+        av_frame_unref(videoState->Dframe);
+    }
+    disposeVideo(videoState);
+    count = fingerprint_close(&index);
+    return ret == -1 ? -1 : count;
+}
+
+static void* fingerprint_worker(void* batchV) {
+    FingerprintBatch* batch = (FingerprintBatch*) batchV;
+    int i;
+    placement_worker("videna fingerprint");
+    for (;;) {
+        lock(&batch->mutex);
+        i = batch->next++;
+        unlock(&batch->mutex);
+        if (i >= batch->count) {
+            break;
+        }
+        batch->results[i] = fingerprintVideo(batch->paths[i], batch->indexPaths[i],
+            batch->intervalMs, batch->keyframesOnly, batch->minDistance);
+    }
+    return NULL;
+}
+
+// Fingerprints count files on up to threads threads, results receives the return value of fingerprintVideo for each file
+FFI_EXPORT int fingerprintBatch(char** paths, char** indexPaths, int count, int64_t intervalMs, int keyframesOnly, int minDistance, int threads, int* results) {
+    FingerprintBatch batch;
+    Thread* workers;
+    int started = 0;
+    if (threads <= 0) {
+        threads = av_cpu_count();
+    }
+    threads = FFMIN(threads, count);
+    batch.paths = paths;
+    batch.indexPaths = indexPaths;
+    batch.count = count;
+    batch.intervalMs = intervalMs;
+    batch.keyframesOnly = keyframesOnly;
+    batch.minDistance = minDistance;
+    batch.results = results;
+    batch.next = 0;
+    init_lock(&batch.mutex);
+    workers = av_malloc_array(FFMAX(threads, 1), sizeof(Thread));
+    if (workers != NULL) {
+        while (started < threads - 1 && start_thread(&workers[started], fingerprint_worker, &batch) == 0) {
+            started++;
+        }
+    }
+    // the calling thread is the last worker, and does everything if no thread could be started
+    fingerprint_worker(&batch);
+    for (int i = 0; i < started; i++) {
+        join_thread(&workers[i]);
+    }
+    av_free(workers);
+    destroy_lock(&batch.mutex);
+    return 0;
+}
+
+// Encodes the last frame that was output as an image, *data receives a buffer to release with freeSnapshot.
+// Returns the size of the image or -1 on failure.
+FFI_EXPORT int encodeSnapshot(void* videoStateV, int format, int quality, uint8_t** data) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    AVFrame* pFrame = NULL;
+    AVPacket* packet;
+    int size = -1;
+    *data = NULL;
+    lock(&videoState->mutex);
+    if (videoState->lastFrame->buf[0] != NULL) {
+        pFrame = av_frame_clone(videoState->lastFrame);
+    }
+    unlock(&videoState->mutex);
+    if (pFrame == NULL) {
+        return -1;
+    }
+    packet = av_packet_alloc();
+    if (packet != NULL && snapshot_encode(pFrame, format, quality, packet) == 0) {
+        *data = av_malloc(packet->size);
+        if (*data != NULL) {
+            memcpy(*data, packet->data, packet->size);
+            size = packet->size;
+        }
+    }
+    av_packet_free(&packet);
+    av_frame_free(&pFrame);
+    return size;
+}
+
+FFI_EXPORT void freeSnapshot(uint8_t* data) {
+    av_free(data);
+}
+
+static int save_frame(VideoState* videoState, int64_t mseconds, char* outputPath, int format, int quality) {
+    AVPacket* packet;
+    int ret = seek_precise(videoState, calculateTimeStamp(videoState, mseconds), 1);
+    if (ret < 0) {
+        return -1;
+    }
+    packet = av_packet_alloc();
+    if (packet == NULL) {
+        freeNativeFrame(videoState);
+        return -1;
+    }
+    // the state is opened without a format, so the decoded frame is still in Dframe
+    ret = snapshot_encode(videoState->Dframe, format, quality, packet);
+    if (ret == 0) {
+        ret = snapshot_write(packet, outputPath);
+    }
+    av_packet_free(&packet);
+    av_frame_unref(videoState->Dframe);
+    freeNativeFrame(videoState);
+    return ret;
+}
+
+// Saves the frame of path at mseconds as a PNG or JPEG image
+FFI_EXPORT int saveFrameAt(char* path, int64_t mseconds, char* outputPath, int format, int quality) {
+    VideoState* videoState = (VideoState*) openVideo(path, UNKOWN_FORMAT, 0, 0);
+    int ret;
+    if (!videoState) {
+        return -1;
+    }
+    ret = save_frame(videoState, mseconds, outputPath, format, quality);
+    disposeVideo(videoState);
+    return ret;
+}
+
+static int compare_requests(const void* a, const void* b) {
+    int64_t x = ((const SnapshotRequest*) a)->mseconds;
+    int64_t y = ((const SnapshotRequest*) b)->mseconds;
+    return (x > y) - (x < y);
+}
+
+static void* snapshot_worker(void* batchV) {
+    SnapshotBatch* batch = (SnapshotBatch*) batchV;
+    VideoState* videoState;
+    int chunk;
+    int first;
+    int last;
+    placement_worker("videna snapshot");
+    for (;;) {
+        lock(&batch->mutex);
+        chunk = batch->nextChunk++;
+        unlock(&batch->mutex);
+        if (chunk >= batch->chunks) {
+            break;
+        }
+        first = (int64_t) chunk * batch->count / batch->chunks;
+        last = (int64_t) (chunk + 1) * batch->count / batch->chunks;
+        // every chunk is a run of neighbouring times, so one demuxer moves forward through it
+        videoState = (VideoState*) openVideo(batch->path, UNKOWN_FORMAT, 0, 0);
+        for (int i = first; i < last; i++) {
+            SnapshotRequest* request = &batch->requests[i];
+            batch->results[request->index] = videoState == NULL ? -1
+                : save_frame(videoState, request->mseconds, batch->outputPaths[request->index], batch->format, batch->quality);
+        }
+        if (videoState != NULL) {
+            disposeVideo(videoState);
+        }
+    }
+    return NULL;
+}
+
+// Saves the frames of path at each of the count times in mseconds to the matching outputPaths, on up to threads threads.
+// results receives 0 for every saved frame and -1 for every failure.
+FFI_EXPORT int saveFramesAt(char* path, int64_t* mseconds, char** outputPaths, int count, int format, int quality, int threads, int* results) {
+    SnapshotBatch batch;
+    Thread* workers;
+    int started = 0;
+    if (count <= 0) {
+        return 0;
+    }
+    if (threads <= 0) {
+        threads = av_cpu_count();
+    }
+    threads = FFMIN(threads, count);
+    batch.requests = av_malloc_array(count, sizeof(SnapshotRequest));
+    if (batch.requests == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        batch.requests[i].mseconds = mseconds[i];
+        batch.requests[i].index = i;
+    }
+    qsort(batch.requests, count, sizeof(SnapshotRequest), compare_requests);
+    batch.path = path;
+    batch.outputPaths = outputPaths;
+    batch.count = count;
+    batch.format = format;
+    batch.quality = quality;
+    batch.results = results;
+    batch.chunks = threads;
+    batch.nextChunk = 0;
+    init_lock(&batch.mutex);
+    workers = av_malloc_array(threads, sizeof(Thread));
+    if (workers != NULL) {
+        while (started < threads - 1 && start_thread(&workers[started], snapshot_worker, &batch) == 0) {
+            started++;
+        }
+    }
+    // the calling thread is the last worker, and does everything if no thread could be started
+    snapshot_worker(&batch);
+    for (int i = 0; i < started; i++) {
+        join_thread(&workers[i]);
+    }
+    av_free(workers);
+    destroy_lock(&batch.mutex);
+    av_free(batch.requests);
+    return 0;
+}
+
+// Decodes every frame of path and writes it as pxl at width x height, or the size of the video when either is 0,
+// to outputPath or to fd when outputPath is NULL. Conversion and writing run on threads of the sink,
+// so this thread only demuxes and decodes.
+// Returns the number of frames written, or -1 on failure.
+FFI_EXPORT int64_t exportFrames(char* path, char* outputPath, int fd, int container, int pxl, int width, int height) {
+    VideoState* videoState;
+    Sink* sink;
+    int ret = 0;
+    if (pxl < 0 || pxl >= UNKOWN_FORMAT || (outputPath == NULL && fd < 0)) {
+        return -1;
+    }
+    videoState = (VideoState*) openVideo(path, UNKOWN_FORMAT, 0, 0);
+    if (videoState == NULL) {
+        return -1;
+    }
+    if (width == 0 || height == 0) {
+        width = videoState->width;
+        height = videoState->height;
+    }
+    sink = sink_open(outputPath, fd, container, fmt[pxl], width, height,
+        av_guess_frame_rate(videoState->pFormatContext, videoState->videoStream, NULL),
+        av_guess_sample_aspect_ratio(videoState->pFormatContext, videoState->videoStream, NULL));
+    if (sink == NULL) {
+        disposeVideo(videoState);
+        return -1;
+    }
+    // the state is opened without a format, so decoded frames are left in Dframe
+    while (ret >= 0) {
+        decode_frame(videoState);
+        if (videoState->Dframe->buf[0] == NULL) {
+            break;
+        }
+        ret = sink_push(sink, videoState->Dframe);
+        av_frame_unref(videoState->Dframe);
+    }
+    // the frames the decoder still holds at the end of the file
+    if (ret >= 0 && avcodec_send_packet(videoState->pCodecContext, NULL) >= 0) {
+        while (ret >= 0 && avcodec_receive_frame(videoState->pCodecContext, videoState->Dframe) >= 0) {
+            ret = sink_push(sink, videoState->Dframe);
+            av_frame_unref(videoState->Dframe);
+        }
+    }
+    disposeVideo(videoState);
+    return sink_close(&sink);
+}
+
+FFI_EXPORT int enableAnalysis(void* videoStateV, int step, double cutThreshold) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    analysis_free(&videoState->analysis);
+    videoState->analysis = analysis_alloc(step, cutThreshold);
+    update_tap(videoState);
+    return videoState->analysis == NULL ? -1 : 0;
+}
+
+FFI_EXPORT void disableAnalysis(void* videoStateV) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    analysis_free(&videoState->analysis);
+    update_tap(videoState);
+}
+
+FFI_EXPORT int readAnalysisEvents(void* videoStateV, AnalysisEvent* events, int max) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    if (videoState->analysis == NULL) {
+        return 0;
+    }
+    return analysis_read_events(videoState->analysis, events, max);
+}
+
+// Copies every output frame into [batch, 3, height, width] tensors of the given tensorTypes,
+// resized with one of tensorResizes and normalized per channel with mean and std.
+// Must be called before the first frame is decoded, the decoding thread fills the tensor without locking it.
+FFI_EXPORT int enableTensor(void* videoStateV, int width, int height, int type, int resize, float* mean, float* std, float pad, int batch) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    TensorOptions options;
+    options.width = width;
+    options.height = height;
+    options.type = type;
+    options.resize = resize;
+    for (int c = 0; c < 3; c++) {
+        options.mean[c] = mean != NULL ? mean[c] : 0.0f;
+        options.std[c] = std != NULL ? std[c] : 1.0f;
+    }
+    options.pad = pad;
+    options.batch = batch;
+    tensor_free(&videoState->tensor);
+    videoState->tensor = tensor_alloc(&options);
+    update_tap(videoState);
+    return videoState->tensor == NULL ? -1 : 0;
+}
+
+// Hands out the oldest complete batch until freeTensor(). exists is 0 when none is complete.
+// format is the tensorTypes value and pts that of the first frame in the batch.
+FFI_EXPORT ReadyFrame retrieveTensor(void* videoStateV) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    Tensor* tensor = videoState->tensor;
+    ReadyFrame readyFrame;
+    int64_t pts = 0;
+    AVRational thou;
+    thou.num = 1;
+    thou.den = 1000;
+    memset(&readyFrame, 0, sizeof(readyFrame));
+    if (tensor == NULL) {
+        readyFrame.exists = -1;
+        return readyFrame;
+    }
+    readyFrame.size = tensor_acquire(tensor, &readyFrame.data, &pts);
+    if (readyFrame.size == 0) {
+        return readyFrame;
+    }
+    readyFrame.width = tensor->options.width;
+    readyFrame.height = tensor->options.height;
+    readyFrame.format = tensor->options.type;
+    readyFrame.stride = readyFrame.size / (readyFrame.height * 3 * tensor->options.batch);
+    readyFrame.pts = pts;
+    readyFrame.progress = av_rescale_q(pts, videoState->time_base, thou);
+    readyFrame.dts = videoState->last_dts;
+    readyFrame.dtsProgress = av_rescale_q(videoState->last_dts, videoState->time_base, thou);
+    readyFrame.exists = 1;
+    return readyFrame;
+}
+
+FFI_EXPORT void freeTensor(void* videoStateV) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    if (videoState->tensor != NULL) {
+        tensor_release(videoState->tensor);
+    }
+}
+
+// Hands RGBA frames to a texture of the embedder, listener is called whenever one is shown.
+// Returns the texture for the embedder, which releases it with releaseTexture(), or NULL when the output isn't RGBA.
+FFI_EXPORT void* attachTexture(void* videoStateV, TextureListener listener, void* opaque) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    if (videoState->format < 0 || fmt[videoState->format] != AV_PIX_FMT_RGBA) {
+        fprintf(stderr, "Textures need RGBA frames\n");
+        return NULL;
+    }
+    detachTexture(videoState);
+    videoState->texture = texture_alloc(listener, opaque);
+    return videoState->texture;
+}
+
+FFI_EXPORT void detachTexture(void* videoStateV) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    releaseTexture(videoState->texture);
+    videoState->texture = NULL;
+}
+
+// Copies the converted frame into the texture on the decoding thread, it's drawn once presentTextureFrame() shows it.
+// Called with the mutex of the frame held.
+static void stage_texture(VideoState* videoState) {
+    PlayerFrame* pPlayerFrame = videoState->pPlayerFrame;
+    if (pPlayerFrame->pFrame == NULL || pPlayerFrame->pFrame->data[0] == NULL) {
+        return;
+    }
+    TRACE_BEGIN("texture", videoState, pPlayerFrame->pts);
+    texture_stage(videoState->texture, pPlayerFrame->pFrame->data[0], pPlayerFrame->pFrame->linesize[0],
+        pPlayerFrame->pFrame->width, pPlayerFrame->pFrame->height);
+    TRACE_END("texture", videoState, 0);
+}
+
+// Shows the frame staged last in the texture. With paced it's shown the delay of the frame, at the playback speed,
+// after the previous one, sleeping until then, so the decode loop keeps the pace without going through Dart.
+FFI_EXPORT void presentTextureFrame(void* videoStateV, int paced) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    int64_t delay = 0;
+    if (videoState->texture == NULL) {
+        return;
+    }
+    if (paced) {
+        delay = llrint(videoState->pPlayerFrame->delay / fabs(videoState->trickSpeed));
+    }
+    TRACE_BEGIN("present", videoState, delay);
+    texture_present(videoState->texture, delay);
+    TRACE_END("present", videoState, 0);
+}
+
 static int64_t calculateSyncMini(VideoState* videoState, int64_t ptsPacket) {
     if (videoState->Dframe->pts == AV_NOPTS_VALUE) {
         videoState->Dframe->pts = videoState->Dframe->best_effort_timestamp;
@@ -234,82 +1300,549 @@ static int64_t calculateSyncMini(VideoState* videoState, int64_t ptsPacket) {
     return videoState->Dframe->pts;
 }
 
-static int64_t calculateSync(VideoState* videoState, AVFrame* pFrame, int64_t ptsPacket){
-    //missing guess pts;
-    if (pFrame->pts == AV_NOPTS_VALUE) {
-        pFrame->pts = pFrame->best_effort_timestamp;
-    }
-    if (pFrame->pts < 0) {
-        pFrame->pts = ptsPacket;
+static int64_t calculateSync(VideoState* videoState, AVFrame* pFrame, int64_t ptsPacket){
+    //missing guess pts;
+    if (pFrame->pts == AV_NOPTS_VALUE) {
+        pFrame->pts = pFrame->best_effort_timestamp;
+    }
+    if (pFrame->pts < 0) {
+        pFrame->pts = ptsPacket;
+    }
+    int64_t pts = pFrame->pts;
+    int64_t us_delay;
+    int64_t pts_delay;
+
+    pts_delay = pts - videoState->last_pts;
+    if (videoState->trickSpeed < 0) {
+        pts_delay = -pts_delay;
+    }
+    // trick-play jumps by whole GOPs of varying length, which isn't a discontinuity
+    if (pts_delay <= 0 || (pts_delay > 5 * videoState->last_pts_delay && videoState->last_pts_delay != 0
+            && videoState->trickInterval == 0)) {
+        pts_delay = videoState->last_pts_delay;
+    }
+    videoState->last_pts = pts;
+    videoState->last_pts_delay = pts_delay;
+    us_delay = av_rescale_q(pts_delay,videoState->time_base, AV_TIME_BASE_Q);
+    videoState->pPlayerFrame->delay = us_delay;
+    return pts;
+}
+
+// Points srcData at the top left corner of the region of interest.
+// The corner is moved down to the chroma grid so that every plane starts on a whole sample.
+static void region_source(VideoState* videoState, AVFrame* pFrame, const uint8_t* srcData[4], int* srcWidth, int* srcHeight) {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pFrame->format);
+    int offsets[4] = {0, 0, 0, 0};
+    int x = 0;
+    int y = 0;
+    // frames of a filter graph often have another size than the decoder's
+    *srcWidth = pFrame->width;
+    *srcHeight = pFrame->height;
+    if (videoState->roiWidth > 0 && videoState->roiHeight > 0 && desc != NULL
+            && videoState->roiX < pFrame->width && videoState->roiY < pFrame->height) {
+        int alignW = 1 << desc->log2_chroma_w;
+        int alignH = 1 << desc->log2_chroma_h;
+        x = videoState->roiX & ~(alignW - 1);
+        y = videoState->roiY & ~(alignH - 1);
+        *srcWidth = FFMIN(FFALIGN(videoState->roiX + videoState->roiWidth - x, alignW), pFrame->width - x);
+        *srcHeight = FFMIN(FFALIGN(videoState->roiY + videoState->roiHeight - y, alignH), pFrame->height - y);
+        av_image_fill_linesizes(offsets, pFrame->format, x);
+        if (desc->flags & AV_PIX_FMT_FLAG_PAL) {
+            offsets[1] = 0;
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        int planeY = y;
+        if (pFrame->data[i] == NULL) {
+            srcData[i] = NULL;
+            continue;
+        }
+        if ((i == 1 || i == 2) && desc != NULL) {
+            if (desc->flags & AV_PIX_FMT_FLAG_PAL) {
+                srcData[i] = pFrame->data[i];
+                continue;
+            }
+            planeY = y >> desc->log2_chroma_h;
+        }
+        srcData[i] = pFrame->data[i] + planeY * pFrame->linesize[i] + offsets[i];
+    }
+}
+
+// Whether the luma of the source can be copied as the GRAY8 output without converting it.
+static int luma_direct(const RenditionJob* job, int format, int width, int height) {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(job->srcFormat);
+    if (format != formatGRAY8 || width != job->srcWidth || height != job->srcHeight || desc == NULL) {
+        return 0;
+    }
+    if (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM)) {
+        return 0;
+    }
+    return desc->comp[0].plane == 0 && desc->comp[0].step == 1 && desc->comp[0].depth == 8 && desc->comp[0].shift == 0;
+}
+
+// Converts the region described by job into pPlayerFrame, reallocating its picture when the output size changed.
+static void convert_frame(PlayerFrame* pPlayerFrame, struct SwsContext** sws_context, int format, const RenditionJob* job) {
+    int width = FFMAX(pPlayerFrame->width >> job->shift, 1);
+    int height = FFMAX(pPlayerFrame->height >> job->shift, 1);
+    if (pPlayerFrame->pFrame ==  NULL                                       // I don't have to do scaling( do it in dart)
+                        || width != pPlayerFrame->pFrame->width || height != pPlayerFrame->pFrame->height) {
+        if (pPlayerFrame->pFrame != NULL){
+            av_freep(&pPlayerFrame->pFrame->data[0]);
+            av_frame_free(&pPlayerFrame->pFrame);
+        }
+        pPlayerFrame->pFrame = av_frame_alloc();
+        pPlayerFrame->size = av_image_alloc(pPlayerFrame->pFrame->data,
+            pPlayerFrame->pFrame->linesize,
+            width,
+            height,
+            fmt[format],32);
+        pPlayerFrame->pFrame->width = width;
+        pPlayerFrame->pFrame->height = height;
+        pPlayerFrame->pFrame->pkt_dts = job->pFrame->pkt_dts;
+        pPlayerFrame->allocations += 2;
+        pPlayerFrame->scaledWidth = 0;
+    }
+    if (job->srcFormat == fmt[format] && job->srcWidth == width && job->srcHeight == height) {
+        // already converted by the filter graph
+        av_image_copy(pPlayerFrame->pFrame->data, pPlayerFrame->pFrame->linesize,
+            (const uint8_t**)job->srcData, job->pFrame->linesize, fmt[format], width, height);
+        return;
+    }
+    if (luma_direct(job, format, width, height)) {
+        av_image_copy_plane(pPlayerFrame->pFrame->data[0], pPlayerFrame->pFrame->linesize[0],
+            job->srcData[0], job->pFrame->linesize[0], width, height);
+        return;
+    }
+    // sws_getCachedContext() compares every option, which is only worth it when the source changed
+    if (*sws_context == NULL || job->srcWidth != pPlayerFrame->scaledWidth
+            || job->srcHeight != pPlayerFrame->scaledHeight || job->srcFormat != pPlayerFrame->scaledFormat) {
+        struct SwsContext* previous = *sws_context;
+        *sws_context = sws_getCachedContext(*sws_context, job->srcWidth,
+                                job->srcHeight,
+                                job->srcFormat,
+                                width,
+                                height,
+                                fmt[format],
+                                SWS_BILINEAR,
+                                NULL,
+                                NULL,
+                                NULL
+                                );
+        if (*sws_context == NULL) {
+            return;
+        }
+        if (*sws_context != previous) {
+            pPlayerFrame->allocations++;
+        }
+        pPlayerFrame->scaledWidth = job->srcWidth;
+        pPlayerFrame->scaledHeight = job->srcHeight;
+        pPlayerFrame->scaledFormat = job->srcFormat;
+    }
+    sws_scale(*sws_context, job->srcData,
+        job->pFrame->linesize, 0, job->srcHeight,
+        (uint8_t* const*)pPlayerFrame->pFrame->data, pPlayerFrame->pFrame->linesize);
+}
+
+// Converts for every track the newest queued frame at or before pts of the main stream.
+// The older ones are dropped, the newer ones wait for a later frame of the main stream.
+static void present_tracks(VideoState* videoState, int64_t pts, int64_t delay, int shift) {
+    for (int i = 0; i < videoState->numTracks; i++) {
+        Track* track = videoState->tracks[i];
+        PlayerFrame* pPlayerFrame = track->pPlayerFrame;
+        AVFrame* presented[TRACK_QUEUE];
+        AVFrame* pFrame;
+        int64_t framePts = AV_NOPTS_VALUE;
+        int due = -1;
+        for (int j = 0; j < track->queued; j++) {
+            int64_t queuedPts = track->queue[j]->best_effort_timestamp;
+            if (queuedPts != AV_NOPTS_VALUE
+                    && av_compare_ts(queuedPts, track->stream->time_base, pts, videoState->time_base) > 0) {
+                break;
+            }
+            framePts = queuedPts;
+            due = j;
+        }
+        if (due < 0) {
+            continue;
+        }
+        pFrame = track->queue[due];
+        lock(&pPlayerFrame->mutex);
+        if (!pPlayerFrame->inUse) {
+            RenditionJob job;
+            memset(&job, 0, sizeof(job));
+            job.pFrame = pFrame;
+            job.srcFormat = pFrame->format;
+            for (int p = 0; p < 4; p++) {
+                job.srcData[p] = pFrame->data[p];
+            }
+            job.srcWidth = pFrame->width;
+            job.srcHeight = pFrame->height;
+            job.shift = shift;
+            convert_frame(pPlayerFrame, &track->sws_context, track->format, &job);
+            // in the time base of the main stream, so every output compares directly
+            pPlayerFrame->pts = framePts != AV_NOPTS_VALUE
+                ? av_rescale_q(framePts, track->stream->time_base, videoState->time_base) : pts;
+            pPlayerFrame->delay = delay;
+            pPlayerFrame->inUse = 1;
+        }
+        else {
+            track->skipped++;
+        }
+        unlock(&pPlayerFrame->mutex);
+        track->skipped += due;
+        for (int j = 0; j <= due; j++) {
+            av_frame_unref(track->queue[j]);
+        }
+        // the empty frames go back to the end of the queue
+        memcpy(presented, track->queue, (due + 1) * sizeof(AVFrame*));
+        memmove(track->queue, track->queue + due + 1, (TRACK_QUEUE - due - 1) * sizeof(AVFrame*));
+        memcpy(track->queue + TRACK_QUEUE - due - 1, presented, (due + 1) * sizeof(AVFrame*));
+        track->queued -= due + 1;
+    }
+}
+
+static void* rendition_worker(void* renditionV) {
+    Rendition* rendition = (Rendition*) renditionV;
+    PlayerFrame* pPlayerFrame = rendition->pPlayerFrame;
+    placement_name("videna rendition");
+    for (;;) {
+        wait_semaphore(&rendition->start);
+        if (rendition->quit) {
+            break;
+        }
+        placement_bind(rendition->placement, rendition);
+        lock(&pPlayerFrame->mutex);
+        // A rendition that hasn't been released yet skips this frame instead of holding up the decoder
+        if (!pPlayerFrame->inUse) {
+            TRACE_BEGIN("rendition", rendition->owner, rendition->format);
+            convert_frame(pPlayerFrame, &rendition->sws_context, rendition->format, rendition->job);
+            TRACE_END("rendition", rendition->owner, rendition->format);
+            pPlayerFrame->pts = rendition->job->pts;
+            pPlayerFrame->delay = rendition->job->delay;
+            pPlayerFrame->inUse = 1;
+        }
+        else {
+            rendition->skipped++;
+        }
+        unlock(&pPlayerFrame->mutex);
+        post_semaphore(&rendition->done);
+    }
+    return NULL;
+}
+
+// Reports the bytes held by this stream to the memory governor.
+// The decoder's surfaces aren't visible from here, so they are estimated from the frames it may keep.
+static void account_memory(VideoState* videoState) {
+    AVCodecContext* pCodecContext = videoState->pCodecContext;
+    MemoryUsage usage = {0};
+    int64_t frameSize = av_image_get_buffer_size(pCodecContext->pix_fmt, pCodecContext->width, pCodecContext->height, 1);
+    if (frameSize < 0) {
+        frameSize = 0;
+    }
+    usage.decoder = frameSize * (1 + FFMAX(pCodecContext->refs, 1) + pCodecContext->has_b_frames
+        + FFMAX(pCodecContext->thread_count - 1, 0));
+    if (videoState->sws_context != NULL && videoState->pPlayerFrame->pFrame != NULL) {
+        usage.output = videoState->pPlayerFrame->size;
+    }
+    for (int i = 0; i < videoState->numRenditions; i++) {
+        if (videoState->renditions[i]->pPlayerFrame->pFrame != NULL) {
+            usage.output += videoState->renditions[i]->pPlayerFrame->size;
+        }
+    }
+    if (videoState->lastFrame->buf[0] != NULL) {
+        usage.caches = frameSize;
+    }
+    if (videoState->http != NULL) {
+        int64_t queued;
+        int64_t cached;
+        http_memory(videoState->http, &queued, &cached);
+        usage.queues += queued;
+        usage.caches += cached;
+    }
+    if (videoState->loop != NULL) {
+        usage.caches += videoState->loop->bytes;
+    }
+    for (int i = 0; i < videoState->numTracks; i++) {
+        Track* track = videoState->tracks[i];
+        int64_t trackFrameSize = FFMAX(av_image_get_buffer_size(track->pCodecContext->pix_fmt,
+            track->pCodecContext->width, track->pCodecContext->height, 1), 0);
+        usage.decoder += trackFrameSize * (1 + FFMAX(track->pCodecContext->refs, 1) + track->pCodecContext->has_b_frames);
+        usage.queues += trackFrameSize * track->queued;
+        if (track->pPlayerFrame->pFrame != NULL) {
+            usage.output += track->pPlayerFrame->size;
+        }
+    }
+    if (videoState->tensor != NULL) {
+        usage.queues += tensor_bytes(videoState->tensor);
+    }
+    governor_update(videoState->account, &usage);
+}
+
+// Copies the frame just handed to the output into the status block.
+// Only the decoding thread writes it, readers retry while the sequence is odd or changes under them.
+static void publish_status(VideoState* videoState) {
+    PlayerStatus* status = &videoState->status;
+    PlayerFrame* pPlayerFrame = videoState->pPlayerFrame;
+    int64_t sequence = status->sequence;
+    int64_t dropped = 0;
+    int64_t allocations = pPlayerFrame->allocations;
+    AVRational thou;
+    thou.num = 1;
+    thou.den = 1000;
+    for (int i = 0; i < videoState->numRenditions; i++) {
+        dropped += videoState->renditions[i]->skipped;
+        allocations += videoState->renditions[i]->pPlayerFrame->allocations;
+    }
+    for (int i = 0; i < videoState->numTracks; i++) {
+        dropped += videoState->tracks[i]->skipped;
+        allocations += videoState->tracks[i]->pPlayerFrame->allocations;
+    }
+    if (videoState->tensor != NULL) {
+        dropped += videoState->tensor->dropped;
+    }
+    store_release(&status->sequence, sequence + 1);
+    memory_fence();
+    status->pts = pPlayerFrame->pts;
+    status->dts = videoState->last_dts;
+    status->progress = av_rescale_q(pPlayerFrame->pts, videoState->time_base, thou);
+    status->dtsProgress = av_rescale_q(videoState->last_dts, videoState->time_base, thou);
+    status->delay = pPlayerFrame->delay;
+    status->frames++;
+    status->dropped = dropped;
+    status->allocations = allocations;
+    store_release(&status->sequence, sequence + 2);
+}
+
+// Bytes per row and rows of every plane of a picture, returns the number of planes or -1
+static int plane_sizes(enum AVPixelFormat format, int width, int height, int rowBytes[4], int rows[4]) {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+    int planes = av_pix_fmt_count_planes(format);
+    if (desc == NULL || planes <= 0 || av_image_fill_linesizes(rowBytes, format, width) < 0) {
+        return -1;
+    }
+    for (int i = 0; i < planes; i++) {
+        rows[i] = i == 1 || i == 2 ? AV_CEIL_RSHIFT(height, desc->log2_chroma_h) : height;
+    }
+    return planes;
+}
+
+static void publish_frame(VideoState* videoState) {
+    PlayerFrame* pPlayerFrame = videoState->pPlayerFrame;
+    AVFrame* pFrame = pPlayerFrame->pFrame;
+    int rowBytes[4] = {0};
+    int rows[4] = {0};
+    int planes = plane_sizes(fmt[videoState->format], pFrame->width, pFrame->height, rowBytes, rows);
+    AVRational thou;
+    thou.num = 1;
+    thou.den = 1000;
+    if (planes < 0) {
+        return;
     }
-    int64_t pts = pFrame->pts;
-    int64_t us_delay;
-    int64_t pts_delay;
+    frameserver_publish(videoState->frameServer, planes, (const uint8_t* const*) pFrame->data, pFrame->linesize,
+        rowBytes, rows, pFrame->width, pFrame->height, videoState->format,
+        av_rescale_q(pPlayerFrame->pts, videoState->time_base, thou), pPlayerFrame->delay);
+}
 
-    pts_delay = pts - videoState->last_pts;
-    if (pts_delay <= 0 || (pts_delay > 5 * videoState->last_pts_delay && videoState->last_pts_delay != 0)) {
-        pts_delay = videoState->last_pts_delay;
+// Keeps the frame for snapshots once the outputs are done with it. A converted frame is moved there,
+// as a new reference would allocate for every frame, one handed out as is stays referenced.
+// Under memory pressure nothing is kept, so the decoder can reuse its surface.
+static void keep_frame(VideoState* videoState, AVFrame* pFrame, int pressure) {
+    lock(&videoState->mutex);
+    av_frame_unref(videoState->lastFrame);
+    if (pressure == 0 && videoState->sws_context != NULL) {
+        av_frame_move_ref(videoState->lastFrame, pFrame);
     }
-    videoState->last_pts = pts;
-    videoState->last_pts_delay = pts_delay;
-    us_delay = av_rescale_q(pts_delay,videoState->time_base, AV_TIME_BASE_Q);
-    videoState->pPlayerFrame->delay = us_delay;
-    return pts;
+    else if (pressure == 0) {
+        av_frame_ref(videoState->lastFrame, pFrame);
+    }
+    unlock(&videoState->mutex);
 }
 
 static int rescale_frame(VideoState* videoState, AVFrame* pFrame, int64_t ptsPacket){
     PlayerFrame* pPlayerFrame = videoState->pPlayerFrame;
-    
+    RenditionJob* job = &videoState->renditionJob;
+    int pressure = governor_pressure(videoState->account);
+
+    if (videoState->primed) {
+        // the first frame was never handed out, a seek replaces it
+        videoState->primed = 0;
+        pPlayerFrame->inUse = 0;
+    }
+    TRACE_BEGIN("wait output", videoState, 0);
     while (pPlayerFrame->inUse) {
         av_usleep(1000);
     }
+    TRACE_END("wait output", videoState, 0);
 
     if (lock(&pPlayerFrame->mutex) < 0) {
         return -1;
     }
     pPlayerFrame->pts = calculateSync(videoState, pFrame, ptsPacket);
-    
-    if (videoState->sws_context != NULL) {
-        if (pPlayerFrame->pFrame ==  NULL                                       // I don't have to do scaling( do it in dart)
-                            || pPlayerFrame->width != pFrame->width || pPlayerFrame->height != pFrame->height) {
-            if (pPlayerFrame->pFrame != NULL){
-                av_frame_free(&pPlayerFrame->pFrame);
-                av_free(pPlayerFrame->pFrame);
+    // under memory pressure nothing is cached, see loop_shed() and http_trim()
+    if (pressure == 0) {
+        loop_store(videoState, pFrame, pPlayerFrame->pts);
+    }
+    else if (videoState->http != NULL) {
+        http_trim(videoState->http);
+    }
+
+    if (videoState->sws_context != NULL || videoState->numRenditions > 0) {
+        job->shift = pressure > 1 ? pressure - 1 : 0;
+        job->pFrame = pFrame;
+        // the filter graph outputs another format than the decoder
+        job->srcFormat = pFrame->format;
+        job->pts = pPlayerFrame->pts;
+        job->delay = pPlayerFrame->delay;
+        region_source(videoState, pFrame, job->srcData, &job->srcWidth, &job->srcHeight);
+        for (int i = 0; i < videoState->numRenditions; i++) {
+            post_semaphore(&videoState->renditions[i]->start);
+        }
+        if (videoState->sws_context != NULL) {
+            TRACE_BEGIN("convert", videoState, pPlayerFrame->pts);
+            convert_frame(pPlayerFrame, &videoState->sws_context, videoState->format, job);
+            TRACE_END("convert", videoState, pPlayerFrame->pts);
+            if (videoState->frameServer != NULL && pPlayerFrame->pFrame != NULL) {
+                TRACE_BEGIN("frame server", videoState, pPlayerFrame->pts);
+                publish_frame(videoState);
+                TRACE_END("frame server", videoState, pPlayerFrame->pts);
             }
-            pPlayerFrame->pFrame = av_frame_alloc();
-            pPlayerFrame->size = av_image_alloc(pPlayerFrame->pFrame->data,
-                pPlayerFrame->pFrame->linesize,
-                pPlayerFrame->width,
-                pPlayerFrame->height,
-                fmt[videoState->format],32);
-            pPlayerFrame->pFrame->pkt_dts = pFrame->pkt_dts;
-        }
-        videoState->sws_context = sws_getCachedContext(videoState->sws_context, videoState->width,
-                                videoState->height,
-                                videoState->pCodecContext->pix_fmt,
-                                pPlayerFrame->width,
-                                pPlayerFrame->height,
-                                fmt[videoState->format],
-                                SWS_BILINEAR,
-                                NULL,
-                                NULL,
-                                NULL
-                                );
-        sws_scale(videoState->sws_context, (const uint8_t * const*)pFrame->data,
-            pFrame->linesize, 0, videoState->height, // is height best?
-            (uint8_t* const*)pPlayerFrame->pFrame->data, pPlayerFrame->pFrame->linesize);
+        }
+        TRACE_BEGIN("wait renditions", videoState, videoState->numRenditions);
+        for (int i = 0; i < videoState->numRenditions; i++) {
+            wait_semaphore(&videoState->renditions[i]->done);
+        }
+        TRACE_END("wait renditions", videoState, videoState->numRenditions);
+    }
+    if (videoState->numTracks > 0) {
+        TRACE_BEGIN("tracks", videoState, videoState->numTracks);
+        present_tracks(videoState, pPlayerFrame->pts, pPlayerFrame->delay, pressure > 1 ? pressure - 1 : 0);
+        TRACE_END("tracks", videoState, videoState->numTracks);
+    }
+    if (videoState->tensor != NULL) {
+        TRACE_BEGIN("tensor", videoState, pPlayerFrame->pts);
+        tensor_push(videoState->tensor, source_frame(videoState), pPlayerFrame->pts);
+        TRACE_END("tensor", videoState, pPlayerFrame->pts);
+    }
+    keep_frame(videoState, pFrame, pressure);
+    if (videoState->sws_context != NULL) {
         av_frame_unref(pFrame);
     }
     else {
         pPlayerFrame->pFrame = pFrame;
     }
+    if (videoState->texture != NULL) {
+        stage_texture(videoState);
+    }
     pPlayerFrame->inUse = 1;
+    if (videoState->firstFrameTime == 0) {
+        videoState->firstFrameTime = av_gettime_relative();
+    }
+    account_memory(videoState);
+    publish_status(videoState);
     if (unlock(&pPlayerFrame->mutex) < 0) {
         return -1;
     }
     return videoState->pPlayerFrame->pts;
 }
 
+static PlayerFrame* rendition_frame(VideoState* videoState, int rendition) {
+    if (rendition == 0) {
+        return videoState->pPlayerFrame;
+    }
+    if (rendition < 0 || rendition > videoState->numRenditions) {
+        return NULL;
+    }
+    return videoState->renditions[rendition - 1]->pPlayerFrame;
+}
+
+static void free_rendition(Rendition* rendition) {
+    rendition->quit = 1;
+    post_semaphore(&rendition->start);
+    join_thread(&rendition->worker);
+    destroy_semaphore(&rendition->start);
+    destroy_semaphore(&rendition->done);
+    if (rendition->pPlayerFrame->pFrame != NULL) {
+        av_freep(&rendition->pPlayerFrame->pFrame->data[0]);
+        av_frame_free(&rendition->pPlayerFrame->pFrame);
+    }
+    destroy_lock(&rendition->pPlayerFrame->mutex);
+    av_free(rendition->pPlayerFrame);
+    sws_freeContext(rendition->sws_context);
+    av_free(rendition);
+}
+
+static void free_track(Track* track) {
+    avcodec_free_context(&track->pCodecContext);
+    av_frame_free(&track->decoded);
+    for (int i = 0; i < TRACK_QUEUE; i++) {
+        av_frame_free(&track->queue[i]);
+    }
+    if (track->pPlayerFrame != NULL) {
+        if (track->pPlayerFrame->pFrame != NULL) {
+            av_freep(&track->pPlayerFrame->pFrame->data[0]);
+            av_frame_free(&track->pPlayerFrame->pFrame);
+        }
+        destroy_lock(&track->pPlayerFrame->mutex);
+        av_free(track->pPlayerFrame);
+    }
+    sws_freeContext(track->sws_context);
+    av_free(track);
+}
+
+FFI_EXPORT int addRendition(void* videoStateV, int pxl, int width, int height) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    Rendition* rendition;
+    if (videoState->numRenditions >= MAX_RENDITIONS || pxl < 0 || pxl >= UNKOWN_FORMAT) {
+        return -1;
+    }
+    rendition = av_mallocz(sizeof(Rendition));
+    if (rendition == NULL) {
+        return -1;
+    }
+    rendition->pPlayerFrame = av_mallocz(sizeof(PlayerFrame));
+    if (rendition->pPlayerFrame == NULL) {
+        av_free(rendition);
+        return -1;
+    }
+    init_lock(&rendition->pPlayerFrame->mutex);
+    if (width == 0 || height == 0) {
+        rendition->pPlayerFrame->width = videoState->width;
+        rendition->pPlayerFrame->height = videoState->height;
+    }
+    else {
+        rendition->pPlayerFrame->width = width;
+        rendition->pPlayerFrame->height = height;
+    }
+    rendition->format = pxl;
+    rendition->job = &videoState->renditionJob;
+    rendition->owner = videoState;
+    rendition->placement = &videoState->placement;
+    init_semaphore(&rendition->start);
+    init_semaphore(&rendition->done);
+    if (start_thread(&rendition->worker, rendition_worker, rendition) < 0) {
+        destroy_semaphore(&rendition->start);
+        destroy_semaphore(&rendition->done);
+        destroy_lock(&rendition->pPlayerFrame->mutex);
+        av_free(rendition->pPlayerFrame);
+        av_free(rendition);
+        return -1;
+    }
+    videoState->renditions[videoState->numRenditions] = rendition;
+    videoState->numRenditions++;
+    return videoState->numRenditions;
+}
+
+FFI_EXPORT void resizeRendition(void* videoStateV, int rendition, int width, int height) {
+    PlayerFrame* pPlayerFrame = rendition_frame((VideoState*) videoStateV, rendition);
+    if (pPlayerFrame == NULL) {
+        return;
+    }
+    lock(&pPlayerFrame->mutex);
+    pPlayerFrame->width = width;
+    pPlayerFrame->height = height;
+    unlock(&pPlayerFrame->mutex);
+}
+
 FFI_EXPORT int64_t calculateTimeStampFromJump(void* videoStateV, int64_t currPts, int numFrames){
     VideoState* videoState = (VideoState*) videoStateV;
     return currPts + numFrames*videoState->last_pts_delay - videoState->pCodecContext->delay*videoState->last_pts_delay;
@@ -320,7 +1853,7 @@ FFI_EXPORT int64_t calculateTimeStamp(void* videoStateV, int64_t mseconds) {
     AVRational thou;
     thou.num = 1; 
     thou.den = 1000;
-    return av_rescale_q(mseconds, videoState->time_base, thou);
+    return av_rescale_q(mseconds, thou, videoState->time_base);
     
 }
 
@@ -349,53 +1882,368 @@ FFI_EXPORT void resize(void* videoStateV, int width, int height) {
     VideoState* videoState = (VideoState*) videoStateV;
     videoState->pPlayerFrame->width = width;
     videoState->pPlayerFrame->height = height;
+    videoState->filterSized = 0;
+    if (videoState->proxy != NULL) {
+        resize(videoState->proxy, width, height);
+    }
+}
+
+FFI_EXPORT void setRegion(void* videoStateV, int x, int y, int width, int height, int outWidth, int outHeight) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    if (width <= 0 || height <= 0) {
+        videoState->roiX = 0;
+        videoState->roiY = 0;
+        videoState->roiWidth = 0;
+        videoState->roiHeight = 0;
+        width = videoState->width;
+        height = videoState->height;
+    }
+    else {
+        videoState->roiX = FFMIN(FFMAX(x, 0), videoState->width - 1);
+        videoState->roiY = FFMIN(FFMAX(y, 0), videoState->height - 1);
+        videoState->roiWidth = FFMIN(width, videoState->width - videoState->roiX);
+        videoState->roiHeight = FFMIN(height, videoState->height - videoState->roiY);
+        width = videoState->roiWidth;
+        height = videoState->roiHeight;
+    }
+    if (outWidth > 0 && outHeight > 0) {
+        width = outWidth;
+        height = outHeight;
+    }
+    if (videoState->proxy != NULL) {
+        VideoState* proxy = videoState->proxy;
+        // the proxy picture is smaller, so the region is scaled onto it
+        setRegion(proxy,
+            av_rescale(videoState->roiX, proxy->width, videoState->width),
+            av_rescale(videoState->roiY, proxy->height, videoState->height),
+            av_rescale(videoState->roiWidth, proxy->width, videoState->width),
+            av_rescale(videoState->roiHeight, proxy->height, videoState->height),
+            width, height);
+    }
+    resize(videoStateV, width, height);
+}
+
+// Opens the proxy made by createProxy() for this video. Its frames are converted to the same format
+// and size as the ones of the source, so they can stand in for them while scrubbing.
+// Not available in passthrough mode, where the proxy frames would differ in format and size.
+FFI_EXPORT int attachProxy(void* videoStateV, char* path) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    VideoState* proxy;
+    if (videoState->sws_context == NULL) {
+        return -1;
+    }
+    proxy = (VideoState*) openVideo(path, videoState->format, videoState->pPlayerFrame->width, videoState->pPlayerFrame->height);
+    if (proxy == NULL) {
+        return -1;
+    }
+    if (videoState->proxy != NULL) {
+        disposeVideo(videoState->proxy);
+    }
+    videoState->proxy = proxy;
+    if (videoState->roiWidth > 0 && videoState->roiHeight > 0) {
+        setRegion(videoStateV, videoState->roiX, videoState->roiY, videoState->roiWidth, videoState->roiHeight,
+            videoState->pPlayerFrame->width, videoState->pPlayerFrame->height);
+    }
+    return 0;
+}
+
+FFI_EXPORT MemoryUsage memoryUsage(void* videoStateV) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    return governor_usage(videoState->account);
+}
+
+// Publishes the frames of the main output into the POSIX shared memory object name, where processes using
+// frameClientOpen() read them in place. Each of the slots holds a frame of the current output size,
+// larger ones after a resize are dropped. policy is one of frameServerPolicies.
+FFI_EXPORT int enableFrameServer(void* videoStateV, char* name, int slots, int policy) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    int rowBytes[4] = {0};
+    int rows[4] = {0};
+    int planes;
+    if (videoState->sws_context == NULL) {
+        // nothing is converted
+        return -1;
+    }
+    planes = plane_sizes(fmt[videoState->format], videoState->pPlayerFrame->width, videoState->pPlayerFrame->height,
+        rowBytes, rows);
+    if (planes < 0) {
+        return -1;
+    }
+    disableFrameServer(videoState);
+    videoState->frameServer = frameserver_create(name, slots, frameserver_frame_bytes(planes, rowBytes, rows), policy);
+    return videoState->frameServer != NULL ? 0 : -1;
+}
+
+FFI_EXPORT void disableFrameServer(void* videoStateV) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    frameserver_close(&videoState->frameServer);
+}
+
+// Background streams are the first to give up memory when the process is over its budget,
+// down to a quarter of their output size on each side.
+FFI_EXPORT void setBackground(void* videoStateV, int background) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    governor_set_background(videoState->account, background);
+    if (videoState->proxy != NULL) {
+        governor_set_background(videoState->proxy->account, background);
+    }
+}
+
+// Pins the threads working for this video to the CPUs set in cpus, or lets them run anywhere when it is 0,
+// and sets their nice value, or their SCHED_FIFO priority when realtime isn't 0.
+// The thread calling make_frame() takes it on its next frame, the renditions and http fetches on their next job.
+FFI_EXPORT void setThreadPlacement(void* videoStateV, uint64_t cpus, int nice, int realtime) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    placement_set(&videoState->placement, cpus, nice, realtime);
+    if (videoState->proxy != NULL) {
+        placement_set(&videoState->proxy->placement, cpus, nice, realtime);
+    }
+}
+
+// Makes make_frame() output num/den frames per second of video, picking the first frame at or after
+// each slot. 0 for num or den converts every frame again.
+FFI_EXPORT void setOutputRate(void* videoStateV, int num, int den) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    AVRational interval;
+    if (num <= 0 || den <= 0) {
+        videoState->outputInterval = 0;
+    }
+    else {
+        interval.num = den;
+        interval.den = num;
+        videoState->outputInterval = FFMAX(av_rescale_q(1, interval, videoState->time_base), 1);
+    }
+    videoState->nextOutputPts = AV_NOPTS_VALUE;
+    // the delay between frames changes with the rate, the first one of the new rate has to be accepted
+    videoState->last_pts_delay = 0;
+    update_discard(videoState);
+}
+
+// Makes decoding cost about the same at any speed, the delay of every frame still has to be divided by it.
+// Up to TRICK_MIN_SPEED every frame is output. Faster, only one frame per speed frames is, the others are
+// discarded at the codec and, once that spans whole GOPs, skipped with keyframe seeks.
+// A negative speed plays backwards showing keyframes only, at least -speed frames apart.
+// Zero and non-finite speeds are ignored, the others are clamped to TRICK_MAX_SPEED.
+FFI_EXPORT void setTrickSpeed(void* videoStateV, double speed) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    AVRational frameRate = av_guess_frame_rate(videoState->pFormatContext, videoState->videoStream, NULL);
+    int64_t frameDuration;
+    if (speed == 0 || !isfinite(speed)) {
+        return;
+    }
+    speed = av_clipd(speed, -TRICK_MAX_SPEED, TRICK_MAX_SPEED);
+    if (frameRate.num <= 0 || frameRate.den <= 0) {
+        frameRate.num = 25;
+        frameRate.den = 1;
+    }
+    frameDuration = FFMAX(av_rescale_q(1, av_inv_q(frameRate), videoState->time_base), 1);
+    if (speed > 0 && speed <= TRICK_MIN_SPEED) {
+        videoState->trickInterval = 0;
+    }
+    else {
+        videoState->trickInterval = llrint(fabs(speed) * frameDuration);
+    }
+    if (speed < 0 && videoState->trickSpeed >= 0) {
+        // steps back from the frame on screen
+        videoState->trickPts = videoState->status.frames > 0 ? videoState->last_pts : AV_NOPTS_VALUE;
+    }
+    videoState->trickSpeed = speed;
+    videoState->nextOutputPts = AV_NOPTS_VALUE;
+    videoState->last_pts_delay = 0;
+    update_discard(videoState);
+}
+
+// Loops playback between startMs and endMs. The frames of the first pass from startMs are kept, up to budget bytes,
+// and every later pass replays them without decoding. A longer range seeks back to startMs at every wrap instead.
+// Playback continues from where it is, a seek to startMs starts the loop right away.
+FFI_EXPORT int setLoop(void* videoStateV, int64_t startMs, int64_t endMs, int64_t budget) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    LoopCache* loop = videoState->loop;
+    AVRational thou;
+    thou.num = 1;
+    thou.den = 1000;
+    if (endMs <= startMs) {
+        return -1;
+    }
+    if (loop == NULL) {
+        loop = av_mallocz(sizeof(LoopCache));
+        if (loop == NULL) {
+            return -1;
+        }
+        videoState->loop = loop;
+    }
+    free_loop_frames(loop);
+    loop->start = av_rescale_q(startMs, thou, videoState->time_base);
+    loop->end = av_rescale_q(endMs, thou, videoState->time_base);
+    loop->budget = budget;
+    loop->position = -1;
+    loop->complete = 0;
+    loop->streaming = budget <= 0;
+    return 0;
+}
+
+// Ends the loop and frees its frames.
+// Returns 1 when the frame on screen came from the cache, the decoder is then somewhere else and has to seek to it.
+FFI_EXPORT int clearLoop(void* videoStateV) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    LoopCache* loop = videoState->loop;
+    int replaying;
+    if (loop == NULL) {
+        return 0;
+    }
+    replaying = loop->position >= 0;
+    free_loop_frames(loop);
+    av_free(loop->frames);
+    av_freep(&videoState->loop);
+    return replaying;
+}
+
+FFI_EXPORT PlayerStatus* statusBlock(void* videoStateV) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    return &videoState->status;
+}
+
+// Copies a consistent snapshot of the status block into status, from any thread.
+FFI_EXPORT void readStatus(void* videoStateV, PlayerStatus* status) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    volatile PlayerStatus* source = &videoState->status;
+    int64_t sequence;
+    do {
+        sequence = load_acquire(&source->sequence);
+        status->pts = source->pts;
+        status->dts = source->dts;
+        status->progress = source->progress;
+        status->dtsProgress = source->dtsProgress;
+        status->delay = source->delay;
+        status->frames = source->frames;
+        status->dropped = source->dropped;
+        status->state = source->state;
+        status->allocations = source->allocations;
+        memory_fence();
+    } while ((sequence & 1) || load_acquire(&source->sequence) != sequence);
+    status->sequence = sequence;
+}
+
+// The playback state is decided by the caller of make_frame(), which reports it here.
+FFI_EXPORT void setPlayerState(void* videoStateV, int state) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    PlayerStatus* status = &videoState->status;
+    int64_t sequence = status->sequence;
+    store_release(&status->sequence, sequence + 1);
+    memory_fence();
+    status->state = state;
+    store_release(&status->sequence, sequence + 2);
+}
+
+FFI_EXPORT void* proxyState(void* videoStateV) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    return videoState->proxy;
+}
+
+// The first frame converted during the open was never handed out, after a seek make_frame() must not return it
+static void drop_primed(VideoState* videoState) {
+    if (videoState->primed) {
+        videoState->primed = 0;
+        videoState->pPlayerFrame->inUse = 0;
+    }
 }
 
 FFI_EXPORT int seek_time(void* videoStateV, int64_t mseconds, int backward){
     //
     VideoState* videoState = (VideoState*) videoStateV;
     int flags = AVSEEK_FLAG_BACKWARD * backward;
+    placement_bind(&videoState->placement, videoState);
     AVRational thou;
     thou.num = 1;
     thou.den = 1000;
-    int pts = av_rescale_q(mseconds, videoState->time_base, thou);
+    int64_t pts = av_rescale_q(mseconds, thou, videoState->time_base);
     int ret;
+    if (videoState->sequence != NULL) {
+        // any image can be decoded on its own, the next one output is the one at mseconds
+        videoState->sequenceNext = FFMIN(FFMAX(pts, 0), videoState->sequence->count - 1);
+        drop_primed(videoState);
+        return 0;
+    }
+    TRACE_BEGIN("seek", videoState, mseconds);
     ret = av_seek_frame(videoState->pFormatContext, videoState->videoIndex, pts, flags);
+    TRACE_END("seek", videoState, ret);
     if (ret < 0){
         return -1;
     }
     avcodec_flush_buffers(videoState->pCodecContext);
+    flush_tracks(videoState);
+    filter_reset(videoState->filter);
+    if (videoState->analysis != NULL) {
+        analysis_reset(videoState->analysis);
+    }
+    videoState->nextOutputPts = AV_NOPTS_VALUE;
+    videoState->trickPts = AV_NOPTS_VALUE;
+    loop_seeked(videoState);
+    // the packets before and after a seek aren't a GOP apart
+    videoState->lastKeyPts = AV_NOPTS_VALUE;
+    drop_primed(videoState);
     return 0;
 }
 
 static int catchUp(void* videoStateV, int pts){
     VideoState* videoState = (VideoState*) videoStateV;
     int64_t ret = 0;
+    // a precise seek has to decode the frames the output rate discards
+    enum AVDiscard discard = videoState->pCodecContext->skip_frame;
+    videoState->pCodecContext->skip_frame = AVDISCARD_DEFAULT;
+    videoState->nextOutputPts = AV_NOPTS_VALUE;
     while (ret >= 0) {
-        ret = decode_frame(videoState);
+        ret = next_frame(videoState);
         if (calculateSyncMini(videoState, ret) >= pts - 0.5*videoState->last_pts_delay) {
+            frame_due(videoState, videoState->Dframe->pts);
+            videoState->pCodecContext->skip_frame = discard;
             return rescale_frame(videoState, videoState->Dframe, ret);
         }
         av_frame_unref(videoState->Dframe);
         freeNativeFrame(videoStateV);
     }
+    videoState->pCodecContext->skip_frame = discard;
     return ret;
 }
 
 FFI_EXPORT int seek_precise(void* videoStateV, int64_t pts, int backward){
     VideoState* videoState = (VideoState*) videoStateV;
+    int ret;
+    placement_bind(&videoState->placement, videoState);
+    if (videoState->sequence != NULL) {
+        videoState->sequenceNext = FFMAX(pts, 0);
+        return sequence_frame(videoState);
+    }
     if (backward) {
-        int ret;
+        TRACE_BEGIN("seek", videoState, pts);
         ret = av_seek_frame(videoState->pFormatContext, videoState->videoIndex, pts, AVSEEK_FLAG_BACKWARD);
+        TRACE_END("seek", videoState, ret);
         if (ret < 0){
             return -1;
         }
         avcodec_flush_buffers(videoState->pCodecContext);
+        flush_tracks(videoState);
+        filter_reset(videoState->filter);
+        if (videoState->analysis != NULL) {
+            analysis_reset(videoState->analysis);
+        }
+        videoState->lastKeyPts = AV_NOPTS_VALUE;
     }
-    return catchUp(videoStateV,pts);
+    videoState->trickPts = AV_NOPTS_VALUE;
+    loop_seeked(videoState);
+    TRACE_BEGIN("catch up", videoState, pts);
+    ret = catchUp(videoStateV,pts);
+    TRACE_END("catch up", videoState, ret);
+    return ret;
 }
 
 FFI_EXPORT int64_t findEOF(VideoState* videoState){
+    if (videoState->sequence != NULL) {
+        AVRational thou;
+        thou.num = 1;
+        thou.den = 1000;
+        return av_rescale_q(videoState->sequence->count - 1, videoState->time_base, thou);
+    }
     int ret = av_seek_frame(videoState->pFormatContext,
                             videoState->videoIndex,
                             av_rescale_q(videoState->pFormatContext->duration, AV_TIME_BASE_Q, videoState->time_base),
@@ -404,6 +2252,8 @@ FFI_EXPORT int64_t findEOF(VideoState* videoState){
         return -1;
     }
     avcodec_flush_buffers(videoState->pCodecContext);
+    flush_tracks(videoState);
+    filter_reset(videoState->filter);
     while (ret >= 0) {
         ret = decode_frame(videoState);
         if (ret == -2) {
@@ -423,42 +2273,69 @@ FFI_EXPORT int64_t findEOF(VideoState* videoState){
 
 FFI_EXPORT void disposeVideo(void* videoStateV){
     VideoState* videoState = (VideoState*) videoStateV;
+    if (videoState->primed) {
+        videoState->pPlayerFrame->inUse = 0;
+    }
     while (videoState->pPlayerFrame->inUse) {
         av_usleep(1000);
     }
+    for (int i = 0; i < videoState->numRenditions; i++) {
+        free_rendition(videoState->renditions[i]);
+    }
+    for (int i = 0; i < videoState->numTracks; i++) {
+        free_track(videoState->tracks[i]);
+    }
+    clearLoop(videoState);
+    detachTexture(videoState);
+    filter_free(&videoState->filter);
+    sequence_close(&videoState->sequence);
+    disableFrameServer(videoState);
     lock(&videoState->pPlayerFrame->mutex);
+    // without a scaler the output frame is Dframe itself and must only be freed once
+    if (videoState->pPlayerFrame->pFrame == videoState->Dframe) {
+        videoState->pPlayerFrame->pFrame = NULL;
+    }
     av_frame_free(&videoState->Dframe);
     av_free(videoState->Dframe);
+    av_frame_free(&videoState->lastFrame);
     av_packet_free(&videoState->Dpacket);
     av_free(videoState->Dpacket);
     avformat_close_input(&videoState->pFormatContext);
+    http_close(&videoState->http);
     avformat_free_context(videoState->pFormatContext);
     av_free(videoState->pFormatContext);
     avcodec_free_context(&videoState->pCodecContext);
     av_free(videoState->pCodecContext);
     destroy_lock(&videoState->mutex);
+    if (videoState->sws_context != NULL && videoState->pPlayerFrame->pFrame != NULL) {
+        av_freep(&videoState->pPlayerFrame->pFrame->data[0]);
+    }
     av_frame_free(&videoState->pPlayerFrame->pFrame);
     av_free(videoState->pPlayerFrame->pFrame);
     unlock(&videoState->pPlayerFrame->mutex);
     destroy_lock(&videoState->pPlayerFrame->mutex);
     av_free(videoState->pPlayerFrame);
     sws_freeContext(videoState->sws_context);
+    analysis_free(&videoState->analysis);
+    tensor_free(&videoState->tensor);
+    if (videoState->proxy != NULL) {
+        disposeVideo(videoState->proxy);
+    }
+    governor_unregister(&videoState->account);
     av_free(videoState);
 }
 
-FFI_EXPORT ReadyFrame retrieveFrame(void* videoStateV) {
-    VideoState* videoState = (VideoState*) videoStateV;
-    PlayerFrame* pPlayerFrame = videoState->pPlayerFrame;
-    int formatSet = 0;
+static ReadyFrame ready_frame(VideoState* videoState, PlayerFrame* pPlayerFrame, int format) {
     ReadyFrame readyFrame;
     if (lock(&pPlayerFrame->mutex) < 0) {
         readyFrame.exists = -1;
         return readyFrame;
     }
     readyFrame.size = pPlayerFrame->size;
-    readyFrame.width = pPlayerFrame->width;
-    readyFrame.height = pPlayerFrame->height;
-    readyFrame.data = pPlayerFrame->pFrame->data[0];
+    // the converted picture can be smaller than requested while the memory governor shrinks it
+    readyFrame.width = pPlayerFrame->pFrame != NULL ? pPlayerFrame->pFrame->width : pPlayerFrame->width;
+    readyFrame.height = pPlayerFrame->pFrame != NULL ? pPlayerFrame->pFrame->height : pPlayerFrame->height;
+    readyFrame.data = pPlayerFrame->pFrame != NULL ? pPlayerFrame->pFrame->data[0] : NULL;
     readyFrame.pts = pPlayerFrame->pts;
     readyFrame.delay = pPlayerFrame->delay;
     AVRational thou;
@@ -467,17 +2344,194 @@ FFI_EXPORT ReadyFrame retrieveFrame(void* videoStateV) {
     readyFrame.dts = videoState->last_dts;
     readyFrame.dtsProgress = av_rescale_q(videoState->last_dts, videoState->time_base, thou);
     readyFrame.progress = av_rescale_q(pPlayerFrame->pts, videoState->time_base, thou);
-    readyFrame.format = videoState->format;
-    if (unlock(&videoState->pPlayerFrame->mutex) < 0) {
+    readyFrame.format = format;
+    readyFrame.stride = pPlayerFrame->pFrame != NULL ? pPlayerFrame->pFrame->linesize[0] : 0;
+    readyFrame.chromaStride = pPlayerFrame->pFrame != NULL ? pPlayerFrame->pFrame->linesize[1] : 0;
+    readyFrame.exists = 1;
+    if (unlock(&pPlayerFrame->mutex) < 0) {
+        readyFrame.exists = -1;
+        return readyFrame;
+    }
+    return readyFrame;
+}
+
+FFI_EXPORT ReadyFrame retrieveFrame(void* videoStateV) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    TRACE_MARK("retrieve", videoState, videoState->pPlayerFrame->pts);
+    return ready_frame(videoState, videoState->pPlayerFrame, videoState->format);
+}
+
+FFI_EXPORT ReadyFrame retrieveRendition(void* videoStateV, int rendition) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    PlayerFrame* pPlayerFrame = rendition_frame(videoState, rendition);
+    ReadyFrame readyFrame;
+    if (pPlayerFrame == NULL) {
         readyFrame.exists = -1;
         return readyFrame;
     }
+    if (rendition == 0) {
+        return retrieveFrame(videoStateV);
+    }
+    readyFrame = ready_frame(videoState, pPlayerFrame, videoState->renditions[rendition - 1]->format);
+    // the rendition skipped the last frame, so there is nothing new to deliver
+    if (readyFrame.exists == 1 && !pPlayerFrame->inUse) {
+        readyFrame.exists = 0;
+    }
     return readyFrame;
 }
 
 FFI_EXPORT void freeNativeFrame(void* videoStateV){
     VideoState* videoState = (VideoState*) videoStateV;
+    TRACE_MARK("release", videoState, videoState->pPlayerFrame->pts);
     lock(&videoState->pPlayerFrame->mutex);
     videoState->pPlayerFrame->inUse = 0;
     unlock(&videoState->pPlayerFrame->mutex);
-}
\ No newline at end of file
+}
+
+FFI_EXPORT void freeRendition(void* videoStateV, int rendition) {
+    PlayerFrame* pPlayerFrame = rendition_frame((VideoState*) videoStateV, rendition);
+    if (pPlayerFrame == NULL) {
+        return;
+    }
+    lock(&pPlayerFrame->mutex);
+    pPlayerFrame->inUse = 0;
+    unlock(&pPlayerFrame->mutex);
+}
+
+// Whether streamIndex is a video stream that isn't decoded yet.
+static int available_stream(VideoState* videoState, int streamIndex) {
+    AVFormatContext* pFormatContext = videoState->pFormatContext;
+    if (streamIndex < 0 || streamIndex >= (int)pFormatContext->nb_streams || streamIndex == videoState->videoIndex
+            || find_track(videoState, streamIndex) != NULL) {
+        return 0;
+    }
+    return pFormatContext->streams[streamIndex]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO
+        && !(pFormatContext->streams[streamIndex]->disposition & AV_DISPOSITION_ATTACHED_PIC);
+}
+
+// Decodes the video stream at streamIndex from the same demuxer as the main one, for multi-angle files.
+// A negative streamIndex picks the best video stream that isn't decoded yet.
+// Has to be called before the first frame is decoded. Returns the number of the track, starting at 1, or -1.
+FFI_EXPORT int addTrack(void* videoStateV, int streamIndex, int pxl, int width, int height) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    AVFormatContext* pFormatContext = videoState->pFormatContext;
+    const AVCodec* pCodec;
+    AVStream* stream;
+    Track* track;
+    if (videoState->numTracks >= MAX_TRACKS || pxl < 0 || pxl >= UNKOWN_FORMAT) {
+        return -1;
+    }
+    if (streamIndex < 0) {
+        streamIndex = av_find_best_stream(pFormatContext, AVMEDIA_TYPE_VIDEO, -1, videoState->videoIndex, NULL, 0);
+        // the best stream is usually the main one
+        for (unsigned int i = 0; !available_stream(videoState, streamIndex) && i < pFormatContext->nb_streams; i++) {
+            streamIndex = i;
+        }
+    }
+    if (!available_stream(videoState, streamIndex)) {
+        fprintf(stderr, "Could not find video stream\n");
+        return -1;
+    }
+    stream = pFormatContext->streams[streamIndex];
+    pCodec = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (pCodec == NULL) {
+        fprintf(stderr, "Codec isn't supported\n");
+        return -1;
+    }
+    track = av_mallocz(sizeof(Track));
+    if (track == NULL) {
+        return -1;
+    }
+    track->pPlayerFrame = av_mallocz(sizeof(PlayerFrame));
+    if (track->pPlayerFrame == NULL) {
+        free_track(track);
+        return -1;
+    }
+    init_lock(&track->pPlayerFrame->mutex);
+    track->pCodecContext = avcodec_alloc_context3(pCodec);
+    if (track->pCodecContext == NULL || avcodec_parameters_to_context(track->pCodecContext, stream->codecpar) < 0) {
+        fprintf(stderr, "Failed while copying params\n");
+        free_track(track);
+        return -1;
+    }
+    track->pCodecContext->pkt_timebase = stream->time_base;
+    if (avcodec_open2(track->pCodecContext, pCodec, NULL) != 0) {
+        fprintf(stderr, "Failed on open_codec2\n");
+        free_track(track);
+        return -1;
+    }
+    track->decoded = av_frame_alloc();
+    for (int i = 0; i < TRACK_QUEUE; i++) {
+        track->queue[i] = av_frame_alloc();
+        if (track->queue[i] == NULL) {
+            free_track(track);
+            return -1;
+        }
+    }
+    if (track->decoded == NULL) {
+        free_track(track);
+        return -1;
+    }
+    if (width == 0 || height == 0) {
+        track->pPlayerFrame->width = track->pCodecContext->width;
+        track->pPlayerFrame->height = track->pCodecContext->height;
+    }
+    else {
+        track->pPlayerFrame->width = width;
+        track->pPlayerFrame->height = height;
+    }
+    track->streamIndex = streamIndex;
+    track->stream = stream;
+    track->format = pxl;
+    stream->discard = AVDISCARD_DEFAULT;
+    videoState->tracks[videoState->numTracks] = track;
+    return ++videoState->numTracks;
+}
+
+static Track* track_at(VideoState* videoState, int track) {
+    if (track < 1 || track > videoState->numTracks) {
+        return NULL;
+    }
+    return videoState->tracks[track - 1];
+}
+
+// Like retrieveRendition(), with the pts of the track's frame in the main stream's time base.
+FFI_EXPORT ReadyFrame retrieveTrack(void* videoStateV, int track) {
+    VideoState* videoState = (VideoState*) videoStateV;
+    Track* pTrack = track_at(videoState, track);
+    ReadyFrame readyFrame;
+    if (pTrack == NULL) {
+        readyFrame.exists = -1;
+        return readyFrame;
+    }
+    readyFrame = ready_frame(videoState, pTrack->pPlayerFrame, pTrack->format);
+    // no frame of the track was due since the last one was released
+    if (readyFrame.exists == 1 && !pTrack->pPlayerFrame->inUse) {
+        readyFrame.exists = 0;
+    }
+    return readyFrame;
+}
+
+// Same as the retrieve functions but written into a ReadyFrame the caller keeps,
+// so bindings that can't hold a returned struct without allocating reuse one for every frame.
+FFI_EXPORT void retrieveFrameInto(void* videoStateV, ReadyFrame* frame) {
+    *frame = retrieveFrame(videoStateV);
+}
+
+FFI_EXPORT void retrieveRenditionInto(void* videoStateV, int rendition, ReadyFrame* frame) {
+    *frame = retrieveRendition(videoStateV, rendition);
+}
+
+FFI_EXPORT void retrieveTrackInto(void* videoStateV, int track, ReadyFrame* frame) {
+    *frame = retrieveTrack(videoStateV, track);
+}
+
+FFI_EXPORT void freeTrack(void* videoStateV, int track) {
+    Track* pTrack = track_at((VideoState*) videoStateV, track);
+    if (pTrack == NULL) {
+        return;
+    }
+    lock(&pTrack->pPlayerFrame->mutex);
+    pTrack->pPlayerFrame->inUse = 0;
+    unlock(&pTrack->pPlayerFrame->mutex);
+}
@@ -24,42 +24,40 @@
 #include <libavutil/time.h>
 #include <libavutil/imgutils.h>
 #include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/cpu.h>
+#include <libavutil/avstring.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <math.h>
-#ifdef _WIN32
-#include <windows.h>
-#else
-#include <pthread.h>
-#endif
+#include "threads.h"
+#include "analysis.h"
+#include "fingerprint.h"
+#include "snapshot.h"
+#include "governor.h"
+#include "tensor.h"
+#include "http.h"
+#include "trace.h"
+#include "sink.h"
+#include "texture.h"
+#include "placement.h"
+#include "filter.h"
+#include "sequence.h"
+#include "frameserver.h"
 
+#ifndef FFI_EXPORT
 #if _WIN32
 #define FFI_EXPORT __declspec(dllexport)
 #else
 #define FFI_EXPORT
 #endif
+#endif
 
-#define UNKOWN_FORMAT 7
+#define UNKOWN_FORMAT 12
 
-enum formats {
-    formatRGBA,
-    formatBGRA,
-    formatARGB,
-    formatABGR,
-    formatYUV420P,
-    formatGRAY8A,
-    formatGRAY16LE
-};
-
-const int fmt[] = {
-    AV_PIX_FMT_RGBA,
-    AV_PIX_FMT_BGRA,
-    AV_PIX_FMT_ARGB,
-    AV_PIX_FMT_ABGR,
-    AV_PIX_FMT_YUV420P,
-    AV_PIX_FMT_GRAY8A,
-    AV_PIX_FMT_GRAY16LE
-};
+// AVPixelFormat of every value of enum formats, defined in navigator.c
+extern const int fmt[UNKOWN_FORMAT];
 
 typedef struct {
     int size;
@@ -73,6 +71,9 @@ typedef struct {
     int64_t dtsProgress;
     int64_t progress; // in milliseconds
     int exists;
+    // bytes per row of the first plane and of the chroma planes, which follow it in data
+    int stride;
+    int chromaStride;
 } ReadyFrame;
 
 typedef struct {
@@ -92,15 +93,122 @@ typedef struct {
     int width;
     int64_t pts;
     int64_t delay;
-    #ifdef _WIN32
-    HANDLE mutex;
-    #else
-    pthread_mutex_t mutex;
-    #endif
+    // source the sws context of this output was made for, it is only looked up again when that changes
+    int scaledWidth;
+    int scaledHeight;
+    int scaledFormat;
+    // heap allocations made for this output, they stop once its sizes are settled
+    int64_t allocations;
+    Mutex mutex;
 } PlayerFrame;
 
+enum playerStates {
+    statePlaying,
+    statePaused,
+    stateEnded
+};
+
+// Status of a VideoState that readers poll instead of receiving a message per frame.
+// Written under a sequence lock: sequence is odd while an update is in progress.
+typedef struct {
+    int64_t sequence;
+    int64_t pts;
+    int64_t dts;
+    int64_t progress;       // in milliseconds
+    int64_t dtsProgress;    // in milliseconds
+    int64_t delay;
+    int64_t frames;         // frames handed to the output
+    int64_t dropped;        // frames decoded but not delivered to every output
+    int64_t state;          // one of playerStates
+    int64_t allocations;    // heap allocations of the playback path, constant in steady playback
+} PlayerStatus;
+
+// Probing limits of openVideoFast(), in bytes and microseconds
+#define FAST_START_PROBESIZE "65536"
+#define FAST_START_ANALYZEDURATION "100000"
+
+// Trick-play: up to this speed every frame is decoded, above it frames are dropped at the codec
+#define TRICK_MIN_SPEED 2.0
+// Trick-play speeds are clamped to this many times the normal speed, forward or backward
+#define TRICK_MAX_SPEED 64.0
+// Forward trick-play seeks from keyframe to keyframe once the output interval spans this many GOPs
+#define TRICK_SEEK_GOPS 2
+// Backward seeks tried before reverse trick-play gives up on finding an earlier keyframe
+#define TRICK_REVERSE_ATTEMPTS 4
+// Returned by make_frame() when reverse trick-play has reached the first keyframe
+#define REACHED_START -3
+
+#define MAX_RENDITIONS 8
+
+// The decoded frame shared by all the renditions while it is being converted.
+typedef struct RenditionJob {
+    AVFrame* pFrame;
+    enum AVPixelFormat srcFormat;
+    const uint8_t* srcData[4];
+    int srcWidth;
+    int srcHeight;
+    int64_t pts;
+    int64_t delay;
+    // halvings of the output asked for by the memory governor
+    int shift;
+} RenditionJob;
+
+// An additional output of a VideoState, converted from the same decoded frame as the main one.
+typedef struct {
+    PlayerFrame* pPlayerFrame;
+    struct SwsContext* sws_context;
+    int format;
+    const struct RenditionJob* job;
+    // the VideoState it belongs to, only used to group trace events
+    const void* owner;
+    const ThreadPlacement* placement;
+    Thread worker;
+    Semaphore start;
+    Semaphore done;
+    int quit;
+    // frames skipped because the previous one hadn't been released, guarded by the frame mutex
+    int64_t skipped;
+} Rendition;
+
+#define MAX_TRACKS 8
+#define TRACK_QUEUE 8
+
+// Another video stream of the same file, decoded from the packets read for the main one
+// and presented at the main stream's pts.
 typedef struct {
+    int streamIndex;
+    AVStream* stream;
+    AVCodecContext* pCodecContext;
+    AVFrame* decoded;
+    // decoded frames waiting for the main stream to reach their pts, oldest first
+    AVFrame* queue[TRACK_QUEUE];
+    int queued;
+    PlayerFrame* pPlayerFrame;
+    struct SwsContext* sws_context;
+    int format;
+    // frames never presented because a newer one was due or the queue was full
+    int64_t skipped;
+} Track;
+
+// Frames of an A-B loop, decoded once and then replayed from memory.
+// They are references to the decoded pictures, which are smaller than converted ones and still feed every output.
+typedef struct {
+    int64_t start;          // stream time base
+    int64_t end;
+    int64_t budget;         // bytes the cached frames may take
+    int64_t bytes;
+    AVFrame** frames;
+    int count;
+    int capacity;
+    int position;           // next frame replayed from the cache, -1 while decoding
+    int complete;           // every frame from start to end is cached
+    int streaming;          // the range didn't fit, every wrap seeks back to start
+} LoopCache;
+
+typedef struct VideoState {
     AVFormatContext * pFormatContext;
+    // reads http:// sources through the block cache, NULL for everything else
+    HttpSource* http;
     int videoIndex;
     AVStream* videoStream;
     AVCodecContext* pCodecContext;
@@ -118,23 +226,146 @@ typedef struct {
     int width;
     int height;
 
-    #ifdef _WIN32
-    HANDLE mutex;
-    #else
-    pthread_mutex_t mutex;
-    #endif
+    // region of interest in source pixels, disabled while roiWidth or roiHeight is 0
+    int roiX;
+    int roiY;
+    int roiWidth;
+    int roiHeight;
+
+    Rendition* renditions[MAX_RENDITIONS];
+    int numRenditions;
+    RenditionJob renditionJob;
+
+    Track* tracks[MAX_TRACKS];
+    int numTracks;
+
+    LoopCache* loop;
+
+    // where the threads decoding and converting for this video run
+    ThreadPlacement placement;
+
+    // filter graph between the decoder and the outputs, NULL when the video was opened without one
+    VideoFilter* filter;
+    // the output takes the size the filters make of the picture, until resize() sets one
+    int filterSized;
+
+    // numbered images decoded in place of the stream, NULL for videos
+    ImageSequence* sequence;
+    // index of the image make_frame() outputs next
+    int64_t sequenceNext;
+
+    Analysis* analysis;
+
+    // planar copy of every output frame for inference, NULL while disabled
+    Tensor* tensor;
+
+    // RGBA frames drawn by a texture of the embedder, NULL while none is attached
+    TextureOutput* texture;
+
+    // shared memory the converted frames are published into for other processes, NULL while disabled
+    FrameServer* frameServer;
+
+    // all-intra copy of the source shown while scrubbing, NULL when none is attached
+    struct VideoState* proxy;
+
+    MemoryAccount* account;
+
+    // av_gettime_relative() when the open started and when the first frame was converted
+    int64_t openTime;
+    int64_t firstFrameTime;
+    // the first frame was converted by openVideoFast() and make_frame() hasn't returned it yet
+    int primed;
+
+    PlayerStatus status;
+
+    // fixed output rate in stream time base, 0 converts every frame
+    int64_t outputInterval;
+    int64_t nextOutputPts;
+    // longest distance between two keyframes seen so far
+    int64_t keyInterval;
+    int64_t lastKeyPts;
+    // trick-play speed set with setTrickSpeed(), negative plays backwards
+    double trickSpeed;
+    // stream time base between two frames of trick-play, 0 when every frame is output
+    int64_t trickInterval;
+    // last frame output by reverse trick-play, AV_NOPTS_VALUE after a seek
+    int64_t trickPts;
+
+    Mutex mutex;
     // decoder block
     AVPacket* Dpacket;
     AVFrame* Dframe;
+    // reference to the last frame handed to the outputs, guarded by mutex
+    AVFrame* lastFrame;
 
 } VideoState;
 
+typedef struct {
+    char** paths;
+    char** indexPaths;
+    int count;
+    int64_t intervalMs;
+    int keyframesOnly;
+    int minDistance;
+    int* results;
+    int next;
+    Mutex mutex;
+} FingerprintBatch;
+
+typedef struct {
+    int64_t mseconds;
+    int index;
+} SnapshotRequest;
+
+typedef struct {
+    char* path;
+    char** outputPaths;
+    SnapshotRequest* requests;
+    int count;
+    int format;
+    int quality;
+    int* results;
+    int chunks;
+    int nextChunk;
+    Mutex mutex;
+} SnapshotBatch;
+
 FFI_EXPORT void* openVideo(char* path, int pxl, int width, int height);
 
+FFI_EXPORT void* openVideoFast(char* path, int pxl, int width, int height);
+
+FFI_EXPORT void* openVideoFiltered(char* path, int pxl, int width, int height, char* filters, int rotate, int threads, int fastStart);
+
+FFI_EXPORT void* openSequence(char* pattern, int rateNum, int rateDen, int pxl, int width, int height, int threads, int readAhead);
+
+FFI_EXPORT int64_t timeToFirstFrame(void* videoStateV);
+
+FFI_EXPORT Metadata videoMetadata(void* videoStateV);
+
+FFI_EXPORT void setOutputRate(void* videoStateV, int num, int den);
+
+FFI_EXPORT void setTrickSpeed(void* videoStateV, double speed);
+
+FFI_EXPORT int setLoop(void* videoStateV, int64_t startMs, int64_t endMs, int64_t budget);
+
+FFI_EXPORT int clearLoop(void* videoStateV);
+
+FFI_EXPORT PlayerStatus* statusBlock(void* videoStateV);
+
+FFI_EXPORT void readStatus(void* videoStateV, PlayerStatus* status);
+
+FFI_EXPORT void setPlayerState(void* videoStateV, int state);
+
 FFI_EXPORT int make_frame(void* videoStateV);
 
 FFI_EXPORT ReadyFrame retrieveFrame(void* videoStateV);
 
+FFI_EXPORT void retrieveFrameInto(void* videoStateV, ReadyFrame* frame);
+
+FFI_EXPORT void retrieveRenditionInto(void* videoStateV, int rendition, ReadyFrame* frame);
+
+FFI_EXPORT void retrieveTrackInto(void* videoStateV, int track, ReadyFrame* frame);
+
 FFI_EXPORT void freeNativeFrame(void* videoStateV);
 
 FFI_EXPORT void disposeVideo(void* videoStateV);
@@ -149,6 +380,64 @@ FFI_EXPORT Metadata getMetadata(char* path);
 
 FFI_EXPORT void resize(void* videoStateV, int width, int height);
 
+FFI_EXPORT int addRendition(void* videoStateV, int pxl, int width, int height);
+
+FFI_EXPORT void resizeRendition(void* videoStateV, int rendition, int width, int height);
+
+FFI_EXPORT ReadyFrame retrieveRendition(void* videoStateV, int rendition);
+
+FFI_EXPORT void freeRendition(void* videoStateV, int rendition);
+
+FFI_EXPORT int addTrack(void* videoStateV, int streamIndex, int pxl, int width, int height);
+
+FFI_EXPORT ReadyFrame retrieveTrack(void* videoStateV, int track);
+
+FFI_EXPORT void freeTrack(void* videoStateV, int track);
+
+FFI_EXPORT int enableAnalysis(void* videoStateV, int step, double cutThreshold);
+
+FFI_EXPORT void disableAnalysis(void* videoStateV);
+
+FFI_EXPORT int readAnalysisEvents(void* videoStateV, AnalysisEvent* events, int max);
+
+FFI_EXPORT int analyze_frames(void* videoStateV, int count);
+
+FFI_EXPORT int enableTensor(void* videoStateV, int width, int height, int type, int resize, float* mean, float* std, float pad, int batch);
+
+FFI_EXPORT ReadyFrame retrieveTensor(void* videoStateV);
+
+FFI_EXPORT void freeTensor(void* videoStateV);
+
+FFI_EXPORT int fingerprintVideo(char* path, char* indexPath, int64_t intervalMs, int keyframesOnly, int minDistance);
+
+FFI_EXPORT int fingerprintBatch(char** paths, char** indexPaths, int count, int64_t intervalMs, int keyframesOnly, int minDistance, int threads, int* results);
+
+FFI_EXPORT int encodeSnapshot(void* videoStateV, int format, int quality, uint8_t** data);
+
+FFI_EXPORT void freeSnapshot(uint8_t* data);
+
+FFI_EXPORT int saveFrameAt(char* path, int64_t mseconds, char* outputPath, int format, int quality);
+
+FFI_EXPORT int saveFramesAt(char* path, int64_t* mseconds, char** outputPaths, int count, int format, int quality, int threads, int* results);
+
+FFI_EXPORT int64_t exportFrames(char* path, char* outputPath, int fd, int container, int pxl, int width, int height);
+
+FFI_EXPORT void setRegion(void* videoStateV, int x, int y, int width, int height, int outWidth, int outHeight);
+
+FFI_EXPORT int attachProxy(void* videoStateV, char* path);
+
+FFI_EXPORT MemoryUsage memoryUsage(void* videoStateV);
+
+FFI_EXPORT int enableFrameServer(void* videoStateV, char* name, int slots, int policy);
+
+FFI_EXPORT void disableFrameServer(void* videoStateV);
+
+FFI_EXPORT void setBackground(void* videoStateV, int background);
+
+FFI_EXPORT void setThreadPlacement(void* videoStateV, uint64_t cpus, int nice, int realtime);
+
+FFI_EXPORT void* proxyState(void* videoStateV);
+
 FFI_EXPORT int seek_time(void* videoStateV, int64_t mseconds, int backward);
 
 FFI_EXPORT int seek_precise(void* videoStateV, int64_t pts, int backward);
@@ -0,0 +1,190 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+// pthread_setname_np() and the CPU set macros
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "placement.h"
+#include <stdio.h>
+#include <string.h>
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+static Once placementOnce = ONCE_INIT;
+static Mutex placementMutex;
+static ThreadPlacement defaultPlacement;
+#if defined(__linux__)
+static cpu_set_t startCpus;
+#elif defined(_WIN32)
+static DWORD_PTR startCpus;
+#endif
+
+// what placement_bind() last applied to this thread
+static THREAD_LOCAL const void* boundOwner = NULL;
+static THREAD_LOCAL int64_t boundGeneration = -1;
+static THREAD_LOCAL int threadPlaced = 0;
+
+static void init_placement(void) {
+    init_lock(&placementMutex);
+#if defined(__linux__)
+    if (sched_getaffinity(0, sizeof(startCpus), &startCpus) != 0) {
+        CPU_ZERO(&startCpus);
+    }
+#elif defined(_WIN32)
+    DWORD_PTR systemCpus;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &startCpus, &systemCpus)) {
+        startCpus = 0;
+    }
+#endif
+}
+
+static int is_default(const ThreadPlacement* placement) {
+    return placement->cpus == 0 && placement->nice == 0 && placement->realtime == 0;
+}
+
+void placement_name(const char* name) {
+    char shortName[16];
+    snprintf(shortName, sizeof(shortName), "%s", name);
+#if defined(__linux__)
+    pthread_setname_np(pthread_self(), shortName);
+#elif defined(_WIN32)
+    // only there since Windows 10 1607
+    typedef HRESULT (WINAPI *SetThreadDescriptionFn)(HANDLE, PCWSTR);
+    SetThreadDescriptionFn setDescription = (SetThreadDescriptionFn)
+        GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "SetThreadDescription");
+    wchar_t wideName[16];
+    if (setDescription != NULL && MultiByteToWideChar(CP_UTF8, 0, shortName, -1, wideName, 16) > 0) {
+        setDescription(GetCurrentThread(), wideName);
+    }
+#endif
+}
+
+// Failures are reported and skipped, raising the priority usually needs privileges the process may not have
+void placement_apply(const ThreadPlacement* placement) {
+    run_once(&placementOnce, init_placement);
+#if defined(__linux__)
+    cpu_set_t cpus;
+    struct sched_param param;
+    if (placement->cpus != 0) {
+        CPU_ZERO(&cpus);
+        for (int i = 0; i < 64 && i < CPU_SETSIZE; i++) {
+            if (placement->cpus >> i & 1) {
+                CPU_SET(i, &cpus);
+            }
+        }
+    }
+    else {
+        cpus = startCpus;
+    }
+    if (CPU_COUNT(&cpus) > 0 && sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+        fprintf(stderr, "Could not set the CPU affinity\n");
+    }
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = placement->realtime;
+    if (pthread_setschedparam(pthread_self(), placement->realtime > 0 ? SCHED_FIFO : SCHED_OTHER, &param) != 0) {
+        fprintf(stderr, "Could not set the scheduling policy\n");
+    }
+    // the nice value is per thread on Linux
+    if (setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), placement->nice) != 0) {
+        fprintf(stderr, "Could not set the thread priority\n");
+    }
+#elif defined(_WIN32)
+    int priority = THREAD_PRIORITY_NORMAL;
+    DWORD_PTR cpus = placement->cpus != 0 ? (DWORD_PTR) placement->cpus : startCpus;
+    if (cpus != 0 && SetThreadAffinityMask(GetCurrentThread(), cpus) == 0) {
+        fprintf(stderr, "Could not set the CPU affinity\n");
+    }
+    if (placement->realtime > 0) {
+        priority = THREAD_PRIORITY_TIME_CRITICAL;
+    }
+    else if (placement->nice <= -15) {
+        priority = THREAD_PRIORITY_HIGHEST;
+    }
+    else if (placement->nice <= -5) {
+        priority = THREAD_PRIORITY_ABOVE_NORMAL;
+    }
+    else if (placement->nice >= 15) {
+        priority = THREAD_PRIORITY_LOWEST;
+    }
+    else if (placement->nice >= 5) {
+        priority = THREAD_PRIORITY_BELOW_NORMAL;
+    }
+    if (!SetThreadPriority(GetCurrentThread(), priority)) {
+        fprintf(stderr, "Could not set the thread priority\n");
+    }
+#endif
+}
+
+void placement_bind(const ThreadPlacement* placement, const void* owner) {
+    int64_t generation = load_acquire((volatile int64_t*) &placement->generation);
+    if (boundOwner == owner && boundGeneration == generation) {
+        return;
+    }
+    boundOwner = owner;
+    boundGeneration = generation;
+    // threads nobody placed are left alone, so the common case costs nothing
+    if (is_default(placement) && !threadPlaced) {
+        return;
+    }
+    placement_apply(placement);
+    threadPlaced = !is_default(placement);
+}
+
+void placement_bind_default(void) {
+    run_once(&placementOnce, init_placement);
+    placement_bind(&defaultPlacement, &defaultPlacement);
+}
+
+void placement_worker(const char* name) {
+    placement_name(name);
+    placement_bind_default();
+}
+
+void placement_set(ThreadPlacement* placement, uint64_t cpus, int nice, int realtime) {
+    placement->cpus = cpus;
+    placement->nice = nice < -20 ? -20 : nice > 19 ? 19 : nice;
+    placement->realtime = realtime < 0 ? 0 : realtime > 99 ? 99 : realtime;
+    store_release(&placement->generation, placement->generation + 1);
+}
+
+void placement_default(ThreadPlacement* placement) {
+    run_once(&placementOnce, init_placement);
+    lock(&placementMutex);
+    placement_set(placement, defaultPlacement.cpus, defaultPlacement.nice, defaultPlacement.realtime);
+    unlock(&placementMutex);
+}
+
+// Placement of the videos opened from now on and of the threads of batch jobs, snapshots and exports.
+// FFmpeg starts its codec threads from the thread that opens the codec, so they inherit it too.
+FFI_EXPORT void setDefaultPlacement(uint64_t cpus, int nice, int realtime) {
+    run_once(&placementOnce, init_placement);
+    lock(&placementMutex);
+    placement_set(&defaultPlacement, cpus, nice, realtime);
+    unlock(&placementMutex);
+}
@@ -0,0 +1,64 @@
+// This file is a part of videna.
+// Copyright (C) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+#include <stdint.h>
+#include "threads.h"
+
+#ifndef FFI_EXPORT
+#if _WIN32
+#define FFI_EXPORT __declspec(dllexport)
+#else
+#define FFI_EXPORT
+#endif
+#endif
+
+// Where the native threads working for a video run.
+// Threads apply it themselves the next time they pick up work after generation changed.
+typedef struct {
+    uint64_t cpus;      // bit i allows CPU i, 0 allows every CPU the process started with
+    int nice;           // -20 (highest) to 19, mapped onto thread priorities on Windows
+    int realtime;       // SCHED_FIFO priority from 1 to 99, 0 for the normal scheduler
+    volatile int64_t generation;
+} ThreadPlacement;
+
+// Names the calling thread for debuggers and profilers, names longer than 15 characters are cut
+void placement_name(const char* name);
+
+// Applies placement to the calling thread
+void placement_apply(const ThreadPlacement* placement);
+
+// Applies placement to the calling thread unless it already did for owner since the placement last changed.
+// Meant for threads videna doesn't own, like the one running the decode isolate, which other videos may share.
+void placement_bind(const ThreadPlacement* placement, const void* owner);
+
+// placement_bind() for the default placement, for work that doesn't belong to a video
+void placement_bind_default(void);
+
+// Names a thread videna started and gives it the default placement
+void placement_worker(const char* name);
+
+void placement_set(ThreadPlacement* placement, uint64_t cpus, int nice, int realtime);
+
+// Copy of the placement new videos and batch workers start with
+void placement_default(ThreadPlacement* placement);
+
+FFI_EXPORT void setDefaultPlacement(uint64_t cpus, int nice, int realtime);
+
+#endif
@@ -0,0 +1,275 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "proxy.h"
+#include "placement.h"
+#include <libavutil/mem.h>
+#include <stdio.h>
+
+typedef struct {
+    AVFormatContext* input;
+    AVFormatContext* output;
+    AVCodecContext* decoder;
+    AVCodecContext* encoder;
+    struct SwsContext* sws_context;
+    AVStream* inStream;
+    AVStream* outStream;
+    AVPacket* packet;
+    AVFrame* frame;
+    AVFrame* scaled;
+    int videoIndex;
+    int frames;
+} ProxyJob;
+
+static void close_proxy(ProxyJob* job) {
+    if (job->output != NULL) {
+        if (!(job->output->oformat->flags & AVFMT_NOFILE)) {
+            avio_closep(&job->output->pb);
+        }
+        avformat_free_context(job->output);
+        job->output = NULL;
+    }
+    avformat_close_input(&job->input);
+    avcodec_free_context(&job->decoder);
+    avcodec_free_context(&job->encoder);
+    sws_freeContext(job->sws_context);
+    job->sws_context = NULL;
+    av_packet_free(&job->packet);
+    av_frame_free(&job->frame);
+    av_frame_free(&job->scaled);
+}
+
+// Sends frame to the encoder (NULL flushes it) and writes every packet it returns.
+static int encode_proxy(ProxyJob* job, AVFrame* frame) {
+    int ret = avcodec_send_frame(job->encoder, frame);
+    while (ret >= 0) {
+        ret = avcodec_receive_packet(job->encoder, job->packet);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            return 0;
+        }
+        if (ret < 0) {
+            return -1;
+        }
+        av_packet_rescale_ts(job->packet, job->encoder->time_base, job->outStream->time_base);
+        job->packet->stream_index = job->outStream->index;
+        // takes ownership of the packet
+        if (av_interleaved_write_frame(job->output, job->packet) < 0) {
+            return -1;
+        }
+        job->frames++;
+    }
+    return ret;
+}
+
+// Receives every frame the decoder has ready, scales it down and encodes it keeping the source timestamp.
+static int decode_proxy(ProxyJob* job, AVPacket* packet) {
+    int ret = avcodec_send_packet(job->decoder, packet);
+    if (ret < 0 && ret != AVERROR_EOF) {
+        return -1;
+    }
+    for (;;) {
+        ret = avcodec_receive_frame(job->decoder, job->frame);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            return 0;
+        }
+        if (ret < 0) {
+            return -1;
+        }
+        if (job->frame->best_effort_timestamp == AV_NOPTS_VALUE) {
+            av_frame_unref(job->frame);
+            continue;
+        }
+        if (av_frame_make_writable(job->scaled) < 0) {
+            av_frame_unref(job->frame);
+            return -1;
+        }
+        sws_scale(job->sws_context, (const uint8_t * const*)job->frame->data,
+            job->frame->linesize, 0, job->frame->height,
+            (uint8_t* const*)job->scaled->data, job->scaled->linesize);
+        job->scaled->pts = job->frame->best_effort_timestamp;
+        job->scaled->quality = job->encoder->global_quality;
+        av_frame_unref(job->frame);
+        if (encode_proxy(job, job->scaled) < 0) {
+            return -1;
+        }
+    }
+}
+
+// Transcodes the video stream of path into an all-intra MJPEG proxy at outputPath, height pixels tall.
+// Every proxy frame keeps the timestamp of its source frame, so a time in milliseconds
+// means the same picture in both files and seeks in the proxy can be mapped back 1:1.
+// quality goes from 1 to 100.
+// Returns the number of frames written, or a negative value on failure.
+FFI_EXPORT int createProxy(char* path, char* outputPath, int height, int quality) {
+    ProxyJob job = {0};
+    const AVCodec* pDecoder = NULL;
+    const AVCodec* pEncoder;
+    AVCodecParameters* codecpar;
+    int width;
+    int ret;
+
+    // the frame threads of the codecs are started from this thread and inherit its placement
+    placement_bind_default();
+    if (avformat_open_input(&job.input, path, NULL, NULL) < 0) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return -1;
+    }
+    if (avformat_find_stream_info(job.input, NULL) < 0) {
+        close_proxy(&job);
+        return -1;
+    }
+    job.videoIndex = av_find_best_stream(job.input, AVMEDIA_TYPE_VIDEO, -1, -1, &pDecoder, 0);
+    if (job.videoIndex < 0 || pDecoder == NULL) {
+        fprintf(stderr, "Could not find video stream\n");
+        close_proxy(&job);
+        return -1;
+    }
+    job.inStream = job.input->streams[job.videoIndex];
+    codecpar = job.inStream->codecpar;
+    for (unsigned int i = 0; i < job.input->nb_streams; i++) {
+        if ((int)i != job.videoIndex) {
+            job.input->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    job.decoder = avcodec_alloc_context3(pDecoder);
+    if (job.decoder == NULL || avcodec_parameters_to_context(job.decoder, codecpar) < 0) {
+        close_proxy(&job);
+        return -1;
+    }
+    // the proxy is made in the background, so frame threads only cost memory and buy throughput
+    job.decoder->thread_count = 0;
+    job.decoder->pkt_timebase = job.inStream->time_base;
+    if (avcodec_open2(job.decoder, pDecoder, NULL) != 0) {
+        fprintf(stderr, "Failed on open_codec2\n");
+        close_proxy(&job);
+        return -1;
+    }
+
+    if (height <= 0 || height > job.decoder->height) {
+        height = job.decoder->height;
+    }
+    height &= ~1;
+    width = (int)av_rescale(job.decoder->width, height, job.decoder->height) & ~1;
+    if (width <= 0 || height <= 0) {
+        close_proxy(&job);
+        return -1;
+    }
+
+    pEncoder = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+    if (pEncoder == NULL) {
+        fprintf(stderr, "Image encoder isn't supported\n");
+        close_proxy(&job);
+        return -1;
+    }
+    job.encoder = avcodec_alloc_context3(pEncoder);
+    if (job.encoder == NULL) {
+        close_proxy(&job);
+        return -1;
+    }
+    quality = quality < 1 ? 1 : quality > 100 ? 100 : quality;
+    job.encoder->width = width;
+    job.encoder->height = height;
+    job.encoder->pix_fmt = AV_PIX_FMT_YUVJ420P;
+    job.encoder->color_range = AVCOL_RANGE_JPEG;
+    job.encoder->time_base = job.inStream->time_base;
+    job.encoder->sample_aspect_ratio = job.decoder->sample_aspect_ratio;
+    job.encoder->thread_count = 0;
+    // maps 1..100 onto the qscale range 31..2
+    job.encoder->flags |= AV_CODEC_FLAG_QSCALE;
+    job.encoder->global_quality = FF_QP2LAMBDA * (31 - (quality - 1) * 29 / 99);
+
+    if (avformat_alloc_output_context2(&job.output, NULL, NULL, outputPath) < 0 || job.output == NULL) {
+        fprintf(stderr, "Could not guess the container of %s\n", outputPath);
+        close_proxy(&job);
+        return -1;
+    }
+    if (job.output->oformat->flags & AVFMT_GLOBALHEADER) {
+        job.encoder->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+    if (avcodec_open2(job.encoder, pEncoder, NULL) != 0) {
+        fprintf(stderr, "Failed on open_codec2\n");
+        close_proxy(&job);
+        return -1;
+    }
+    job.outStream = avformat_new_stream(job.output, NULL);
+    if (job.outStream == NULL || avcodec_parameters_from_context(job.outStream->codecpar, job.encoder) < 0) {
+        close_proxy(&job);
+        return -1;
+    }
+    job.outStream->time_base = job.encoder->time_base;
+    job.outStream->sample_aspect_ratio = job.encoder->sample_aspect_ratio;
+
+    job.sws_context = sws_getContext(job.decoder->width,
+                        job.decoder->height,
+                        job.decoder->pix_fmt,
+                        width,
+                        height,
+                        AV_PIX_FMT_YUVJ420P,
+                        SWS_AREA,
+                        NULL,
+                        NULL,
+                        NULL
+                        );
+    job.packet = av_packet_alloc();
+    job.frame = av_frame_alloc();
+    job.scaled = av_frame_alloc();
+    if (job.sws_context == NULL || job.packet == NULL || job.frame == NULL || job.scaled == NULL) {
+        close_proxy(&job);
+        return -1;
+    }
+    job.scaled->format = AV_PIX_FMT_YUVJ420P;
+    job.scaled->width = width;
+    job.scaled->height = height;
+    if (av_frame_get_buffer(job.scaled, 0) < 0) {
+        close_proxy(&job);
+        return -1;
+    }
+
+    if (!(job.output->oformat->flags & AVFMT_NOFILE)) {
+        if (avio_open(&job.output->pb, outputPath, AVIO_FLAG_WRITE) < 0) {
+            fprintf(stderr, "Could not open %s\n", outputPath);
+            close_proxy(&job);
+            return -1;
+        }
+    }
+    if (avformat_write_header(job.output, NULL) < 0) {
+        close_proxy(&job);
+        return -1;
+    }
+
+    ret = 0;
+    while (ret >= 0 && av_read_frame(job.input, job.packet) >= 0) {
+        if (job.packet->stream_index == job.videoIndex) {
+            ret = decode_proxy(&job, job.packet);
+        }
+        av_packet_unref(job.packet);
+    }
+    if (ret >= 0) {
+        ret = decode_proxy(&job, NULL);
+    }
+    if (ret >= 0) {
+        ret = encode_proxy(&job, NULL);
+    }
+    if (ret < 0 || av_write_trailer(job.output) < 0) {
+        close_proxy(&job);
+        return -1;
+    }
+    ret = job.frames;
+    close_proxy(&job);
+    return ret;
+}
@@ -0,0 +1,373 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "sequence.h"
+#include "trace.h"
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/avstring.h>
+#include <libavutil/common.h>
+#include <libavutil/cpu.h>
+#include <libavutil/mem.h>
+#include <stdio.h>
+
+// Whether pattern has exactly one conversion and it prints an integer, like %d or %04d
+static int pattern_valid(const char* pattern) {
+    int conversions = 0;
+    for (const char* c = pattern; *c != '\0'; c++) {
+        if (*c != '%') {
+            continue;
+        }
+        c++;
+        if (*c == '%') {
+            continue;
+        }
+        while (*c >= '0' && *c <= '9') {
+            c++;
+        }
+        if (*c != 'd') {
+            return 0;
+        }
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+int sequence_path(const ImageSequence* sequence, int64_t index, char* path, size_t size) {
+    int ret = snprintf(path, size, sequence->pattern, (int) (sequence->first + index));
+    return ret < 0 || (size_t) ret >= size ? -1 : 0;
+}
+
+static int image_exists(const ImageSequence* sequence, int64_t index) {
+    char path[4096];
+    FILE* file;
+    if (sequence->first + index > INT32_MAX || sequence_path(sequence, index, path, sizeof(path)) < 0) {
+        return 0;
+    }
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+    fclose(file);
+    return 1;
+}
+
+// Images up to the first missing one, found in a logarithmic number of lookups
+static int64_t count_images(const ImageSequence* sequence) {
+    int64_t found = 0;
+    int64_t missing = 1;
+    while (image_exists(sequence, missing)) {
+        found = missing;
+        missing *= 2;
+    }
+    while (missing - found > 1) {
+        int64_t middle = found + (missing - found) / 2;
+        if (image_exists(sequence, middle)) {
+            found = middle;
+        }
+        else {
+            missing = middle;
+        }
+    }
+    return found + 1;
+}
+
+// Decodes the only picture of the image at path
+static int decode_image(const char* path, AVFrame* pFrame) {
+    AVFormatContext* pFormatContext = NULL;
+    AVCodecContext* pCodecContext = NULL;
+    const AVCodec* pCodec = NULL;
+    AVPacket* packet = NULL;
+    int stream;
+    int ret;
+
+    if (avformat_open_input(&pFormatContext, path, NULL, NULL) < 0) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return -1;
+    }
+    stream = av_find_best_stream(pFormatContext, AVMEDIA_TYPE_VIDEO, -1, -1, &pCodec, 0);
+    if (stream < 0 || pCodec == NULL) {
+        fprintf(stderr, "Codec isn't supported\n");
+        avformat_close_input(&pFormatContext);
+        return -1;
+    }
+    pCodecContext = avcodec_alloc_context3(pCodec);
+    packet = av_packet_alloc();
+    if (pCodecContext == NULL || packet == NULL
+            || avcodec_parameters_to_context(pCodecContext, pFormatContext->streams[stream]->codecpar) < 0) {
+        av_packet_free(&packet);
+        avcodec_free_context(&pCodecContext);
+        avformat_close_input(&pFormatContext);
+        return -1;
+    }
+    // the images are decoded in parallel, so each one gets a single thread
+    pCodecContext->thread_count = 1;
+    ret = avcodec_open2(pCodecContext, pCodec, NULL);
+    while (ret >= 0) {
+        ret = av_read_frame(pFormatContext, packet);
+        if (ret < 0 || packet->stream_index == stream) {
+            break;
+        }
+        av_packet_unref(packet);
+    }
+    if (ret >= 0) {
+        ret = avcodec_send_packet(pCodecContext, packet);
+        av_packet_unref(packet);
+    }
+    if (ret >= 0) {
+        ret = avcodec_send_packet(pCodecContext, NULL);
+    }
+    if (ret >= 0) {
+        ret = avcodec_receive_frame(pCodecContext, pFrame);
+    }
+    av_packet_free(&packet);
+    avcodec_free_context(&pCodecContext);
+    avformat_close_input(&pFormatContext);
+    return ret < 0 ? -1 : 0;
+}
+
+// Whether index is one of the images read ahead from current in the direction of step
+static int in_window(const ImageSequence* sequence, int64_t index, int64_t current, int step) {
+    int64_t distance = step < 0 ? current - index : index - current;
+    int64_t stride = FFABS(step);
+    return distance >= 0 && distance % stride == 0 && distance / stride <= sequence->readAhead;
+}
+
+// The slot holding index, or one taken for it from the images away from current.
+// Returns NULL when every slot is still needed.
+static SequenceSlot* request_slot(ImageSequence* sequence, int64_t index, int64_t current, int step) {
+    SequenceSlot* victim = NULL;
+    for (int i = 0; i < sequence->numSlots; i++) {
+        SequenceSlot* slot = &sequence->slots[i];
+        if (slot->state != slotEmpty && slot->index == index) {
+            return slot;
+        }
+    }
+    for (int i = 0; i < sequence->numSlots; i++) {
+        SequenceSlot* slot = &sequence->slots[i];
+        if (slot->state == slotEmpty) {
+            victim = slot;
+            break;
+        }
+        if (slot->state == slotPending || in_window(sequence, slot->index, current, step)) {
+            continue;
+        }
+        if (victim == NULL || llabs(slot->index - current) > llabs(victim->index - current)) {
+            victim = slot;
+        }
+    }
+    if (victim == NULL) {
+        return NULL;
+    }
+    av_frame_unref(victim->frame);
+    victim->index = index;
+    victim->state = slotWanted;
+    post_semaphore(&sequence->work);
+    return victim;
+}
+
+static void* sequence_worker(void* sequenceV) {
+    ImageSequence* sequence = (ImageSequence*) sequenceV;
+    AVFrame* decoded = av_frame_alloc();
+    char path[4096];
+    placement_worker("videna sequence");
+    for (;;) {
+        SequenceSlot* slot = NULL;
+        int64_t index;
+        int ret;
+        wait_semaphore(&sequence->work);
+        if (sequence->placement != NULL) {
+            placement_bind(sequence->placement, sequence);
+        }
+        lock(&sequence->mutex);
+        if (sequence->quit) {
+            unlock(&sequence->mutex);
+            break;
+        }
+        // the image closest to the output goes first
+        for (int i = 0; i < sequence->numSlots; i++) {
+            SequenceSlot* candidate = &sequence->slots[i];
+            if (candidate->state != slotWanted) {
+                continue;
+            }
+            if (slot == NULL || llabs(candidate->index - sequence->position) < llabs(slot->index - sequence->position)) {
+                slot = candidate;
+            }
+        }
+        if (slot == NULL) {
+            // cancelled by a seek
+            unlock(&sequence->mutex);
+            continue;
+        }
+        slot->state = slotPending;
+        index = slot->index;
+        ret = sequence_path(sequence, index, path, sizeof(path));
+        unlock(&sequence->mutex);
+
+        TRACE_BEGIN("sequence decode", NULL, index);
+        if (ret >= 0 && decoded != NULL) {
+            ret = decode_image(path, decoded);
+        }
+        else {
+            ret = -1;
+        }
+        TRACE_END("sequence decode", NULL, ret);
+
+        lock(&sequence->mutex);
+        if (ret >= 0) {
+            av_frame_move_ref(slot->frame, decoded);
+        }
+        slot->state = ret >= 0 ? slotReady : slotFailed;
+        if (sequence->waiting) {
+            sequence->waiting = 0;
+            post_semaphore(&sequence->done);
+        }
+        unlock(&sequence->mutex);
+    }
+    av_frame_free(&decoded);
+    return NULL;
+}
+
+// Sleeps until a worker finishes a slot, called and returning with the mutex held
+static void wait_slot(ImageSequence* sequence) {
+    sequence->waiting = 1;
+    unlock(&sequence->mutex);
+    wait_semaphore(&sequence->done);
+    lock(&sequence->mutex);
+}
+
+ImageSequence* sequence_open(const char* pattern, AVRational rate, int threads, int readAhead) {
+    ImageSequence* sequence;
+    if (pattern == NULL || !pattern_valid(pattern) || rate.num <= 0 || rate.den <= 0) {
+        fprintf(stderr, "Not an image sequence\n");
+        return NULL;
+    }
+    sequence = av_mallocz(sizeof(ImageSequence));
+    if (sequence == NULL) {
+        return NULL;
+    }
+    sequence->pattern = av_strdup(pattern);
+    if (sequence->pattern == NULL) {
+        av_free(sequence);
+        return NULL;
+    }
+    sequence->rate = rate;
+    sequence->first = -1;
+    for (int i = 0; i < SEQUENCE_FIRST_RANGE && sequence->first < 0; i++) {
+        sequence->first = i;
+        if (!image_exists(sequence, 0)) {
+            sequence->first = -1;
+        }
+    }
+    if (sequence->first < 0) {
+        fprintf(stderr, "No image matches %s\n", pattern);
+        av_free(sequence->pattern);
+        av_free(sequence);
+        return NULL;
+    }
+    sequence->count = count_images(sequence);
+
+    threads = threads > 0 ? threads : av_cpu_count();
+    threads = FFMIN(threads, SEQUENCE_MAX_WORKERS);
+    // the image being output and the one before it stay next to the ones read ahead
+    sequence->numSlots = FFMIN((readAhead > 0 ? readAhead : SEQUENCE_READ_AHEAD) + 2, SEQUENCE_MAX_SLOTS);
+    sequence->readAhead = sequence->numSlots - 2;
+    init_lock(&sequence->mutex);
+    init_semaphore(&sequence->work);
+    init_semaphore(&sequence->done);
+    for (int i = 0; i < sequence->numSlots; i++) {
+        sequence->slots[i].frame = av_frame_alloc();
+        if (sequence->slots[i].frame == NULL) {
+            sequence_close(&sequence);
+            return NULL;
+        }
+    }
+    for (int i = 0; i < threads; i++) {
+        if (start_thread(&sequence->workers[i], sequence_worker, sequence) < 0) {
+            break;
+        }
+        sequence->numWorkers++;
+    }
+    if (sequence->numWorkers == 0) {
+        sequence_close(&sequence);
+        return NULL;
+    }
+    return sequence;
+}
+
+int sequence_read(ImageSequence* sequence, int64_t index, int step, AVFrame* pFrame) {
+    SequenceSlot* slot;
+    int ret;
+    if (index < 0 || index >= sequence->count) {
+        return -2;
+    }
+    step = step != 0 ? step : 1;
+    lock(&sequence->mutex);
+    sequence->position = index;
+    // images the output moved away from aren't decoded anymore
+    for (int i = 0; i < sequence->numSlots; i++) {
+        SequenceSlot* other = &sequence->slots[i];
+        if (other->state == slotWanted && !in_window(sequence, other->index, index, step)) {
+            other->state = slotEmpty;
+        }
+    }
+    while ((slot = request_slot(sequence, index, index, step)) == NULL) {
+        // every slot is being decoded, one of them frees up soon
+        wait_slot(sequence);
+    }
+    for (int i = 1; i <= sequence->readAhead; i++) {
+        int64_t ahead = index + (int64_t) i * step;
+        if (ahead < 0 || ahead >= sequence->count || request_slot(sequence, ahead, index, step) == NULL) {
+            break;
+        }
+    }
+    while (slot->state == slotWanted || slot->state == slotPending) {
+        wait_slot(sequence);
+    }
+    if (slot->state == slotFailed) {
+        // dropped so the next read tries again
+        slot->state = slotEmpty;
+        unlock(&sequence->mutex);
+        return -1;
+    }
+    ret = av_frame_ref(pFrame, slot->frame);
+    unlock(&sequence->mutex);
+    return ret < 0 ? -1 : 0;
+}
+
+void sequence_close(ImageSequence** sequence) {
+    if (*sequence == NULL) {
+        return;
+    }
+    lock(&(*sequence)->mutex);
+    (*sequence)->quit = 1;
+    unlock(&(*sequence)->mutex);
+    for (int i = 0; i < (*sequence)->numWorkers; i++) {
+        post_semaphore(&(*sequence)->work);
+    }
+    for (int i = 0; i < (*sequence)->numWorkers; i++) {
+        join_thread(&(*sequence)->workers[i]);
+    }
+    for (int i = 0; i < (*sequence)->numSlots; i++) {
+        av_frame_free(&(*sequence)->slots[i].frame);
+    }
+    av_freep(&(*sequence)->pattern);
+    destroy_semaphore(&(*sequence)->work);
+    destroy_semaphore(&(*sequence)->done);
+    destroy_lock(&(*sequence)->mutex);
+    av_freep(sequence);
+}
@@ -0,0 +1,86 @@
+// This file is a part of videna.
+// Copyright (C) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef SEQUENCE_H
+#define SEQUENCE_H
+#include <libavutil/frame.h>
+#include <libavutil/rational.h>
+#include <stdint.h>
+#include "threads.h"
+#include "placement.h"
+
+// images decoded ahead of the one being output when none is requested
+#define SEQUENCE_READ_AHEAD 8
+#define SEQUENCE_MAX_WORKERS 16
+#define SEQUENCE_MAX_SLOTS 64
+// image2 also looks for the first image among these numbers
+#define SEQUENCE_FIRST_RANGE 5
+
+enum sequenceSlotStates {
+    slotEmpty,
+    slotWanted,
+    slotPending,
+    slotReady,
+    slotFailed
+};
+
+typedef struct {
+    int64_t index;
+    AVFrame* frame;
+    int state;
+} SequenceSlot;
+
+// A directory of numbered images read as a video, each image is the frame of its number.
+// Images are independent, so the workers decode the ones ahead of the output in parallel.
+typedef struct ImageSequence {
+    char* pattern;      // printf pattern with one integer conversion, like shot/frame_%04d.png
+    int64_t first;      // number of the first image
+    int64_t count;      // images from first on, up to the first missing one
+    AVRational rate;
+    int readAhead;
+
+    int64_t position;   // index of the image the caller waits for, read-ahead goes from it
+    SequenceSlot slots[SEQUENCE_MAX_SLOTS];
+    int numSlots;
+    Mutex mutex;
+
+    Thread workers[SEQUENCE_MAX_WORKERS];
+    int numWorkers;
+    Semaphore work;
+    // posted when a slot is decoded or failed while sequence_read() waits for one, waiting is guarded by mutex
+    Semaphore done;
+    int waiting;
+    int quit;
+    // placement of the video reading the sequence, NULL until one is attached
+    const ThreadPlacement* volatile placement;
+} ImageSequence;
+
+// Path of the image at index, returns -1 when it doesn't fit in size
+int sequence_path(const ImageSequence* sequence, int64_t index, char* path, size_t size);
+
+// threads 0 uses one per core, readAhead 0 uses SEQUENCE_READ_AHEAD.
+// Returns NULL when pattern has no single integer conversion or no image matches it.
+ImageSequence* sequence_open(const char* pattern, AVRational rate, int threads, int readAhead);
+
+// References the image at index into pFrame, waiting for it to be decoded.
+// The images after it in the direction of step are decoded ahead.
+// Returns 0, -1 when the image can't be decoded and -2 past the end of the sequence.
+int sequence_read(ImageSequence* sequence, int64_t index, int step, AVFrame* pFrame);
+
+void sequence_close(ImageSequence** sequence);
+
+#endif
@@ -0,0 +1,336 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#define write_fd _write
+#define close_fd _close
+#else
+#include <unistd.h>
+#define write_fd write
+#define close_fd close
+#define O_BINARY 0
+#endif
+#include "sink.h"
+#include "trace.h"
+#include "placement.h"
+#include <libavutil/common.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/mem.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+
+#define Y4M_FRAME_HEADER "FRAME\n"
+
+static int write_all(int fd, const uint8_t* data, int64_t size) {
+    while (size > 0) {
+        // a single write call takes at most an int on Windows
+        int chunk = size > (1 << 30) ? (1 << 30) : (int) size;
+        int ret = (int) write_fd(fd, data, chunk);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += ret;
+        size -= ret;
+    }
+    return 0;
+}
+
+static const char* y4m_colorspace(enum AVPixelFormat format) {
+    switch (format) {
+    case AV_PIX_FMT_YUV420P:
+        return "420jpeg";
+    case AV_PIX_FMT_GRAY8:
+        return "mono";
+    default:
+        return NULL;
+    }
+}
+
+static int write_header(Sink* sink, AVRational rate, AVRational aspect) {
+    char header[128];
+    int size;
+    if (rate.num <= 0 || rate.den <= 0) {
+        rate.num = 25;
+        rate.den = 1;
+    }
+    if (aspect.num <= 0 || aspect.den <= 0) {
+        // unknown
+        aspect.num = 0;
+        aspect.den = 0;
+    }
+    size = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:%d Ip A%d:%d C%s\n",
+        sink->width, sink->height, rate.num, rate.den, aspect.num, aspect.den, y4m_colorspace(sink->format));
+    return write_all(sink->fd, (const uint8_t*) header, size);
+}
+
+static void free_sink(Sink* sink) {
+    for (int i = 0; i < SINK_FRAMES; i++) {
+        av_frame_free(&sink->frames[i]);
+    }
+    for (int i = 0; i < SINK_BUFFERS; i++) {
+        av_freep(&sink->buffers[i].data);
+    }
+    sws_freeContext(sink->sws_context);
+    destroy_semaphore(&sink->framesFree);
+    destroy_semaphore(&sink->framesFilled);
+    destroy_semaphore(&sink->buffersFree);
+    destroy_semaphore(&sink->buffersFilled);
+    if (sink->ownsFd && sink->fd >= 0) {
+        close_fd(sink->fd);
+    }
+    av_free(sink);
+}
+
+// Converts frame into the packed planes at data, after the frame header of Y4M.
+static int convert_frame(Sink* sink, const AVFrame* frame, uint8_t* data) {
+    uint8_t* planes[4];
+    int linesizes[4];
+    if (sink->container == sinkY4M) {
+        memcpy(data, Y4M_FRAME_HEADER, sizeof(Y4M_FRAME_HEADER) - 1);
+        data += sizeof(Y4M_FRAME_HEADER) - 1;
+    }
+    if (av_image_fill_arrays(planes, linesizes, data, sink->format, sink->width, sink->height, 1) < 0) {
+        return -1;
+    }
+    sink->sws_context = sws_getCachedContext(sink->sws_context, frame->width,
+                            frame->height,
+                            frame->format,
+                            sink->width,
+                            sink->height,
+                            sink->format,
+                            SWS_BILINEAR,
+                            NULL,
+                            NULL,
+                            NULL
+                            );
+    if (sink->sws_context == NULL) {
+        return -1;
+    }
+    sws_scale(sink->sws_context, (const uint8_t* const*) frame->data,
+        frame->linesize, 0, frame->height, planes, linesizes);
+    return 0;
+}
+
+static SinkBuffer* next_buffer(Sink* sink) {
+    SinkBuffer* buffer;
+    wait_semaphore(&sink->buffersFree);
+    buffer = &sink->buffers[sink->bufferHead];
+    sink->bufferHead = (sink->bufferHead + 1) % SINK_BUFFERS;
+    buffer->size = 0;
+    buffer->frames = 0;
+    buffer->end = 0;
+    return buffer;
+}
+
+// After a failure both threads keep emptying their queue until the end, so no stage waits forever.
+static void* converter_worker(void* sinkV) {
+    Sink* sink = (Sink*) sinkV;
+    SinkBuffer* buffer = NULL;
+    int end = 0;
+    placement_worker("videna convert");
+    while (!end) {
+        AVFrame* frame;
+        wait_semaphore(&sink->framesFilled);
+        frame = sink->frames[sink->frameTail];
+        sink->frameTail = (sink->frameTail + 1) % SINK_FRAMES;
+        // sink_close() queues an empty frame
+        end = frame->buf[0] == NULL;
+        if (!end && !sink->failed) {
+            if (buffer == NULL) {
+                buffer = next_buffer(sink);
+            }
+            TRACE_BEGIN("sink convert", sink, frame->pts);
+            if (convert_frame(sink, frame, buffer->data + buffer->size) < 0) {
+                fprintf(stderr, "Could not convert the frame\n");
+                sink->failed = 1;
+            }
+            TRACE_END("sink convert", sink, frame->pts);
+            buffer->size += sink->frameBytes;
+            buffer->frames++;
+            if (buffer->size + sink->frameBytes > sink->capacity) {
+                post_semaphore(&sink->buffersFilled);
+                buffer = NULL;
+            }
+        }
+        av_frame_unref(frame);
+        post_semaphore(&sink->framesFree);
+    }
+    if (buffer == NULL) {
+        buffer = next_buffer(sink);
+    }
+    buffer->end = 1;
+    post_semaphore(&sink->buffersFilled);
+    return NULL;
+}
+
+static void* writer_worker(void* sinkV) {
+    Sink* sink = (Sink*) sinkV;
+    int end = 0;
+    placement_worker("videna write");
+    while (!end) {
+        SinkBuffer* buffer;
+        wait_semaphore(&sink->buffersFilled);
+        buffer = &sink->buffers[sink->bufferTail];
+        sink->bufferTail = (sink->bufferTail + 1) % SINK_BUFFERS;
+        end = buffer->end;
+        if (!sink->failed && buffer->size > 0) {
+            TRACE_BEGIN("sink write", sink, buffer->size);
+            if (write_all(sink->fd, buffer->data, buffer->size) < 0) {
+                fprintf(stderr, "Could not write the frames\n");
+                sink->failed = 1;
+            }
+            else {
+                sink->written += buffer->frames;
+            }
+            TRACE_END("sink write", sink, buffer->size);
+        }
+        post_semaphore(&sink->buffersFree);
+    }
+    return NULL;
+}
+
+// Opens a sink writing width x height frames of format to outputPath, or to fd when outputPath is NULL.
+// A Y4M stream starts with a header carrying rate and aspect, which may be 0/0 when unknown.
+Sink* sink_open(const char* outputPath, int fd, int container, enum AVPixelFormat format, int width, int height,
+        AVRational rate, AVRational aspect) {
+    Sink* sink;
+    int64_t imageBytes;
+    int perBuffer;
+
+    if (container == sinkY4M && y4m_colorspace(format) == NULL) {
+        fprintf(stderr, "Y4M only holds YUV420P and GRAY8 frames\n");
+        return NULL;
+    }
+    imageBytes = av_image_get_buffer_size(format, width, height, 1);
+    if (imageBytes <= 0) {
+        return NULL;
+    }
+    sink = av_mallocz(sizeof(Sink));
+    if (sink == NULL) {
+        return NULL;
+    }
+    init_semaphore(&sink->framesFree);
+    init_semaphore(&sink->framesFilled);
+    init_semaphore(&sink->buffersFree);
+    init_semaphore(&sink->buffersFilled);
+    sink->format = format;
+    sink->width = width;
+    sink->height = height;
+    sink->container = container;
+    sink->fd = fd;
+    if (outputPath != NULL) {
+#ifdef _WIN32
+        sink->fd = _open(outputPath, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        sink->fd = open(outputPath, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644);
+#endif
+        sink->ownsFd = 1;
+        if (sink->fd < 0) {
+            fprintf(stderr, "Could not open %s\n", outputPath);
+            free_sink(sink);
+            return NULL;
+        }
+    }
+#ifdef _WIN32
+    else {
+        // pipes are opened in text mode, which would rewrite every 0x0A byte
+        _setmode(sink->fd, _O_BINARY);
+    }
+#endif
+    sink->frameBytes = imageBytes + (container == sinkY4M ? sizeof(Y4M_FRAME_HEADER) - 1 : 0);
+    perBuffer = (int) FFMAX(SINK_WRITE_SIZE / sink->frameBytes, 1);
+    sink->capacity = sink->frameBytes * perBuffer;
+    for (int i = 0; i < SINK_FRAMES; i++) {
+        sink->frames[i] = av_frame_alloc();
+        if (sink->frames[i] == NULL) {
+            free_sink(sink);
+            return NULL;
+        }
+        post_semaphore(&sink->framesFree);
+    }
+    for (int i = 0; i < SINK_BUFFERS; i++) {
+        sink->buffers[i].data = av_malloc(sink->capacity);
+        if (sink->buffers[i].data == NULL) {
+            free_sink(sink);
+            return NULL;
+        }
+        post_semaphore(&sink->buffersFree);
+    }
+    if (container == sinkY4M && write_header(sink, rate, aspect) < 0) {
+        fprintf(stderr, "Could not write the frames\n");
+        free_sink(sink);
+        return NULL;
+    }
+    if (start_thread(&sink->converter, converter_worker, sink) < 0) {
+        free_sink(sink);
+        return NULL;
+    }
+    if (start_thread(&sink->writer, writer_worker, sink) < 0) {
+        // the converter still needs the end of the queue
+        sink->failed = 1;
+        post_semaphore(&sink->framesFilled);
+        join_thread(&sink->converter);
+        free_sink(sink);
+        return NULL;
+    }
+    return sink;
+}
+
+// Queues a reference to frame, waiting while the converter is SINK_FRAMES frames behind.
+// Returns -1 once the sink has failed.
+int sink_push(Sink* sink, const AVFrame* frame) {
+    AVFrame* slot;
+    if (sink->failed) {
+        return -1;
+    }
+    wait_semaphore(&sink->framesFree);
+    slot = sink->frames[sink->frameHead];
+    if (av_frame_ref(slot, frame) < 0) {
+        post_semaphore(&sink->framesFree);
+        return -1;
+    }
+    sink->frameHead = (sink->frameHead + 1) % SINK_FRAMES;
+    post_semaphore(&sink->framesFilled);
+    return 0;
+}
+
+// Writes what is still queued and closes the sink.
+// Returns the number of frames written, or -1 if any of them failed.
+int64_t sink_close(Sink** sinkP) {
+    Sink* sink = *sinkP;
+    int64_t written;
+    if (sink == NULL) {
+        return -1;
+    }
+    // an empty frame ends the queue
+    wait_semaphore(&sink->framesFree);
+    sink->frameHead = (sink->frameHead + 1) % SINK_FRAMES;
+    post_semaphore(&sink->framesFilled);
+    join_thread(&sink->converter);
+    join_thread(&sink->writer);
+    written = sink->failed ? -1 : sink->written;
+    free_sink(sink);
+    *sinkP = NULL;
+    return written;
+}
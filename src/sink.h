@@ -0,0 +1,98 @@
+// This file is a part of videna.
+// Copyright (C) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef SINK_H
+#define SINK_H
+#include <libavutil/frame.h>
+#include <libavutil/pixfmt.h>
+#include <libavutil/rational.h>
+#include <libswscale/swscale.h>
+#include <stdint.h>
+#include "threads.h"
+
+// Output pixel formats, indices of fmt[] in navigator.c
+enum formats {
+    formatRGBA,
+    formatBGRA,
+    formatARGB,
+    formatABGR,
+    formatYUV420P,
+    formatGRAY8A,
+    formatGRAY16LE,
+    formatNV12,
+    formatRGB24,
+    formatRGB565LE,
+    formatGRAY8,        // luma only, copied from the Y plane when the size matches
+    formatP010LE
+};
+
+enum sinkContainers {
+    sinkY4M,    // YUV4MPEG2, only for YUV420P and GRAY8
+    sinkRaw     // the planes of every frame back to back, without padding
+};
+
+// Decoded frames waiting for the converter
+#define SINK_FRAMES 8
+// Converted buffers waiting for the writer
+#define SINK_BUFFERS 3
+// Small frames are gathered into buffers of about this size so every write is large
+#define SINK_WRITE_SIZE (4 << 20)
+
+typedef struct {
+    uint8_t* data;
+    int64_t size;
+    int frames;
+    int end;            // the last buffer, the writer stops after it
+} SinkBuffer;
+
+// Converts and writes decoded frames on two threads of its own, so the caller only decodes.
+// Each queue has a single producer and a single consumer, and the semaphores count its free and filled slots.
+typedef struct {
+    AVFrame* frames[SINK_FRAMES];
+    int frameHead;
+    int frameTail;
+    Semaphore framesFree;
+    Semaphore framesFilled;
+    SinkBuffer buffers[SINK_BUFFERS];
+    int bufferHead;
+    int bufferTail;
+    Semaphore buffersFree;
+    Semaphore buffersFilled;
+    int64_t frameBytes;     // including the frame header of Y4M
+    int64_t capacity;       // bytes of each buffer, a multiple of frameBytes
+    struct SwsContext* sws_context;
+    enum AVPixelFormat format;
+    int width;
+    int height;
+    int container;
+    int fd;
+    int ownsFd;
+    Thread converter;
+    Thread writer;
+    volatile int failed;
+    int64_t written;        // frames, only touched by the writer until it is joined
+} Sink;
+
+Sink* sink_open(const char* outputPath, int fd, int container, enum AVPixelFormat format, int width, int height,
+    AVRational rate, AVRational aspect);
+
+int sink_push(Sink* sink, const AVFrame* frame);
+
+int64_t sink_close(Sink** sink);
+
+#endif
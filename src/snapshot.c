@@ -0,0 +1,122 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "snapshot.h"
+#include <stdio.h>
+
+// Encodes a decoded frame as a PNG or JPEG image into packet.
+// quality goes from 1 to 100 and only applies to JPEG.
+int snapshot_encode(const AVFrame* pFrame, int format, int quality, AVPacket* packet) {
+    const AVCodec* pCodec;
+    AVCodecContext* pCodecContext;
+    AVFrame* converted;
+    struct SwsContext* sws_ctx;
+    int ret;
+
+    pCodec = avcodec_find_encoder(format == snapshotJPEG ? AV_CODEC_ID_MJPEG : AV_CODEC_ID_PNG);
+    if (pCodec == NULL) {
+        fprintf(stderr, "Image encoder isn't supported\n");
+        return -1;
+    }
+    pCodecContext = avcodec_alloc_context3(pCodec);
+    if (pCodecContext == NULL) {
+        return -1;
+    }
+    pCodecContext->width = pFrame->width;
+    pCodecContext->height = pFrame->height;
+    pCodecContext->time_base.num = 1;
+    pCodecContext->time_base.den = 25;
+    if (format == snapshotJPEG) {
+        quality = quality < 1 ? 1 : quality > 100 ? 100 : quality;
+        pCodecContext->pix_fmt = AV_PIX_FMT_YUVJ420P;
+        pCodecContext->color_range = AVCOL_RANGE_JPEG;
+        // maps 1..100 onto the qscale range 31..2
+        pCodecContext->flags |= AV_CODEC_FLAG_QSCALE;
+        pCodecContext->global_quality = FF_QP2LAMBDA * (31 - (quality - 1) * 29 / 99);
+    }
+    else {
+        pCodecContext->pix_fmt = AV_PIX_FMT_RGB24;
+    }
+    if (avcodec_open2(pCodecContext, pCodec, NULL) != 0) {
+        fprintf(stderr, "Failed on open_codec2\n");
+        avcodec_free_context(&pCodecContext);
+        return -1;
+    }
+
+    converted = av_frame_alloc();
+    if (converted == NULL) {
+        avcodec_free_context(&pCodecContext);
+        return -1;
+    }
+    converted->format = pCodecContext->pix_fmt;
+    converted->width = pFrame->width;
+    converted->height = pFrame->height;
+    if (av_frame_get_buffer(converted, 0) < 0) {
+        av_frame_free(&converted);
+        avcodec_free_context(&pCodecContext);
+        return -1;
+    }
+    sws_ctx = sws_getContext(pFrame->width,
+                        pFrame->height,
+                        pFrame->format,
+                        converted->width,
+                        converted->height,
+                        converted->format,
+                        SWS_BILINEAR,
+                        NULL,
+                        NULL,
+                        NULL
+                        );
+    if (sws_ctx == NULL) {
+        av_frame_free(&converted);
+        avcodec_free_context(&pCodecContext);
+        return -1;
+    }
+    sws_scale(sws_ctx, (const uint8_t * const*)pFrame->data,
+        pFrame->linesize, 0, pFrame->height,
+        (uint8_t* const*)converted->data, converted->linesize);
+    sws_freeContext(sws_ctx);
+    converted->pts = 0;
+    converted->quality = pCodecContext->global_quality;
+
+    ret = avcodec_send_frame(pCodecContext, converted);
+    if (ret >= 0) {
+        ret = avcodec_send_frame(pCodecContext, NULL);
+    }
+    if (ret >= 0) {
+        ret = avcodec_receive_packet(pCodecContext, packet);
+    }
+    av_frame_free(&converted);
+    avcodec_free_context(&pCodecContext);
+    return ret < 0 ? -1 : 0;
+}
+
+int snapshot_write(const AVPacket* packet, const char* path) {
+    FILE* file = fopen(path, "wb");
+    int ret = 0;
+    if (file == NULL) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return -1;
+    }
+    if (fwrite(packet->data, 1, packet->size, file) != (size_t)packet->size) {
+        ret = -1;
+    }
+    if (fclose(file) != 0) {
+        ret = -1;
+    }
+    return ret;
+}
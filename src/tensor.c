@@ -0,0 +1,578 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "tensor.h"
+#include <libavutil/common.h>
+#include <libavutil/mem.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TENSOR_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TENSOR_NEON
+#endif
+
+// YUV to RGB in 0..255 and RGB to the tensor values folded into one linear map per channel
+typedef struct {
+    float yScale;
+    float rV;
+    float gU;
+    float gV;
+    float bU;
+    float offset[3];
+    float scale[3];
+    float bias[3];
+} Coefficients;
+
+static void set_coefficients(Coefficients* k, const Tensor* tensor, const AVFrame* pFrame, int gray, int fallback) {
+    // gray sources are rarely tagged and almost always full range
+    int full = !fallback && (pFrame->color_range == AVCOL_RANGE_JPEG
+        || (gray && pFrame->color_range != AVCOL_RANGE_MPEG)
+        || pFrame->format == AV_PIX_FMT_YUVJ420P
+        || pFrame->format == AV_PIX_FMT_YUVJ422P
+        || pFrame->format == AV_PIX_FMT_YUVJ444P);
+    float kr = 0.299f;
+    float kb = 0.114f;
+    float kg;
+    float cScale = full ? 1.0f : 255.0f / 224.0f;
+    float yOffset = full ? 0.0f : 16.0f;
+
+    if (!fallback) {
+        if (pFrame->colorspace == AVCOL_SPC_BT709
+                || (pFrame->colorspace == AVCOL_SPC_UNSPECIFIED && pFrame->height > 576)) {
+            kr = 0.2126f;
+            kb = 0.0722f;
+        }
+        else if (pFrame->colorspace == AVCOL_SPC_BT2020_NCL || pFrame->colorspace == AVCOL_SPC_BT2020_CL) {
+            kr = 0.2627f;
+            kb = 0.0593f;
+        }
+    }
+    kg = 1.0f - kr - kb;
+    k->yScale = full ? 1.0f : 255.0f / 219.0f;
+    k->rV = 2.0f * (1.0f - kr) * cScale;
+    k->gU = -2.0f * kb * (1.0f - kb) / kg * cScale;
+    k->gV = -2.0f * kr * (1.0f - kr) / kg * cScale;
+    k->bU = 2.0f * (1.0f - kb) * cScale;
+    k->offset[0] = -k->yScale * yOffset - 128.0f * k->rV;
+    k->offset[1] = -k->yScale * yOffset - 128.0f * (k->gU + k->gV);
+    k->offset[2] = -k->yScale * yOffset - 128.0f * k->bU;
+    for (int c = 0; c < 3; c++) {
+        if (tensor->options.type == tensorUint8) {
+            k->scale[c] = 1.0f;
+            k->bias[c] = 0.0f;
+        }
+        else {
+            k->scale[c] = 1.0f / (255.0f * tensor->options.std[c]);
+            k->bias[c] = -tensor->options.mean[c] / tensor->options.std[c];
+        }
+    }
+}
+
+// Converts n interpolated YUV samples to normalized RGB planes
+static void convert_row(const Coefficients* k, const float* y, const float* u, const float* v,
+        float* r, float* g, float* b, int n) {
+    int i = 0;
+#if defined(TENSOR_SSE2)
+    const __m128 yScale = _mm_set1_ps(k->yScale);
+    const __m128 rV = _mm_set1_ps(k->rV);
+    const __m128 gU = _mm_set1_ps(k->gU);
+    const __m128 gV = _mm_set1_ps(k->gV);
+    const __m128 bU = _mm_set1_ps(k->bU);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 top = _mm_set1_ps(255.0f);
+    __m128 offset[3], scale[3], bias[3];
+    for (int c = 0; c < 3; c++) {
+        offset[c] = _mm_set1_ps(k->offset[c]);
+        scale[c] = _mm_set1_ps(k->scale[c]);
+        bias[c] = _mm_set1_ps(k->bias[c]);
+    }
+    for (; i + 4 <= n; i += 4) {
+        __m128 vy = _mm_mul_ps(_mm_loadu_ps(y + i), yScale);
+        __m128 vu = _mm_loadu_ps(u + i);
+        __m128 vv = _mm_loadu_ps(v + i);
+        __m128 vr = _mm_add_ps(_mm_add_ps(vy, _mm_mul_ps(vv, rV)), offset[0]);
+        __m128 vg = _mm_add_ps(_mm_add_ps(vy, _mm_add_ps(_mm_mul_ps(vu, gU), _mm_mul_ps(vv, gV))), offset[1]);
+        __m128 vb = _mm_add_ps(_mm_add_ps(vy, _mm_mul_ps(vu, bU)), offset[2]);
+        vr = _mm_min_ps(_mm_max_ps(vr, zero), top);
+        vg = _mm_min_ps(_mm_max_ps(vg, zero), top);
+        vb = _mm_min_ps(_mm_max_ps(vb, zero), top);
+        _mm_storeu_ps(r + i, _mm_add_ps(_mm_mul_ps(vr, scale[0]), bias[0]));
+        _mm_storeu_ps(g + i, _mm_add_ps(_mm_mul_ps(vg, scale[1]), bias[1]));
+        _mm_storeu_ps(b + i, _mm_add_ps(_mm_mul_ps(vb, scale[2]), bias[2]));
+    }
+#elif defined(TENSOR_NEON)
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t top = vdupq_n_f32(255.0f);
+    float32x4_t offset[3], scale[3], bias[3];
+    for (int c = 0; c < 3; c++) {
+        offset[c] = vdupq_n_f32(k->offset[c]);
+        scale[c] = vdupq_n_f32(k->scale[c]);
+        bias[c] = vdupq_n_f32(k->bias[c]);
+    }
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t vy = vmulq_n_f32(vld1q_f32(y + i), k->yScale);
+        float32x4_t vu = vld1q_f32(u + i);
+        float32x4_t vv = vld1q_f32(v + i);
+        float32x4_t vr = vmlaq_n_f32(vaddq_f32(vy, offset[0]), vv, k->rV);
+        float32x4_t vg = vmlaq_n_f32(vmlaq_n_f32(vaddq_f32(vy, offset[1]), vu, k->gU), vv, k->gV);
+        float32x4_t vb = vmlaq_n_f32(vaddq_f32(vy, offset[2]), vu, k->bU);
+        vr = vminq_f32(vmaxq_f32(vr, zero), top);
+        vg = vminq_f32(vmaxq_f32(vg, zero), top);
+        vb = vminq_f32(vmaxq_f32(vb, zero), top);
+        vst1q_f32(r + i, vmlaq_f32(bias[0], vr, scale[0]));
+        vst1q_f32(g + i, vmlaq_f32(bias[1], vg, scale[1]));
+        vst1q_f32(b + i, vmlaq_f32(bias[2], vb, scale[2]));
+    }
+#endif
+    for (; i < n; i++) {
+        float vy = y[i] * k->yScale;
+        float vr = vy + v[i] * k->rV + k->offset[0];
+        float vg = vy + u[i] * k->gU + v[i] * k->gV + k->offset[1];
+        float vb = vy + u[i] * k->bU + k->offset[2];
+        r[i] = av_clipf(vr, 0.0f, 255.0f) * k->scale[0] + k->bias[0];
+        g[i] = av_clipf(vg, 0.0f, 255.0f) * k->scale[1] + k->bias[1];
+        b[i] = av_clipf(vb, 0.0f, 255.0f) * k->scale[2] + k->bias[2];
+    }
+}
+
+// IEEE 754 half precision with round to nearest even, subnormals kept
+static uint16_t float_to_half(float value) {
+    uint32_t bits;
+    uint32_t sign;
+    int32_t exponent;
+    uint32_t mantissa;
+    memcpy(&bits, &value, sizeof(bits));
+    sign = (bits >> 16) & 0x8000;
+    exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+    mantissa = bits & 0x7fffff;
+    if (((bits >> 23) & 0xff) == 0xff) {
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    }
+    if (exponent >= 31) {
+        return sign | 0x7c00;
+    }
+    if (exponent <= 0) {
+        uint32_t shift;
+        uint32_t half;
+        if (exponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        shift = 14 - exponent;
+        half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1 && ((mantissa & ((1u << (shift - 1)) - 1)) || (half & 1))) {
+            half++;
+        }
+        return sign | half;
+    }
+    {
+        uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+        if ((mantissa & 0x1000) && ((mantissa & 0xfff) || (half & 1))) {
+            // may carry into the exponent, which is still the right rounding
+            half++;
+        }
+        return half;
+    }
+}
+
+// Writes n values of channel c at column x of row y
+static void store_values(const Tensor* tensor, uint8_t* dst, int c, int y, int x, const float* values, int n) {
+    size_t index = ((size_t)c * tensor->options.height + y) * tensor->options.width + x;
+    switch (tensor->options.type) {
+        case tensorFloat32:
+            memcpy((float*)dst + index, values, n * sizeof(float));
+            break;
+        case tensorFloat16: {
+            uint16_t* out = (uint16_t*)dst + index;
+            for (int i = 0; i < n; i++) {
+                out[i] = float_to_half(values[i]);
+            }
+            break;
+        }
+        default: {
+            uint8_t* out = dst + index;
+            for (int i = 0; i < n; i++) {
+                out[i] = (uint8_t)(values[i] + 0.5f);
+            }
+            break;
+        }
+    }
+}
+
+static void fill_values(const Tensor* tensor, uint8_t* dst, int c, int y, int x, float value, int n) {
+    size_t index = ((size_t)c * tensor->options.height + y) * tensor->options.width + x;
+    switch (tensor->options.type) {
+        case tensorFloat32: {
+            float* out = (float*)dst + index;
+            for (int i = 0; i < n; i++) {
+                out[i] = value;
+            }
+            break;
+        }
+        case tensorFloat16: {
+            uint16_t* out = (uint16_t*)dst + index;
+            uint16_t half = float_to_half(value);
+            for (int i = 0; i < n; i++) {
+                out[i] = half;
+            }
+            break;
+        }
+        default:
+            memset(dst + index, (uint8_t)(value + 0.5f), n);
+            break;
+    }
+}
+
+// 8 bit YUV or gray with every component in its own byte can be sampled directly
+static int supported(const AVPixFmtDescriptor* desc) {
+    if (desc == NULL || desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL
+            | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_FLOAT)) {
+        return 0;
+    }
+    if (desc->nb_components == 2) {
+        return 0;
+    }
+    for (int c = 0; c < FFMIN(desc->nb_components, 3); c++) {
+        if (desc->comp[c].depth != 8 || desc->comp[c].shift != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void compute_taps(TensorTap* taps, int count, float start, float length, int width, int shift) {
+    for (int i = 0; i < count; i++) {
+        float sx = start + (i + 0.5f) * length / count - 0.5f;
+        if (shift) {
+            sx = (sx + 0.5f) / (1 << shift) - 0.5f;
+        }
+        sx = av_clipf(sx, 0.0f, (float)(width - 1));
+        taps[i].x0 = (int)sx;
+        taps[i].x1 = FFMIN(taps[i].x0 + 1, width - 1);
+        taps[i].weight = sx - taps[i].x0;
+    }
+}
+
+// Recomputes where the picture lands in the tensor and which source columns every output column samples
+static int update_geometry(Tensor* tensor, const AVFrame* pFrame, const AVPixFmtDescriptor* desc) {
+    int width = tensor->options.width;
+    int height = tensor->options.height;
+    float scale;
+
+    tensor->contentX = 0;
+    tensor->contentY = 0;
+    tensor->contentWidth = width;
+    tensor->contentHeight = height;
+    tensor->srcX = 0;
+    tensor->srcY = 0;
+    tensor->srcCropWidth = pFrame->width;
+    tensor->srcCropHeight = pFrame->height;
+    if (tensor->options.resize == tensorLetterbox) {
+        scale = FFMIN((float)width / pFrame->width, (float)height / pFrame->height);
+        tensor->contentWidth = av_clip(lrintf(pFrame->width * scale), 1, width);
+        tensor->contentHeight = av_clip(lrintf(pFrame->height * scale), 1, height);
+        tensor->contentX = (width - tensor->contentWidth) / 2;
+        tensor->contentY = (height - tensor->contentHeight) / 2;
+    }
+    else if (tensor->options.resize == tensorCrop) {
+        scale = FFMAX((float)width / pFrame->width, (float)height / pFrame->height);
+        tensor->srcCropWidth = FFMIN(width / scale, (float)pFrame->width);
+        tensor->srcCropHeight = FFMIN(height / scale, (float)pFrame->height);
+        tensor->srcX = (pFrame->width - tensor->srcCropWidth) / 2;
+        tensor->srcY = (pFrame->height - tensor->srcCropHeight) / 2;
+    }
+
+    av_freep(&tensor->lumaTaps);
+    av_freep(&tensor->chromaTaps);
+    tensor->lumaTaps = av_malloc_array(tensor->contentWidth, sizeof(TensorTap));
+    tensor->chromaTaps = av_malloc_array(tensor->contentWidth, sizeof(TensorTap));
+    if (tensor->lumaTaps == NULL || tensor->chromaTaps == NULL) {
+        tensor->srcWidth = 0;
+        return -1;
+    }
+    compute_taps(tensor->lumaTaps, tensor->contentWidth, tensor->srcX, tensor->srcCropWidth, pFrame->width, 0);
+    compute_taps(tensor->chromaTaps, tensor->contentWidth, tensor->srcX, tensor->srcCropWidth,
+        AV_CEIL_RSHIFT(pFrame->width, desc->log2_chroma_w), desc->log2_chroma_w);
+    tensor->srcWidth = pFrame->width;
+    tensor->srcHeight = pFrame->height;
+    tensor->srcFormat = pFrame->format;
+    return 0;
+}
+
+// Bilinear sample of one component along the row at source position sy
+static void sample_component(const Tensor* tensor, const AVFrame* pFrame, const AVComponentDescriptor* comp,
+        const TensorTap* taps, float sy, int height, float* out) {
+    int y0 = (int)sy;
+    int y1 = FFMIN(y0 + 1, height - 1);
+    float wy = sy - y0;
+    int step = comp->step;
+    const uint8_t* row0 = pFrame->data[comp->plane] + (ptrdiff_t)y0 * pFrame->linesize[comp->plane] + comp->offset;
+    const uint8_t* row1 = pFrame->data[comp->plane] + (ptrdiff_t)y1 * pFrame->linesize[comp->plane] + comp->offset;
+    for (int i = 0; i < tensor->contentWidth; i++) {
+        const TensorTap* tap = &taps[i];
+        float a0 = row0[tap->x0 * step];
+        float b0 = row0[tap->x1 * step];
+        float a1 = row1[tap->x0 * step];
+        float b1 = row1[tap->x1 * step];
+        float top = a0 + (b0 - a0) * tap->weight;
+        float bottom = a1 + (b1 - a1) * tap->weight;
+        out[i] = top + (bottom - top) * wy;
+    }
+}
+
+// Resizes, converts and normalizes pFrame into one [3, height, width] slice in a single pass over the output rows
+static void write_frame(Tensor* tensor, const AVFrame* pFrame, const AVPixFmtDescriptor* desc, uint8_t* dst, int fallback) {
+    int width = tensor->options.width;
+    int height = tensor->options.height;
+    int cw = tensor->contentWidth;
+    int right = width - tensor->contentX - cw;
+    int chromaHeight = AV_CEIL_RSHIFT(pFrame->height, desc->log2_chroma_h);
+    float* rowY = tensor->rows;
+    float* rowU = rowY + width;
+    float* rowV = rowU + width;
+    float* rowR = rowV + width;
+    float* rowG = rowR + width;
+    float* rowB = rowG + width;
+    float* channels[3];
+    float pad[3];
+    Coefficients k;
+
+    set_coefficients(&k, tensor, pFrame, desc->nb_components < 3, fallback);
+    for (int c = 0; c < 3; c++) {
+        pad[c] = tensor->options.pad * k.scale[c] + k.bias[c];
+    }
+    if (desc->nb_components < 3) {
+        for (int i = 0; i < cw; i++) {
+            rowU[i] = 128.0f;
+            rowV[i] = 128.0f;
+        }
+    }
+
+    for (int y = 0; y < height; y++) {
+        int cy = y - tensor->contentY;
+        float sy;
+        if (cy < 0 || cy >= tensor->contentHeight) {
+            for (int c = 0; c < 3; c++) {
+                fill_values(tensor, dst, c, y, 0, pad[c], width);
+            }
+            continue;
+        }
+        sy = tensor->srcY + (cy + 0.5f) * tensor->srcCropHeight / tensor->contentHeight - 0.5f;
+        sample_component(tensor, pFrame, &desc->comp[0], tensor->lumaTaps,
+            av_clipf(sy, 0.0f, (float)(pFrame->height - 1)), pFrame->height, rowY);
+        if (desc->nb_components >= 3) {
+            float sc = av_clipf((sy + 0.5f) / (1 << desc->log2_chroma_h) - 0.5f, 0.0f, (float)(chromaHeight - 1));
+            sample_component(tensor, pFrame, &desc->comp[1], tensor->chromaTaps, sc, chromaHeight, rowU);
+            sample_component(tensor, pFrame, &desc->comp[2], tensor->chromaTaps, sc, chromaHeight, rowV);
+        }
+        if (tensor->options.type == tensorFloat32) {
+            // converted straight into the planes
+            for (int c = 0; c < 3; c++) {
+                channels[c] = (float*)dst + ((size_t)c * height + y) * width + tensor->contentX;
+            }
+        }
+        else {
+            channels[0] = rowR;
+            channels[1] = rowG;
+            channels[2] = rowB;
+        }
+        convert_row(&k, rowY, rowU, rowV, channels[0], channels[1], channels[2], cw);
+        for (int c = 0; c < 3; c++) {
+            if (tensor->contentX > 0) {
+                fill_values(tensor, dst, c, y, 0, pad[c], tensor->contentX);
+            }
+            if (right > 0) {
+                fill_values(tensor, dst, c, y, tensor->contentX + cw, pad[c], right);
+            }
+            if (tensor->options.type != tensorFloat32) {
+                store_values(tensor, dst, c, y, tensor->contentX, channels[c], cw);
+            }
+        }
+    }
+}
+
+// Brings sources that can't be sampled directly to planar YUV 4:4:4, which keeps their full chroma
+static AVFrame* convert_source(Tensor* tensor, const AVFrame* pFrame) {
+    if (tensor->converted == NULL || tensor->converted->width != pFrame->width
+            || tensor->converted->height != pFrame->height) {
+        av_frame_free(&tensor->converted);
+        tensor->converted = av_frame_alloc();
+        if (tensor->converted == NULL) {
+            return NULL;
+        }
+        tensor->converted->format = AV_PIX_FMT_YUV444P;
+        tensor->converted->width = pFrame->width;
+        tensor->converted->height = pFrame->height;
+        if (av_frame_get_buffer(tensor->converted, 0) < 0) {
+            av_frame_free(&tensor->converted);
+            return NULL;
+        }
+    }
+    tensor->sws_context = sws_getCachedContext(tensor->sws_context,
+        pFrame->width, pFrame->height, pFrame->format,
+        pFrame->width, pFrame->height, AV_PIX_FMT_YUV444P,
+        SWS_POINT, NULL, NULL, NULL);
+    if (tensor->sws_context == NULL) {
+        return NULL;
+    }
+    sws_scale(tensor->sws_context, (const uint8_t * const*)pFrame->data,
+        pFrame->linesize, 0, pFrame->height,
+        (uint8_t* const*)tensor->converted->data, tensor->converted->linesize);
+    return tensor->converted;
+}
+
+Tensor* tensor_alloc(const TensorOptions* options) {
+    Tensor* tensor;
+    int sample = options->type == tensorFloat32 ? 4 : options->type == tensorFloat16 ? 2 : 1;
+    if (options->width <= 0 || options->height <= 0 || options->batch <= 0
+            || options->type < tensorFloat32 || options->type > tensorUint8
+            || options->resize < tensorStretch || options->resize > tensorCrop) {
+        fprintf(stderr, "Invalid tensor options\n");
+        return NULL;
+    }
+    if (options->type != tensorUint8) {
+        for (int c = 0; c < 3; c++) {
+            if (options->std[c] == 0.0f) {
+                fprintf(stderr, "Invalid tensor options\n");
+                return NULL;
+            }
+        }
+    }
+    if ((int64_t)options->width * options->height * 3 * sample * options->batch > INT32_MAX) {
+        fprintf(stderr, "Tensor too large\n");
+        return NULL;
+    }
+    tensor = av_mallocz(sizeof(Tensor));
+    if (tensor == NULL) {
+        return NULL;
+    }
+    init_lock(&tensor->mutex);
+    tensor->options = *options;
+    tensor->frameBytes = options->width * options->height * 3 * sample;
+    tensor->rows = av_malloc_array(6 * (size_t)options->width, sizeof(float));
+    for (int i = 0; i < 2; i++) {
+        tensor->batches[i].data = av_malloc((size_t)tensor->frameBytes * options->batch);
+    }
+    if (tensor->rows == NULL || tensor->batches[0].data == NULL || tensor->batches[1].data == NULL) {
+        tensor_free(&tensor);
+        return NULL;
+    }
+    return tensor;
+}
+
+void tensor_free(Tensor** tensor) {
+    if (*tensor == NULL) {
+        return;
+    }
+    av_freep(&(*tensor)->lumaTaps);
+    av_freep(&(*tensor)->chromaTaps);
+    av_freep(&(*tensor)->rows);
+    sws_freeContext((*tensor)->sws_context);
+    av_frame_free(&(*tensor)->converted);
+    for (int i = 0; i < 2; i++) {
+        av_freep(&(*tensor)->batches[i].data);
+    }
+    destroy_lock(&(*tensor)->mutex);
+    av_freep(tensor);
+}
+
+// Adds pFrame to the batch being filled.
+// Returns 1 when that completes the batch, 0 when it needs more frames,
+// or -1 when the frame was dropped because the consumer still holds both batches.
+int tensor_push(Tensor* tensor, const AVFrame* pFrame, int64_t pts) {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pFrame->format);
+    TensorBatch* batch;
+    int fallback = 0;
+    int full;
+
+    lock(&tensor->mutex);
+    batch = &tensor->batches[tensor->filling];
+    if (batch->state != 0) {
+        tensor->dropped++;
+        unlock(&tensor->mutex);
+        return -1;
+    }
+    unlock(&tensor->mutex);
+
+    if (!supported(desc)) {
+        pFrame = convert_source(tensor, pFrame);
+        if (pFrame == NULL) {
+            return -1;
+        }
+        desc = av_pix_fmt_desc_get(pFrame->format);
+        fallback = 1;
+    }
+    if (pFrame->width != tensor->srcWidth || pFrame->height != tensor->srcHeight
+            || pFrame->format != tensor->srcFormat) {
+        if (update_geometry(tensor, pFrame, desc) < 0) {
+            return -1;
+        }
+    }
+    write_frame(tensor, pFrame, desc, batch->data + (size_t)batch->count * tensor->frameBytes, fallback);
+    if (batch->count == 0) {
+        batch->pts = pts;
+    }
+    batch->count++;
+    full = batch->count == tensor->options.batch;
+    if (full) {
+        lock(&tensor->mutex);
+        batch->state = 1;
+        tensor->filling ^= 1;
+        unlock(&tensor->mutex);
+    }
+    return full;
+}
+
+// Hands the oldest complete batch to the consumer until tensor_release.
+// Returns its size in bytes, or 0 when no batch is complete.
+int tensor_acquire(Tensor* tensor, uint8_t** data, int64_t* pts) {
+    int size = 0;
+    lock(&tensor->mutex);
+    for (int i = 0; i < 2; i++) {
+        // when both are complete the one to be filled next is the older
+        TensorBatch* batch = &tensor->batches[(tensor->filling + i) % 2];
+        if (batch->state == 1) {
+            batch->state = 2;
+            *data = batch->data;
+            *pts = batch->pts;
+            size = batch->count * tensor->frameBytes;
+            break;
+        }
+    }
+    unlock(&tensor->mutex);
+    return size;
+}
+
+// Gives the held batch back to be filled again.
+void tensor_release(Tensor* tensor) {
+    lock(&tensor->mutex);
+    for (int i = 0; i < 2; i++) {
+        if (tensor->batches[i].state == 2) {
+            tensor->batches[i].state = 0;
+            tensor->batches[i].count = 0;
+        }
+    }
+    unlock(&tensor->mutex);
+}
+
+int64_t tensor_bytes(const Tensor* tensor) {
+    return 2 * (int64_t)tensor->options.batch * tensor->frameBytes;
+}
@@ -0,0 +1,109 @@
+// This file is a part of videna.
+// Copyright (C) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef TENSOR_H
+#define TENSOR_H
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+#include <stdint.h>
+#include "threads.h"
+
+enum tensorTypes {
+    tensorFloat32,
+    tensorFloat16,
+    tensorUint8
+};
+
+enum tensorResizes {
+    tensorStretch,
+    tensorLetterbox,    // fits the whole picture and pads the rest
+    tensorCrop          // fills the tensor and crops the center of the picture
+};
+
+typedef struct {
+    int width;
+    int height;
+    int type;
+    int resize;
+    // applied as (value / 255 - mean) / std to every channel, ignored by tensorUint8
+    float mean[3];
+    float std[3];
+    // value of the letterbox padding in pixel units, 0 to 255
+    float pad;
+    // frames packed into one contiguous [batch, 3, height, width] tensor
+    int batch;
+} TensorOptions;
+
+// One column of the output sampled from two source columns
+typedef struct {
+    int x0;
+    int x1;
+    float weight;
+} TensorTap;
+
+typedef struct {
+    uint8_t* data;
+    int count;
+    int64_t pts;    // of the first frame in the batch
+    int state;      // 0 filling, 1 ready, 2 held by the consumer
+} TensorBatch;
+
+typedef struct {
+    TensorOptions options;
+    int frameBytes;
+
+    // geometry of the source the taps were computed for
+    int srcWidth;
+    int srcHeight;
+    int srcFormat;
+    int contentX;
+    int contentY;
+    int contentWidth;
+    int contentHeight;
+    float srcX;
+    float srcY;
+    float srcCropWidth;
+    float srcCropHeight;
+    TensorTap* lumaTaps;
+    TensorTap* chromaTaps;
+    // one output row of interpolated samples, then of converted channels
+    float* rows;
+
+    // fallback for sources that aren't 8 bit YUV
+    struct SwsContext* sws_context;
+    AVFrame* converted;
+
+    TensorBatch batches[2];
+    int filling;
+    int64_t dropped;
+    Mutex mutex;
+} Tensor;
+
+Tensor* tensor_alloc(const TensorOptions* options);
+
+void tensor_free(Tensor** tensor);
+
+int tensor_push(Tensor* tensor, const AVFrame* pFrame, int64_t pts);
+
+int tensor_acquire(Tensor* tensor, uint8_t** data, int64_t* pts);
+
+void tensor_release(Tensor* tensor);
+
+int64_t tensor_bytes(const Tensor* tensor);
+
+#endif
@@ -0,0 +1,248 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Counts every heap allocation, FFmpeg's included, by replacing the allocator of glibc in the executable.
+// A generated clip is played after a warm-up, then demuxed and decoded by FFmpeg alone: the playback
+// must not allocate more than the bare decoding, so converting, publishing and handing out the frames
+// allocates nothing. What remains are FFmpeg's own per-packet buffers, printed for reference.
+
+#include "navigator.h"
+#include <libavformat/avformat.h>
+#include <libavutil/imgutils.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define WIDTH 64
+#define HEIGHT 48
+#define FRAMES 300
+#define WARMUP 50
+#define PLAYED 200
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+
+static atomic_int counting;
+static atomic_long allocations;
+
+static void count_allocation(void) {
+    if (atomic_load_explicit(&counting, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    }
+}
+
+void* malloc(size_t size) {
+    count_allocation();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    count_allocation();
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    count_allocation();
+    return __libc_realloc(ptr, size);
+}
+
+// av_malloc() goes through posix_memalign()
+int posix_memalign(void** ptr, size_t alignment, size_t size) {
+    count_allocation();
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr == NULL ? ENOMEM : 0;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    count_allocation();
+    return __libc_memalign(alignment, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    count_allocation();
+    return __libc_memalign(alignment, size);
+}
+
+static void start_counting(void) {
+    atomic_store(&allocations, 0);
+    atomic_store(&counting, 1);
+}
+
+static long stop_counting(void) {
+    atomic_store(&counting, 0);
+    return atomic_load(&allocations);
+}
+
+// Raw frames in NUT, which needs neither an encoder nor any setup from the decoder
+static int write_clip(const char* path) {
+    AVFormatContext* pFormatContext = NULL;
+    AVStream* stream;
+    AVPacket* pPacket;
+    int size = av_image_get_buffer_size(AV_PIX_FMT_YUV420P, WIDTH, HEIGHT, 1);
+    int ret = -1;
+
+    if (avformat_alloc_output_context2(&pFormatContext, NULL, "nut", path) < 0) {
+        return -1;
+    }
+    stream = avformat_new_stream(pFormatContext, NULL);
+    pPacket = av_packet_alloc();
+    if (stream == NULL || pPacket == NULL) {
+        goto end;
+    }
+    stream->time_base = (AVRational) {1, 25};
+    stream->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    stream->codecpar->codec_id = AV_CODEC_ID_RAWVIDEO;
+    stream->codecpar->format = AV_PIX_FMT_YUV420P;
+    stream->codecpar->width = WIDTH;
+    stream->codecpar->height = HEIGHT;
+    if (avio_open(&pFormatContext->pb, path, AVIO_FLAG_WRITE) < 0) {
+        goto end;
+    }
+    if (avformat_write_header(pFormatContext, NULL) < 0) {
+        goto end;
+    }
+    for (int i = 0; i < FRAMES; i++) {
+        if (av_new_packet(pPacket, size) < 0) {
+            goto end;
+        }
+        memset(pPacket->data, i * 7, size);
+        pPacket->pts = i;
+        pPacket->dts = i;
+        pPacket->duration = 1;
+        pPacket->flags |= AV_PKT_FLAG_KEY;
+        pPacket->stream_index = stream->index;
+        if (av_interleaved_write_frame(pFormatContext, pPacket) < 0) {
+            goto end;
+        }
+    }
+    ret = av_write_trailer(pFormatContext);
+end:
+    av_packet_free(&pPacket);
+    avio_closep(&pFormatContext->pb);
+    avformat_free_context(pFormatContext);
+    return ret;
+}
+
+// The allocations of the played frames, from make_frame() to freeNativeFrame() like the decode isolate
+static long play_allocations(char* path) {
+    void* videoState = openVideo(path, formatRGBA, 0, 0);
+    ReadyFrame frame;
+    long counted = -1;
+
+    if (videoState == NULL) {
+        fprintf(stderr, "Could not open the clip\n");
+        return -1;
+    }
+    for (int i = 0; i < WARMUP + PLAYED; i++) {
+        if (i == WARMUP) {
+            start_counting();
+        }
+        if (make_frame(videoState) < 0) {
+            fprintf(stderr, "The clip ended after %d frames\n", i);
+            stop_counting();
+            goto end;
+        }
+        retrieveFrameInto(videoState, &frame);
+        if (frame.exists != 1 || frame.width != WIDTH || frame.height != HEIGHT) {
+            fprintf(stderr, "Frame %d wasn't handed out\n", i);
+            stop_counting();
+            goto end;
+        }
+        freeNativeFrame(videoState);
+    }
+    counted = stop_counting();
+end:
+    disposeVideo(videoState);
+    return counted;
+}
+
+// The allocations of FFmpeg alone for the same frames, read and decoded the way decode_frame() does
+static long decode_allocations(const char* path) {
+    AVFormatContext* pFormatContext = NULL;
+    AVCodecContext* pCodecContext = NULL;
+    const AVCodec* pCodec;
+    AVPacket* pPacket = av_packet_alloc();
+    AVFrame* pFrame = av_frame_alloc();
+    int decoded = 0;
+    long counted = -1;
+
+    if (pPacket == NULL || pFrame == NULL || avformat_open_input(&pFormatContext, path, NULL, NULL) < 0) {
+        goto end;
+    }
+    avformat_find_stream_info(pFormatContext, NULL);
+    pCodec = avcodec_find_decoder(pFormatContext->streams[0]->codecpar->codec_id);
+    pCodecContext = avcodec_alloc_context3(pCodec);
+    if (pCodecContext == NULL
+            || avcodec_parameters_to_context(pCodecContext, pFormatContext->streams[0]->codecpar) < 0
+            || avcodec_open2(pCodecContext, pCodec, NULL) < 0) {
+        goto end;
+    }
+    while (decoded < WARMUP + PLAYED && av_read_frame(pFormatContext, pPacket) >= 0) {
+        if (avcodec_send_packet(pCodecContext, pPacket) >= 0 && avcodec_receive_frame(pCodecContext, pFrame) >= 0) {
+            av_frame_unref(pFrame);
+            if (++decoded == WARMUP) {
+                start_counting();
+            }
+        }
+        av_packet_unref(pPacket);
+    }
+    counted = stop_counting();
+    if (decoded < WARMUP + PLAYED) {
+        counted = -1;
+    }
+end:
+    av_frame_free(&pFrame);
+    av_packet_free(&pPacket);
+    avcodec_free_context(&pCodecContext);
+    avformat_close_input(&pFormatContext);
+    return counted;
+}
+
+int main(void) {
+    char path[] = "/tmp/videna_alloc_XXXXXX.nut";
+    int fd = mkstemps(path, 4);
+    long played;
+    long decoded;
+
+    if (fd < 0) {
+        return 1;
+    }
+    close(fd);
+    if (write_clip(path) < 0) {
+        fprintf(stderr, "Could not write the clip\n");
+        unlink(path);
+        return 1;
+    }
+    played = play_allocations(path);
+    decoded = decode_allocations(path);
+    unlink(path);
+    if (played < 0 || decoded < 0) {
+        return 1;
+    }
+    printf("%d frames: %ld allocations played, %ld by FFmpeg decoding alone\n", PLAYED, played, decoded);
+    if (played > decoded) {
+        fprintf(stderr, "Playback allocated %ld times more than decoding\n", played - decoded);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,179 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+// Opens a generated clip through a filter graph that changes the size of the picture. The cropped
+// frames already have the output format and size, so each one must be copied from the graph as is:
+// every pixel has to match the source pixel the crop moved there, with no rescaling by sws.
+
+#include "navigator.h"
+#include <libavformat/avformat.h>
+#include <libavutil/imgutils.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define WIDTH 64
+#define HEIGHT 48
+#define FRAMES 10
+#define CROP_WIDTH 32
+#define CROP_HEIGHT 24
+#define CROP_X 8
+#define CROP_Y 6
+
+// RGBA of the pixel at x, y of frame i
+static void pixel(int i, int x, int y, uint8_t* rgba) {
+    rgba[0] = (x * 3 + i) & 255;
+    rgba[1] = (y * 5) & 255;
+    rgba[2] = (x ^ y) & 255;
+    rgba[3] = 255;
+}
+
+// Raw RGBA frames in NUT, which needs neither an encoder nor any setup from the decoder
+static int write_clip(const char* path) {
+    AVFormatContext* pFormatContext = NULL;
+    AVStream* stream;
+    AVPacket* pPacket;
+    int size = av_image_get_buffer_size(AV_PIX_FMT_RGBA, WIDTH, HEIGHT, 1);
+    int ret = -1;
+
+    if (avformat_alloc_output_context2(&pFormatContext, NULL, "nut", path) < 0) {
+        return -1;
+    }
+    stream = avformat_new_stream(pFormatContext, NULL);
+    pPacket = av_packet_alloc();
+    if (stream == NULL || pPacket == NULL) {
+        goto end;
+    }
+    stream->time_base = (AVRational) {1, 25};
+    stream->codecpar->codec_type = AVMEDIA_TYPE_VIDEO;
+    stream->codecpar->codec_id = AV_CODEC_ID_RAWVIDEO;
+    stream->codecpar->format = AV_PIX_FMT_RGBA;
+    stream->codecpar->width = WIDTH;
+    stream->codecpar->height = HEIGHT;
+    if (avio_open(&pFormatContext->pb, path, AVIO_FLAG_WRITE) < 0) {
+        goto end;
+    }
+    if (avformat_write_header(pFormatContext, NULL) < 0) {
+        goto end;
+    }
+    for (int i = 0; i < FRAMES; i++) {
+        if (av_new_packet(pPacket, size) < 0) {
+            goto end;
+        }
+        for (int y = 0; y < HEIGHT; y++) {
+            for (int x = 0; x < WIDTH; x++) {
+                pixel(i, x, y, pPacket->data + (y * WIDTH + x) * 4);
+            }
+        }
+        pPacket->pts = i;
+        pPacket->dts = i;
+        pPacket->duration = 1;
+        pPacket->flags |= AV_PKT_FLAG_KEY;
+        pPacket->stream_index = stream->index;
+        if (av_interleaved_write_frame(pFormatContext, pPacket) < 0) {
+            goto end;
+        }
+    }
+    ret = av_write_trailer(pFormatContext);
+end:
+    av_packet_free(&pPacket);
+    avio_closep(&pFormatContext->pb);
+    avformat_free_context(pFormatContext);
+    return ret;
+}
+
+// The first pixel of the handed out frame i that differs from the cropped source, -1 if none does
+static int first_mismatch(ReadyFrame* frame, int i) {
+    uint8_t expected[4];
+
+    for (int y = 0; y < CROP_HEIGHT; y++) {
+        for (int x = 0; x < CROP_WIDTH; x++) {
+            uint8_t* actual = frame->data + y * frame->stride + x * 4;
+
+            pixel(i, x + CROP_X, y + CROP_Y, expected);
+            if (actual[0] != expected[0] || actual[1] != expected[1]
+                    || actual[2] != expected[2] || actual[3] != expected[3]) {
+                return y * CROP_WIDTH + x;
+            }
+        }
+    }
+    return -1;
+}
+
+static int play_cropped(char* path) {
+    char filters[64];
+    void* videoState;
+    ReadyFrame frame;
+    int ret = -1;
+
+    snprintf(filters, sizeof(filters), "crop=%d:%d:%d:%d", CROP_WIDTH, CROP_HEIGHT, CROP_X, CROP_Y);
+    videoState = openVideoFiltered(path, formatRGBA, 0, 0, filters, 0, 1, 0);
+    if (videoState == NULL) {
+        fprintf(stderr, "Could not open the clip with %s\n", filters);
+        return -1;
+    }
+    for (int i = 0; i < FRAMES; i++) {
+        int mismatch;
+
+        if (make_frame(videoState) < 0) {
+            fprintf(stderr, "The clip ended after %d frames\n", i);
+            goto end;
+        }
+        retrieveFrameInto(videoState, &frame);
+        if (frame.exists != 1 || frame.width != CROP_WIDTH || frame.height != CROP_HEIGHT) {
+            fprintf(stderr, "Frame %d is %dx%d, expected %dx%d\n", i, frame.width, frame.height,
+                    CROP_WIDTH, CROP_HEIGHT);
+            goto end;
+        }
+        mismatch = first_mismatch(&frame, i);
+        freeNativeFrame(videoState);
+        if (mismatch >= 0) {
+            fprintf(stderr, "Frame %d differs from the graph's output at %d, %d\n", i,
+                    mismatch % CROP_WIDTH, mismatch / CROP_WIDTH);
+            goto end;
+        }
+    }
+    ret = 0;
+end:
+    disposeVideo(videoState);
+    return ret;
+}
+
+int main(void) {
+    char path[] = "/tmp/videna_filter_XXXXXX.nut";
+    int fd = mkstemps(path, 4);
+    int ret;
+
+    if (fd < 0) {
+        return 1;
+    }
+    close(fd);
+    if (write_clip(path) < 0) {
+        fprintf(stderr, "Could not write the clip\n");
+        unlink(path);
+        return 1;
+    }
+    ret = play_cropped(path);
+    unlink(path);
+    if (ret < 0) {
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,241 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+// Reads a file through http_open() from a local server that answers every request after a delay,
+// once with range support and once without, and compares every byte with the file.
+
+#include "http.h"
+#include <libavutil/error.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// larger than the block cache, so seeks back also miss it
+#define FILE_SIZE (HTTP_BLOCK_SIZE * HTTP_CACHE_BLOCKS + 1234567)
+#define LATENCY_US 2000
+#define SEEKS 64
+
+static uint8_t* file;
+static int listener;
+static int port;
+static int ranges;
+static pthread_mutex_t counters = PTHREAD_MUTEX_INITIALIZER;
+static int connections;
+static int requests;
+
+static int send_all(int fd, const void* data, size_t size) {
+    const uint8_t* bytes = data;
+    while (size > 0) {
+        ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return -1;
+        }
+        bytes += sent;
+        size -= sent;
+    }
+    return 0;
+}
+
+// Answers the requests of one kept-alive connection until the client closes it
+static void* serve_connection(void* fdV) {
+    int fd = (int) (intptr_t) fdV;
+    char request[4096];
+    int length = 0;
+    for (;;) {
+        char header[256];
+        char* end;
+        char* range;
+        long long first = 0;
+        long long last = FILE_SIZE - 1;
+        int headerSize;
+        ssize_t received = recv(fd, request + length, sizeof(request) - 1 - length, 0);
+        if (received <= 0) {
+            break;
+        }
+        length += received;
+        request[length] = '\0';
+        end = strstr(request, "\r\n\r\n");
+        if (end == NULL) {
+            continue;
+        }
+        pthread_mutex_lock(&counters);
+        requests++;
+        pthread_mutex_unlock(&counters);
+        usleep(LATENCY_US);
+        range = strstr(request, "Range: bytes=");
+        if (ranges && range != NULL && range < end) {
+            sscanf(range, "Range: bytes=%lld-%lld", &first, &last);
+            if (last >= FILE_SIZE) {
+                last = FILE_SIZE - 1;
+            }
+            headerSize = snprintf(header, sizeof(header),
+                "HTTP/1.1 206 Partial Content\r\nContent-Length: %lld\r\nContent-Range: bytes %lld-%lld/%d\r\n\r\n",
+                last - first + 1, first, last, FILE_SIZE);
+        }
+        else {
+            headerSize = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n", FILE_SIZE);
+        }
+        // requests are never pipelined by the client, the rest of the buffer is dropped
+        length = 0;
+        if (send_all(fd, header, headerSize) < 0 || send_all(fd, file + first, last - first + 1) < 0) {
+            break;
+        }
+    }
+    close(fd);
+    return NULL;
+}
+
+static void* serve(void* unused) {
+    for (;;) {
+        pthread_t thread;
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            break;
+        }
+        pthread_mutex_lock(&counters);
+        connections++;
+        pthread_mutex_unlock(&counters);
+        pthread_create(&thread, NULL, serve_connection, (void*) (intptr_t) fd);
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+static int start_server(void) {
+    struct sockaddr_in address;
+    socklen_t size = sizeof(address);
+    pthread_t thread;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (struct sockaddr*) &address, sizeof(address)) < 0 || listen(listener, 16) < 0
+            || getsockname(listener, (struct sockaddr*) &address, &size) < 0) {
+        return -1;
+    }
+    port = ntohs(address.sin_port);
+    return pthread_create(&thread, NULL, serve, NULL);
+}
+
+// Reads size bytes from position and compares them with the file
+static int check_read(HttpSource* source, int64_t position, int size, uint8_t* buffer) {
+    int done = 0;
+    if (avio_seek(source->avio, position, SEEK_SET) != position) {
+        fprintf(stderr, "seek to %lld failed\n", (long long) position);
+        return -1;
+    }
+    size = (int) (position + size > FILE_SIZE ? FILE_SIZE - position : size);
+    while (done < size) {
+        int read = avio_read(source->avio, buffer + done, size - done);
+        if (read <= 0) {
+            fprintf(stderr, "read at %lld failed: %d\n", (long long) (position + done), read);
+            return -1;
+        }
+        done += read;
+    }
+    if (memcmp(buffer, file + position, size) != 0) {
+        fprintf(stderr, "bytes from %lld differ\n", (long long) position);
+        return -1;
+    }
+    return 0;
+}
+
+static int run(int withRanges) {
+    char url[64];
+    HttpSource* source;
+    uint8_t* buffer = malloc(FILE_SIZE);
+    int sequentialRequests;
+    int failed = 0;
+    ranges = withRanges;
+    pthread_mutex_lock(&counters);
+    connections = 0;
+    requests = 0;
+    pthread_mutex_unlock(&counters);
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/video.bin", port);
+    source = http_open(url);
+    if (source == NULL || buffer == NULL) {
+        fprintf(stderr, "could not open %s\n", url);
+        free(buffer);
+        return -1;
+    }
+    if (source->size != FILE_SIZE || source->noRanges == withRanges) {
+        fprintf(stderr, "size %lld, ranges %d\n", (long long) source->size, !source->noRanges);
+        failed = 1;
+    }
+    // only the block of the first request is allocated up front
+    for (int i = 1; i < HTTP_CACHE_BLOCKS; i++) {
+        if (source->blocks[i].data != NULL) {
+            fprintf(stderr, "block %d allocated before it was fetched\n", i);
+            failed = 1;
+            break;
+        }
+    }
+
+    // in order, in reads of odd sizes that straddle blocks
+    for (int64_t position = 0; !failed && position < FILE_SIZE; position += 100003) {
+        failed = check_read(source, position, 100003, buffer) < 0;
+    }
+    pthread_mutex_lock(&counters);
+    sequentialRequests = requests;
+    pthread_mutex_unlock(&counters);
+    if (withRanges) {
+        // one request per block at most, over kept-alive connections
+        if (connections > HTTP_CONNECTIONS || sequentialRequests > FILE_SIZE / HTTP_BLOCK_SIZE + 1 + HTTP_READ_AHEAD) {
+            fprintf(stderr, "%d connections for %d requests\n", connections, sequentialRequests);
+            failed = 1;
+        }
+    }
+    else if (sequentialRequests != 1) {
+        // the whole file comes from the response to the first request
+        fprintf(stderr, "%d requests to read the file in order without ranges\n", sequentialRequests);
+        failed = 1;
+    }
+
+    srand(withRanges + 1);
+    for (int i = 0; i < SEEKS && !failed; i++) {
+        int64_t position = (int64_t) rand() * rand() % FILE_SIZE;
+        failed = check_read(source, position, rand() % (3 * HTTP_BLOCK_SIZE) + 1, buffer) < 0;
+    }
+    printf("%s: %d connections, %d requests\n", withRanges ? "ranges" : "no ranges", connections, requests);
+    http_close(&source);
+    free(buffer);
+    return failed ? -1 : 0;
+}
+
+int main(void) {
+    uint32_t state = 2463534242u;
+    file = malloc(FILE_SIZE);
+    if (file == NULL || start_server() < 0) {
+        fprintf(stderr, "could not start the server\n");
+        return 1;
+    }
+    for (int i = 0; i < FILE_SIZE; i++) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        file[i] = state >> 24;
+    }
+    if (run(1) < 0 || run(0) < 0) {
+        return 1;
+    }
+    return 0;
+}
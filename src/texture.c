@@ -0,0 +1,148 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "texture.h"
+#include <libavutil/mem.h>
+#include <libavutil/time.h>
+#include <string.h>
+
+TextureOutput* texture_alloc(TextureListener listener, void* opaque) {
+    TextureOutput* texture = av_mallocz(sizeof(TextureOutput));
+    if (texture == NULL) {
+        return NULL;
+    }
+    init_lock(&texture->mutex);
+    texture->staged = -1;
+    texture->shown = -1;
+    texture->reading = -1;
+    texture->listener = listener;
+    texture->opaque = opaque;
+    texture->refs = 2;
+    return texture;
+}
+
+// Copies a frame into a buffer the embedder isn't using, packing its rows.
+// It stays invisible until texture_show(), so it can be staged as soon as it is decoded.
+int texture_stage(TextureOutput* texture, const uint8_t* data, int stride, int width, int height) {
+    int index = -1;
+    int rowBytes = width * 4;
+    lock(&texture->mutex);
+    if (texture->staged >= 0) {
+        index = texture->staged;
+    }
+    else {
+        for (int i = 0; i < 3 && index < 0; i++) {
+            if (i != texture->shown && i != texture->reading) {
+                index = i;
+            }
+        }
+    }
+    texture->staged = -1;
+    unlock(&texture->mutex);
+
+    // neither shown nor read, so it can be written without the lock
+    if (texture->widths[index] != width || texture->heights[index] != height) {
+        av_freep(&texture->buffers[index]);
+        texture->buffers[index] = av_malloc((size_t) rowBytes * height);
+        if (texture->buffers[index] == NULL) {
+            texture->widths[index] = 0;
+            texture->heights[index] = 0;
+            return -1;
+        }
+        texture->widths[index] = width;
+        texture->heights[index] = height;
+    }
+    if (stride == rowBytes) {
+        memcpy(texture->buffers[index], data, (size_t) rowBytes * height);
+    }
+    else {
+        for (int y = 0; y < height; y++) {
+            memcpy(texture->buffers[index] + (size_t) y * rowBytes, data + (size_t) y * stride, rowBytes);
+        }
+    }
+
+    lock(&texture->mutex);
+    texture->staged = index;
+    unlock(&texture->mutex);
+    return 0;
+}
+
+// Makes the staged frame the one drawn and tells the embedder.
+void texture_show(TextureOutput* texture) {
+    lock(&texture->mutex);
+    if (texture->staged >= 0) {
+        texture->shown = texture->staged;
+        texture->staged = -1;
+        if (texture->listener != NULL) {
+            texture->listener(texture->opaque);
+        }
+    }
+    unlock(&texture->mutex);
+}
+
+// Shows the staged frame delay microseconds after the previous one was due, sleeping until then.
+// A frame that is already late, or has no delay, is shown right away and the clock starts over from it.
+void texture_present(TextureOutput* texture, int64_t delay) {
+    int64_t now = av_gettime_relative();
+    int64_t due = texture->lastDue + delay;
+    if (texture->lastDue == 0 || delay <= 0 || due < now) {
+        due = now;
+    }
+    if (due > now) {
+        av_usleep(due - now);
+    }
+    texture->lastDue = due;
+    texture_show(texture);
+}
+
+// Hands the embedder the frame shown, which stays untouched until the next call.
+// Returns -1 before the first frame.
+FFI_EXPORT int acquireTexture(void* textureV, const uint8_t** data, uint32_t* width, uint32_t* height) {
+    TextureOutput* texture = (TextureOutput*) textureV;
+    int ret = -1;
+    lock(&texture->mutex);
+    texture->reading = texture->shown;
+    if (texture->shown >= 0) {
+        *data = texture->buffers[texture->shown];
+        *width = texture->widths[texture->shown];
+        *height = texture->heights[texture->shown];
+        ret = 0;
+    }
+    unlock(&texture->mutex);
+    return ret;
+}
+
+// Drops one of the two references. The listener is never called again once either side let go.
+FFI_EXPORT void releaseTexture(void* textureV) {
+    TextureOutput* texture = (TextureOutput*) textureV;
+    int refs;
+    if (texture == NULL) {
+        return;
+    }
+    lock(&texture->mutex);
+    texture->listener = NULL;
+    refs = --texture->refs;
+    unlock(&texture->mutex);
+    if (refs > 0) {
+        return;
+    }
+    for (int i = 0; i < 3; i++) {
+        av_freep(&texture->buffers[i]);
+    }
+    destroy_lock(&texture->mutex);
+    av_free(texture);
+}
@@ -0,0 +1,72 @@
+// This file is a part of videna.
+// Copyright (C) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef TEXTURE_H
+#define TEXTURE_H
+#include <stdint.h>
+#include "threads.h"
+
+#ifndef FFI_EXPORT
+#if _WIN32
+#define FFI_EXPORT __declspec(dllexport)
+#else
+#define FFI_EXPORT
+#endif
+#endif
+
+// Called when a new frame can be drawn, from the thread that showed it
+typedef void (*TextureListener)(void* opaque);
+
+// RGBA frames handed to a texture of the embedder without going through Dart.
+// Three tightly packed buffers rotate between the frame staged for its presentation time,
+// the frame shown and the frame the embedder is copying, so none of them waits for another.
+typedef struct {
+    Mutex mutex;
+    uint8_t* buffers[3];
+    int widths[3];
+    int heights[3];
+    int staged;         // -1 when there is none
+    int shown;          // -1 until the first frame is shown
+    int reading;        // -1 while the embedder isn't copying
+    TextureListener listener;
+    void* opaque;
+    // av_gettime_relative() the last frame was due at, 0 before the first, only used by the presenting thread
+    int64_t lastDue;
+    int refs;           // held by the VideoState and by the embedder's texture
+} TextureOutput;
+
+TextureOutput* texture_alloc(TextureListener listener, void* opaque);
+
+int texture_stage(TextureOutput* texture, const uint8_t* data, int stride, int width, int height);
+
+void texture_show(TextureOutput* texture);
+
+void texture_present(TextureOutput* texture, int64_t delay);
+
+FFI_EXPORT int acquireTexture(void* textureV, const uint8_t** data, uint32_t* width, uint32_t* height);
+
+FFI_EXPORT void releaseTexture(void* textureV);
+
+// Defined by navigator.c, declared here so embedders don't need the FFmpeg headers
+FFI_EXPORT void* attachTexture(void* videoStateV, TextureListener listener, void* opaque);
+
+FFI_EXPORT void detachTexture(void* videoStateV);
+
+FFI_EXPORT void presentTextureFrame(void* videoStateV, int paced);
+
+#endif
@@ -0,0 +1,186 @@
+// This file is a part of videna.
+// Copyright (C) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#ifndef THREADS_H
+#define THREADS_H
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#include <semaphore.h>
+#endif
+
+typedef void* (*ThreadRoutine)(void*);
+
+// Ordered loads and stores of 64 bit words shared with readers that don't take a lock
+#if defined(_MSC_VER)
+#include <intrin.h>
+static inline void store_release(volatile int64_t* target, int64_t value) {
+    _InterlockedExchange64((volatile __int64*) target, value);
+}
+static inline int64_t load_acquire(volatile int64_t* source) {
+    return _InterlockedCompareExchange64((volatile __int64*) source, 0, 0);
+}
+static inline void memory_fence(void) {
+    MemoryBarrier();
+}
+#else
+static inline void store_release(volatile int64_t* target, int64_t value) {
+    __atomic_store_n(target, value, __ATOMIC_RELEASE);
+}
+static inline int64_t load_acquire(volatile int64_t* source) {
+    return __atomic_load_n(source, __ATOMIC_ACQUIRE);
+}
+static inline void memory_fence(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+#endif
+
+#ifdef _WIN32
+typedef HANDLE Mutex;
+typedef HANDLE Thread;
+typedef HANDLE Semaphore;
+
+typedef struct {
+    ThreadRoutine routine;
+    void* arg;
+} ThreadStart;
+
+static inline void init_lock(Mutex* mutex) {
+    *mutex = CreateMutex(NULL,false,NULL);
+}
+static inline int lock(Mutex* mutex) {
+    DWORD ret = WaitForSingleObject(*mutex, INFINITE);
+    if (ret == WAIT_OBJECT_0) {
+        return 0;
+    }
+    return -1;
+}
+static inline int unlock(Mutex* mutex) {
+    bool ret = ReleaseMutex(*mutex);
+    if (ret){
+        return 0;
+    }
+    return -1;
+}
+static inline void destroy_lock(Mutex* mutex) {
+    CloseHandle(*mutex);
+}
+
+static inline unsigned __stdcall thread_trampoline(void* startV) {
+    ThreadStart start = *(ThreadStart*) startV;
+    free(startV);
+    start.routine(start.arg);
+    return 0;
+}
+static inline int start_thread(Thread* thread, ThreadRoutine routine, void* arg) {
+    ThreadStart* start = malloc(sizeof(ThreadStart));
+    if (start == NULL) {
+        return -1;
+    }
+    start->routine = routine;
+    start->arg = arg;
+    *thread = (HANDLE) _beginthreadex(NULL, 0, thread_trampoline, start, 0, NULL);
+    if (*thread == NULL) {
+        free(start);
+        return -1;
+    }
+    return 0;
+}
+static inline void join_thread(Thread* thread) {
+    WaitForSingleObject(*thread, INFINITE);
+    CloseHandle(*thread);
+}
+
+static inline void init_semaphore(Semaphore* semaphore) {
+    *semaphore = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+}
+static inline void wait_semaphore(Semaphore* semaphore) {
+    WaitForSingleObject(*semaphore, INFINITE);
+}
+static inline void post_semaphore(Semaphore* semaphore) {
+    ReleaseSemaphore(*semaphore, 1, NULL);
+}
+static inline void destroy_semaphore(Semaphore* semaphore) {
+    CloseHandle(*semaphore);
+}
+
+typedef INIT_ONCE Once;
+#define ONCE_INIT INIT_ONCE_STATIC_INIT
+
+static inline BOOL CALLBACK once_trampoline(PINIT_ONCE once, PVOID routine, PVOID* context) {
+    ((void (*)(void)) routine)();
+    return TRUE;
+}
+static inline void run_once(Once* once, void (*routine)(void)) {
+    InitOnceExecuteOnce(once, once_trampoline, (PVOID) routine, NULL);
+}
+#else
+typedef pthread_mutex_t Mutex;
+typedef pthread_t Thread;
+typedef sem_t Semaphore;
+
+static inline void init_lock(Mutex* mutex) {
+    pthread_mutex_init(mutex, NULL);
+}
+static inline int lock(Mutex* mutex) {
+    pthread_mutex_lock(mutex);
+    return 0;
+}
+static inline int unlock(Mutex* mutex) {
+    pthread_mutex_unlock(mutex);
+    return 0;
+}
+static inline void destroy_lock(Mutex* mutex) {
+    pthread_mutex_destroy(mutex);
+}
+
+static inline int start_thread(Thread* thread, ThreadRoutine routine, void* arg) {
+    return pthread_create(thread, NULL, routine, arg) == 0 ? 0 : -1;
+}
+static inline void join_thread(Thread* thread) {
+    pthread_join(*thread, NULL);
+}
+
+static inline void init_semaphore(Semaphore* semaphore) {
+    sem_init(semaphore, 0, 0);
+}
+static inline void wait_semaphore(Semaphore* semaphore) {
+    while (sem_wait(semaphore) != 0) {
+        // interrupted by a signal
+    }
+}
+static inline void post_semaphore(Semaphore* semaphore) {
+    sem_post(semaphore);
+}
+static inline void destroy_semaphore(Semaphore* semaphore) {
+    sem_destroy(semaphore);
+}
+
+typedef pthread_once_t Once;
+#define ONCE_INIT PTHREAD_ONCE_INIT
+
+static inline void run_once(Once* once, void (*routine)(void)) {
+    pthread_once(once, routine);
+}
+#endif
+
+#endif
@@ -0,0 +1,215 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "trace.h"
+#include <libavutil/mem.h>
+#include <libavutil/time.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+volatile int tracingEnabled = 0;
+
+// Rings outlive their threads so the events of finished workers can still be dumped, until the cap is reached
+// and new threads reuse them
+static Once traceOnce = ONCE_INIT;
+static Mutex traceMutex;
+static TraceRing* rings = NULL;
+static int numRings = 0;
+static int numIds = 0;
+static THREAD_LOCAL TraceRing* threadRing = NULL;
+// taken by threads that found every ring in use, their events are dropped
+static char ringsTaken;
+#define NO_RING ((TraceRing*) &ringsTaken)
+#ifdef _WIN32
+static DWORD ringSlot;
+#else
+static pthread_key_t ringKey;
+#endif
+
+static void release_ring(void* ringV) {
+    TraceRing* ring = (TraceRing*) ringV;
+    lock(&traceMutex);
+    ring->released = 1;
+    unlock(&traceMutex);
+}
+
+#ifdef _WIN32
+static VOID WINAPI release_slot(PVOID ring) {
+    if (ring != NULL) {
+        release_ring(ring);
+    }
+}
+#endif
+
+static void init_trace(void) {
+    init_lock(&traceMutex);
+    // the destructor runs when a thread that recorded exits
+#ifdef _WIN32
+    ringSlot = FlsAlloc(release_slot);
+#else
+    pthread_key_create(&ringKey, release_ring);
+#endif
+}
+
+// Allocates a ring for the calling thread, or once TRACE_MAX_RINGS are allocated takes over the one of the thread
+// that exited first. Returns NO_RING when all of them belong to running threads.
+static TraceRing* thread_ring(void) {
+    TraceRing* ring = NULL;
+    run_once(&traceOnce, init_trace);
+    lock(&traceMutex);
+    if (numRings < TRACE_MAX_RINGS && (ring = av_mallocz(sizeof(TraceRing))) != NULL) {
+        numRings++;
+        ring->next = rings;
+        rings = ring;
+    }
+    else {
+        for (TraceRing* candidate = rings; candidate != NULL; candidate = candidate->next) {
+            if (candidate->released && (ring == NULL || candidate->id < ring->id)) {
+                ring = candidate;
+            }
+        }
+        if (ring != NULL) {
+            ring->released = 0;
+            store_release(&ring->head, 0);
+        }
+    }
+    if (ring == NULL) {
+        unlock(&traceMutex);
+        return NO_RING;
+    }
+    // a new id, so the events of the thread that had the ring before aren't mixed with these
+    ring->id = ++numIds;
+    unlock(&traceMutex);
+#ifdef _WIN32
+    FlsSetValue(ringSlot, ring);
+#else
+    pthread_setspecific(ringKey, ring);
+#endif
+    return ring;
+}
+
+void trace_event(char phase, const char* name, const void* state, int64_t arg) {
+    TraceRing* ring = threadRing;
+    TraceEvent* event;
+    int64_t head;
+    if (ring == NULL) {
+        ring = threadRing = thread_ring();
+    }
+    if (ring == NO_RING) {
+        return;
+    }
+    head = ring->head;
+    event = &ring->events[head % TRACE_RING_SIZE];
+    event->time = av_gettime_relative();
+    event->name = name;
+    event->state = state;
+    event->arg = arg;
+    event->phase = phase;
+    store_release(&ring->head, head + 1);
+}
+
+// Starts recording, dropping what earlier sessions recorded.
+FFI_EXPORT void startTracing(void) {
+    run_once(&traceOnce, init_trace);
+    lock(&traceMutex);
+    for (TraceRing* ring = rings; ring != NULL; ring = ring->next) {
+        // only the owning thread writes the head, but none of them records while tracing is off
+        store_release(&ring->head, 0);
+    }
+    unlock(&traceMutex);
+    tracingEnabled = 1;
+}
+
+FFI_EXPORT void stopTracing(void) {
+    tracingEnabled = 0;
+}
+
+// Index of state among the video states seen so far, used as the process of its events so every VideoState
+// gets its own group of tracks.
+static int state_process(const void** states, int* numStates, int maxStates, const void* state) {
+    if (state == NULL) {
+        return 0;
+    }
+    for (int i = 0; i < *numStates; i++) {
+        if (states[i] == state) {
+            return i + 1;
+        }
+    }
+    if (*numStates == maxStates) {
+        return 0;
+    }
+    states[(*numStates)++] = state;
+    return *numStates;
+}
+
+// Writes the recorded events to path as Chrome trace-event JSON, which Perfetto and chrome://tracing open.
+// Events recorded while the dump runs may be torn, so it is meant to be called after stopTracing().
+// Returns the number of events written, or -1 if the file couldn't be written.
+FFI_EXPORT int dumpTrace(char* path) {
+    const void* states[256];
+    // processes the thread of the current ring was named in
+    char named[sizeof(states) / sizeof(states[0]) + 1];
+    int numStates = 0;
+    int written = 0;
+    FILE* file;
+
+    run_once(&traceOnce, init_trace);
+    file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return -1;
+    }
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"ph\":\"M\",\"pid\":0,\"name\":\"process_name\",\"args\":{\"name\":\"videna\"}}");
+    lock(&traceMutex);
+    for (TraceRing* ring = rings; ring != NULL; ring = ring->next) {
+        int64_t head = load_acquire(&ring->head);
+        int64_t start = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+        memset(named, 0, sizeof(named));
+        for (int64_t i = start; i < head; i++) {
+            const TraceEvent* event = &ring->events[i % TRACE_RING_SIZE];
+            int known = numStates;
+            int pid = state_process(states, &numStates, sizeof(states) / sizeof(states[0]), event->state);
+            // thread ids are scoped by process, so the thread is named in every process it recorded events for
+            if (!named[pid]) {
+                named[pid] = 1;
+                fprintf(file, ",\n{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"thread %d\"}}",
+                    pid, ring->id, ring->id);
+            }
+            if (numStates > known) {
+                fprintf(file, ",\n{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\",\"args\":{\"name\":\"VideoState %p\"}}",
+                    pid, event->state);
+            }
+            fprintf(file, ",\n{\"ph\":\"%c\",%s\"name\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%" PRId64 ",\"args\":{\"arg\":%" PRId64 "}}",
+                event->phase, event->phase == 'i' ? "\"s\":\"t\"," : "", event->name, pid, ring->id, event->time, event->arg);
+            written++;
+        }
+    }
+    unlock(&traceMutex);
+    fprintf(file, "\n]}\n");
+    if (fclose(file) != 0) {
+        return -1;
+    }
+    return written;
+}
@@ -0,0 +1,71 @@
+// This file is a part of videna.
+// Copyright (C) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+
+#ifndef TRACE_H
+#define TRACE_H
+#include <stdint.h>
+#include "threads.h"
+
+#ifndef FFI_EXPORT
+#if _WIN32
+#define FFI_EXPORT __declspec(dllexport)
+#else
+#define FFI_EXPORT
+#endif
+#endif
+
+// Events kept per thread, the oldest are overwritten
+#define TRACE_RING_SIZE 8192
+// Rings allocated at most. Past it a new thread takes over the ring of an exited one,
+// or records nothing while every ring belongs to a running thread.
+#define TRACE_MAX_RINGS 64
+
+typedef struct {
+    int64_t time;       // av_gettime_relative()
+    const char* name;   // a string literal, the stage
+    const void* state;  // the VideoState it belongs to, or NULL
+    int64_t arg;        // pts or size, depending on the stage
+    char phase;         // 'B' begins the stage, 'E' ends it, 'i' marks an instant
+} TraceEvent;
+
+// Written only by its thread, so recording takes no lock
+typedef struct TraceRing {
+    TraceEvent events[TRACE_RING_SIZE];
+    volatile int64_t head;
+    int id;
+    // set when its thread exited, the next thread that records takes it over
+    int released;
+    struct TraceRing* next;
+} TraceRing;
+
+extern volatile int tracingEnabled;
+
+void trace_event(char phase, const char* name, const void* state, int64_t arg);
+
+// Costs a load and a branch while tracing is disabled
+#define TRACE_BEGIN(name, state, arg) do { if (tracingEnabled) trace_event('B', name, state, arg); } while (0)
+#define TRACE_END(name, state, arg) do { if (tracingEnabled) trace_event('E', name, state, arg); } while (0)
+#define TRACE_MARK(name, state, arg) do { if (tracingEnabled) trace_event('i', name, state, arg); } while (0)
+
+FFI_EXPORT void startTracing(void);
+
+FFI_EXPORT void stopTracing(void);
+
+FFI_EXPORT int dumpTrace(char* path);
+
+#endif
@@ -0,0 +1,136 @@
+// This file is a part of videna.
+// Copyright (c) 2023 Stanisław Talejko <stalejko@gmail.com>
+//
+// videna is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// videna is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+
+#include "sink.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Exported by the library, see navigator.h, which defines data of its own and is only included by the library
+#ifdef _WIN32
+__declspec(dllimport)
+#endif
+int64_t exportFrames(char* path, char* outputPath, int fd, int container, int pxl, int width, int height);
+
+typedef struct {
+    const char* name;
+    int format;
+} FormatName;
+
+static const FormatName formatNames[] = {
+    {"rgba", formatRGBA},
+    {"bgra", formatBGRA},
+    {"argb", formatARGB},
+    {"abgr", formatABGR},
+    {"yuv420p", formatYUV420P},
+    {"gray8a", formatGRAY8A},
+    {"gray16le", formatGRAY16LE},
+    {"nv12", formatNV12},
+    {"rgb24", formatRGB24},
+    {"rgb565le", formatRGB565LE},
+    {"gray8", formatGRAY8},
+    {"p010le", formatP010LE}
+};
+
+static void usage(void) {
+    fprintf(stderr, "usage: videna_cli [-f y4m|raw] [-p format] [-s WIDTHxHEIGHT] input [output]\n"
+        "Decodes every frame of input and writes it to output, or to stdout when output is - or missing.\n"
+        "  -f  container, y4m (default) or raw planes without headers\n"
+        "  -p  pixel format, yuv420p (default)");
+    for (size_t i = 0; i < sizeof(formatNames) / sizeof(formatNames[0]); i++) {
+        fprintf(stderr, i == 0 ? ": %s" : ", %s", formatNames[i].name);
+    }
+    fprintf(stderr, "\n  -s  output size, the size of the video by default\n");
+}
+
+int main(int argc, char** argv) {
+    char* input = NULL;
+    char* output = NULL;
+    int container = sinkY4M;
+    int pxl = formatYUV420P;
+    int width = 0;
+    int height = 0;
+    int fd = -1;
+    int64_t frames;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "y4m") == 0) {
+                container = sinkY4M;
+            }
+            else if (strcmp(argv[i], "raw") == 0) {
+                container = sinkRaw;
+            }
+            else {
+                usage();
+                return 2;
+            }
+        }
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            i++;
+            pxl = -1;
+            for (size_t j = 0; j < sizeof(formatNames) / sizeof(formatNames[0]); j++) {
+                if (strcmp(argv[i], formatNames[j].name) == 0) {
+                    pxl = formatNames[j].format;
+                }
+            }
+            if (pxl < 0) {
+                usage();
+                return 2;
+            }
+        }
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            i++;
+            if (sscanf(argv[i], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+                usage();
+                return 2;
+            }
+        }
+        else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            usage();
+            return 2;
+        }
+        else if (input == NULL) {
+            input = argv[i];
+        }
+        else if (output == NULL) {
+            output = argv[i];
+        }
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if (input == NULL) {
+        usage();
+        return 2;
+    }
+    if (output == NULL || strcmp(output, "-") == 0) {
+        // the library reports errors on stderr, stdout only carries the frames
+        fd = 1;
+        output = NULL;
+    }
+    frames = exportFrames(input, output, fd, container, pxl, width, height);
+    if (frames < 0) {
+        fprintf(stderr, "Could not export %s\n", input);
+        return 1;
+    }
+    fprintf(stderr, "%lld frames\n", (long long) frames);
+    return 0;
+}